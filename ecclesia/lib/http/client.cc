@@ -16,10 +16,16 @@
 
 #include "ecclesia/lib/http/client.h"
 
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
@@ -44,4 +50,40 @@ nlohmann::json HttpClient::HttpResponse::GetBodyJson() {
   return nlohmann::json::parse(body, nullptr, /*allow_exceptions=*/false);
 }
 
+void HttpClient::StartRequest(Protocol cmd,
+                              std::unique_ptr<HttpRequest> request,
+                              ResponseCallback done) {
+  switch (cmd) {
+    case Protocol::kGet:
+      done(Get(std::move(request)));
+      return;
+    case Protocol::kPost:
+      done(Post(std::move(request)));
+      return;
+    case Protocol::kDelete:
+      done(Delete(std::move(request)));
+      return;
+    case Protocol::kPatch:
+      done(Patch(std::move(request)));
+      return;
+  }
+  done(absl::InvalidArgumentError("Unexpected value for Protocol"));
+}
+
+std::vector<absl::StatusOr<HttpClient::HttpResponse>> HttpClient::ExecuteBatch(
+    Protocol cmd, std::vector<std::unique_ptr<HttpRequest>> requests) {
+  std::vector<absl::StatusOr<HttpResponse>> responses(
+      requests.size(), absl::UnknownError("Request did not complete"));
+  absl::BlockingCounter pending(static_cast<int>(requests.size()));
+  for (size_t i = 0; i < requests.size(); ++i) {
+    StartRequest(cmd, std::move(requests[i]),
+                 [&responses, &pending, i](absl::StatusOr<HttpResponse> resp) {
+                   responses[i] = std::move(resp);
+                   pending.DecrementCount();
+                 });
+  }
+  pending.Wait();
+  return responses;
+}
+
 }  // namespace ecclesia
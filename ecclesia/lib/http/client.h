@@ -19,8 +19,10 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "single_include/nlohmann/json.hpp"
@@ -39,6 +41,9 @@ enum class Protocol {
 std::string GetHttpMethodName(ecclesia::Protocol protocol);
 
 // Http Client interface
+//
+// Clients given to HttpRedfishTransport must be threadsafe, as the transport
+// sends requests from several threads without serializing them.
 class HttpClient {
  public:
   using HttpHeaders = absl::flat_hash_map<std::string, std::string>;
@@ -69,6 +74,10 @@ class HttpClient {
     HttpHeaders headers;
   };
 
+  // Callback receiving the outcome of a request started with StartRequest.
+  using ResponseCallback =
+      absl::AnyInvocable<void(absl::StatusOr<HttpResponse>)>;
+
   HttpClient() {}
   virtual ~HttpClient() {}
 
@@ -90,6 +99,20 @@ class HttpClient {
       std::unique_ptr<HttpRequest> request) {
     return absl::UnimplementedError("Patch not implemented");
   }
+
+  // Starts a request without waiting for it to complete. done is invoked
+  // exactly once with the outcome, possibly on a different thread, and must
+  // not block on other requests made through this client. The default
+  // implementation performs the request on the calling thread before
+  // returning.
+  virtual void StartRequest(Protocol cmd, std::unique_ptr<HttpRequest> request,
+                            ResponseCallback done);
+
+  // Executes a batch of requests with the same method and waits for all of
+  // them to complete. Responses are returned in the order of the requests.
+  // The requests run concurrently if StartRequest is asynchronous.
+  std::vector<absl::StatusOr<HttpResponse>> ExecuteBatch(
+      Protocol cmd, std::vector<std::unique_ptr<HttpRequest>> requests);
 };
 
 }  // namespace ecclesia
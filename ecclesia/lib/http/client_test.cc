@@ -16,8 +16,13 @@
 
 #include "ecclesia/lib/http/client.h"
 
+#include <memory>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
@@ -143,5 +148,44 @@ TEST(BodyJson, NestedJsonTest) {
                                              /*allow_exceptions=*/false)));
 }
 
+// Records the order in which requests are issued and echoes the URI back.
+class EchoHttpClient : public HttpClient {
+ public:
+  absl::StatusOr<HttpResponse> Get(
+      std::unique_ptr<HttpRequest> request) override {
+    return HttpResponse{.code = 200, .body = request->uri, .headers = {}};
+  }
+  absl::StatusOr<HttpResponse> Post(
+      std::unique_ptr<HttpRequest> request) override {
+    return absl::InternalError("Post");
+  }
+};
+
+TEST(ExecuteBatch, DefaultImplementationReturnsResponsesInOrder) {
+  EchoHttpClient client;
+  std::vector<std::unique_ptr<HttpClient::HttpRequest>> requests;
+  for (const char *uri : {"/a", "/b", "/c"}) {
+    auto request = std::make_unique<HttpClient::HttpRequest>();
+    request->uri = uri;
+    requests.push_back(std::move(request));
+  }
+  std::vector<absl::StatusOr<HttpClient::HttpResponse>> responses =
+      client.ExecuteBatch(Protocol::kGet, std::move(requests));
+  ASSERT_THAT(responses.size(), Eq(3));
+  EXPECT_THAT(responses[0]->body, Eq("/a"));
+  EXPECT_THAT(responses[1]->body, Eq("/b"));
+  EXPECT_THAT(responses[2]->body, Eq("/c"));
+}
+
+TEST(ExecuteBatch, DefaultImplementationReportsErrors) {
+  EchoHttpClient client;
+  std::vector<std::unique_ptr<HttpClient::HttpRequest>> requests;
+  requests.push_back(std::make_unique<HttpClient::HttpRequest>());
+  std::vector<absl::StatusOr<HttpClient::HttpResponse>> responses =
+      client.ExecuteBatch(Protocol::kPost, std::move(requests));
+  ASSERT_THAT(responses.size(), Eq(1));
+  EXPECT_FALSE(responses[0].ok());
+}
+
 }  // namespace
 }  // namespace ecclesia
@@ -16,6 +16,7 @@
 
 #include "ecclesia/lib/http/curl_client.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -26,21 +27,25 @@
 #include <vector>
 
 #include "absl/base/call_once.h"
-#include "absl/base/const_init.h"
 #include "absl/cleanup/cleanup.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "curl/curl.h"
 #include "ecclesia/lib/http/client.h"
 #include "ecclesia/lib/http/cred.pb.h"
+#include "ecclesia/lib/thread/thread.h"
 
 namespace ecclesia {
 
@@ -50,6 +55,16 @@ absl::once_flag curl_init_once;
 
 constexpr auto kSupportedProtocols = CURLPROTO_HTTP | CURLPROTO_HTTPS;
 
+// The access mode each share lock was taken with by this thread. curl does not
+// pass the mode to the unlock function, and a lock on one kind of data is
+// always released by the thread which took it before it is taken again.
+thread_local curl_lock_access held_share_access[CURL_LOCK_DATA_LAST] = {};
+
+constexpr absl::string_view kContentLengthHeader = "Content-Length";
+// Upper bound on the body buffer preallocated from a Content-Length header, so
+// that a bogus header cannot force a huge allocation up front.
+constexpr size_t kMaxPreallocatedBodySize = 64 << 20;
+
 // SetCurlOpts is an overloaded helper function for setting curl options from
 // the different credential configs supported.
 void SetCurlOpts(LibCurl *libcurl, CURL *curl, const HttpCredential &creds) {
@@ -191,6 +206,44 @@ CURLSHcode LibCurlProxy::curl_share_setopt(CURLSH *share, CURLSHoption option,
   return ::curl_share_setopt(share, option, param);
 }
 
+CURLM *LibCurlProxy::curl_multi_init() { return ::curl_multi_init(); }
+
+CURLMcode LibCurlProxy::curl_multi_cleanup(CURLM *multi) {
+  return ::curl_multi_cleanup(multi);
+}
+
+CURLMcode LibCurlProxy::curl_multi_setopt(CURLM *multi, CURLMoption option,
+                                          uint64_t param) {
+  return ::curl_multi_setopt(multi, option, param);
+}
+
+CURLMcode LibCurlProxy::curl_multi_add_handle(CURLM *multi, CURL *curl) {
+  return ::curl_multi_add_handle(multi, curl);
+}
+
+CURLMcode LibCurlProxy::curl_multi_remove_handle(CURLM *multi, CURL *curl) {
+  return ::curl_multi_remove_handle(multi, curl);
+}
+
+CURLMcode LibCurlProxy::curl_multi_perform(CURLM *multi,
+                                           int *running_handles) {
+  return ::curl_multi_perform(multi, running_handles);
+}
+
+CURLMcode LibCurlProxy::curl_multi_poll(CURLM *multi, int timeout_ms,
+                                        int *numfds) {
+  return ::curl_multi_poll(multi, nullptr, 0, timeout_ms, numfds);
+}
+
+CURLMcode LibCurlProxy::curl_multi_wakeup(CURLM *multi) {
+  return ::curl_multi_wakeup(multi);
+}
+
+CURLMsg *LibCurlProxy::curl_multi_info_read(CURLM *multi,
+                                            int *msgs_in_queue) {
+  return ::curl_multi_info_read(multi, msgs_in_queue);
+}
+
 CurlHttpClient::CurlHttpClient(std::unique_ptr<LibCurl> libcurl,
                                std::variant<HttpCredential, TlsCredential> cred)
     : CurlHttpClient(std::move(libcurl), std::move(cred), {}) {}
@@ -203,21 +256,93 @@ CurlHttpClient::CurlHttpClient(std::unique_ptr<LibCurl> libcurl,
       cred_(std::move(cred)) {
   // Setup share interface
   shared_connection_ = libcurl_->curl_share_init();
-  // Setup interface to share the actual underlying cached connection
+  // Setup interface to share the actual underlying cached connection, the DNS
+  // cache and the TLS session IDs so that reconnects can resume sessions.
   libcurl_->curl_share_setopt(shared_connection_, CURLSHOPT_SHARE,
                               CURL_LOCK_DATA_CONNECT);
+  libcurl_->curl_share_setopt(shared_connection_, CURLSHOPT_SHARE,
+                              CURL_LOCK_DATA_DNS);
+  libcurl_->curl_share_setopt(shared_connection_, CURLSHOPT_SHARE,
+                              CURL_LOCK_DATA_SSL_SESSION);
   // Setup locking and unlocking functions so that share interface is thread
   // safe
   libcurl_->curl_share_setopt(shared_connection_, CURLSHOPT_LOCKFUNC,
                               &LockSharedMutex);
   libcurl_->curl_share_setopt(shared_connection_, CURLSHOPT_UNLOCKFUNC,
                               &UnlockSharedMutex);
+  libcurl_->curl_share_setopt(shared_connection_, CURLSHOPT_USERDATA,
+                              static_cast<void *>(this));
 }
 
 CurlHttpClient::~CurlHttpClient() {
+  {
+    // Easy handles must be cleaned up before the share they are attached to.
+    absl::MutexLock mu(&handle_pool_mutex_);
+    for (CURL *curl : idle_handles_) {
+      libcurl_->curl_easy_cleanup(curl);
+    }
+    idle_handles_.clear();
+  }
   libcurl_->curl_share_cleanup(shared_connection_);
 }
 
+CurlHttpClient::Stats CurlHttpClient::GetStats() const {
+  absl::MutexLock mu(&handle_pool_mutex_);
+  return stats_;
+}
+
+CURL *CurlHttpClient::AcquireHandle() {
+  {
+    absl::MutexLock mu(&handle_pool_mutex_);
+    if (!idle_handles_.empty()) {
+      CURL *curl = idle_handles_.back();
+      idle_handles_.pop_back();
+      ++stats_.handles_reused;
+      return curl;
+    }
+  }
+  CURL *curl = libcurl_->curl_easy_init();
+  if (!curl) return nullptr;
+  SetDefaultCurlOpts(curl);
+  std::visit([&](auto creds) { SetCurlOpts(libcurl_.get(), curl, creds); },
+             cred_);
+  absl::MutexLock mu(&handle_pool_mutex_);
+  ++stats_.handles_created;
+  return curl;
+}
+
+void CurlHttpClient::ReleaseHandle(CURL *curl) {
+  // Drop everything HttpMethod set for the request which just completed, in
+  // particular pointers into its stack frame. Setting POSTFIELDS implies POST,
+  // so HTTPGET must come after it to restore the default method.
+  libcurl_->curl_easy_setopt(curl, CURLOPT_URL,
+                             static_cast<const char *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_ERRORBUFFER,
+                             static_cast<void *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH,
+                             static_cast<const char *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST,
+                             static_cast<const char *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_POSTFIELDS,
+                             static_cast<void *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_HTTPGET, static_cast<uint64_t>(1));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_HTTPHEADER,
+                             static_cast<void *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEDATA,
+                             static_cast<void *>(nullptr));
+  libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEHEADER,
+                             static_cast<void *>(nullptr));
+  {
+    absl::MutexLock mu(&handle_pool_mutex_);
+    if (idle_handles_.size() < config_.max_idle_handles) {
+      idle_handles_.push_back(curl);
+      return;
+    }
+    ++stats_.handles_discarded;
+  }
+  libcurl_->curl_easy_cleanup(curl);
+}
+
 absl::StatusOr<CurlHttpClient::HttpResponse> CurlHttpClient::Get(
     std::unique_ptr<HttpRequest> request) {
   return HttpMethod(Protocol::kGet, std::move(request));
@@ -240,25 +365,31 @@ absl::StatusOr<CurlHttpClient::HttpResponse> CurlHttpClient::Patch(
 
 absl::StatusOr<CurlHttpClient::HttpResponse> CurlHttpClient::HttpMethod(
     Protocol cmd, std::unique_ptr<HttpRequest> request) {
-  CURL *curl = libcurl_->curl_easy_init();
+  Transfer transfer{.request = std::move(request)};
+  if (absl::Status status = PrepareTransfer(cmd, transfer); !status.ok()) {
+    return status;
+  }
+  CURLcode code = libcurl_->curl_easy_perform(transfer.curl);
+  return CompleteTransfer(transfer, code);
+}
+
+absl::Status CurlHttpClient::PrepareTransfer(Protocol cmd,
+                                             Transfer &transfer) {
+  CURL *curl = AcquireHandle();
   if (!curl) return absl::InternalError("Failed to create curl handle");
-  absl::Cleanup curl_cleanup([&]() { libcurl_->curl_easy_cleanup(curl); });
-  SetDefaultCurlOpts(curl);
+  transfer.curl = curl;
+  const HttpRequest &request = *transfer.request;
 
-  libcurl_->curl_easy_setopt(curl, CURLOPT_URL, request->uri.c_str());
+  libcurl_->curl_easy_setopt(curl, CURLOPT_URL, request.uri.c_str());
 
   // Error buffer to write to while curl handle is active
-  char errbuf[CURL_ERROR_SIZE];
-  libcurl_->curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+  libcurl_->curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, transfer.errbuf);
 
-  if (!request->unix_socket_path.empty()) {
+  if (!request.unix_socket_path.empty()) {
     libcurl_->curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH,
-                               request->unix_socket_path.c_str());
+                               request.unix_socket_path.c_str());
   }
 
-  std::visit([&](auto creds) { SetCurlOpts(libcurl_.get(), curl, creds); },
-             cred_);
-
   switch (cmd) {
     case Protocol::kGet:
       libcurl_->curl_easy_setopt(curl, CURLOPT_HTTPGET,
@@ -266,9 +397,9 @@ absl::StatusOr<CurlHttpClient::HttpResponse> CurlHttpClient::HttpMethod(
       break;
     case Protocol::kPost:
       libcurl_->curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
-                                 request->body.size());
+                                 request.body.size());
       libcurl_->curl_easy_setopt(curl, CURLOPT_POSTFIELDS,
-                                 request->body.data());
+                                 request.body.data());
       break;
     case Protocol::kDelete:
       libcurl_->curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
@@ -276,55 +407,67 @@ absl::StatusOr<CurlHttpClient::HttpResponse> CurlHttpClient::HttpMethod(
     case Protocol::kPatch:
       libcurl_->curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
       libcurl_->curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
-                                 request->body.size());
+                                 request.body.size());
       libcurl_->curl_easy_setopt(curl, CURLOPT_POSTFIELDS,
-                                 request->body.data());
+                                 request.body.data());
       break;
   }
 
-  struct curl_slist *request_headers = NULL;
-  absl::Cleanup cleanup = [&request_headers]() {
-    curl_slist_free_all(request_headers);
-  };
-  for (const auto &hdr : request->headers) {
-    struct curl_slist *list = curl_slist_append(
-        request_headers, absl::StrCat(hdr.first, ":", hdr.second).c_str());
+  for (const auto &hdr : request.headers) {
+    struct curl_slist *list =
+        curl_slist_append(transfer.request_headers,
+                          absl::StrCat(hdr.first, ":", hdr.second).c_str());
     if (list == nullptr) {
+      ReleaseTransfer(transfer);
       return absl::ResourceExhaustedError("request header list");
     }
-    request_headers = list;
+    transfer.request_headers = list;
   }
-  libcurl_->curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request_headers);
-
-  std::string response_body;
-  HttpHeaders response_headers;
+  libcurl_->curl_easy_setopt(curl, CURLOPT_HTTPHEADER,
+                             transfer.request_headers);
 
   libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, BodyCallback);
-  libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_body);
+  libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEDATA,
+                             static_cast<void *>(&transfer));
   libcurl_->curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
-  libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &response_headers);
+  libcurl_->curl_easy_setopt(curl, CURLOPT_WRITEHEADER,
+                             static_cast<void *>(&transfer));
+  return absl::OkStatus();
+}
 
-  CURLcode code = libcurl_->curl_easy_perform(curl);
+absl::StatusOr<CurlHttpClient::HttpResponse> CurlHttpClient::CompleteTransfer(
+    Transfer &transfer, CURLcode code) {
+  absl::Cleanup release = [&]() { ReleaseTransfer(transfer); };
   if (code != CURLE_OK) {
     return absl::InternalError(
         absl::StrFormat("cURL failure: %s", curl_easy_strerror(code)));
   }
   uint64_t long_response_code = 0;
   int returned_code = 0;
-  if (libcurl_->curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
+  if (libcurl_->curl_easy_getinfo(transfer.curl, CURLINFO_RESPONSE_CODE,
                                   &long_response_code) == CURLE_OK) {
     returned_code = static_cast<int>(long_response_code);
   }
 
-  return HttpClient::HttpResponse{.code = returned_code,
-                                  .body = response_body,
-                                  .headers = response_headers};
+  return HttpClient::HttpResponse{
+      .code = returned_code,
+      .body = std::move(transfer.response_body),
+      .headers = std::move(transfer.response_headers)};
+}
+
+void CurlHttpClient::ReleaseTransfer(Transfer &transfer) {
+  if (transfer.curl != nullptr) {
+    ReleaseHandle(transfer.curl);
+    transfer.curl = nullptr;
+  }
+  curl_slist_free_all(transfer.request_headers);
+  transfer.request_headers = nullptr;
 }
 
-// userp is set through framework over third_CURLOPT_WRITEDATA
+// userp is the Transfer set through CURLOPT_WRITEHEADER
 size_t CurlHttpClient::HeaderCallback(const void *data, size_t size,
                                       size_t nmemb, void *userp) {
-  auto *headers = static_cast<HttpHeaders *>(userp);
+  auto *transfer = static_cast<Transfer *>(userp);
   auto str = static_cast<const char *>(data);
 
   if (str[0] != '\r' && str[1] != '\n') {
@@ -333,30 +476,53 @@ size_t CurlHttpClient::HeaderCallback(const void *data, size_t size,
     if (v.size() == 2) {
       absl::StripAsciiWhitespace(&v[0]);
       absl::StripAsciiWhitespace(&v[1]);
-      headers->try_emplace(v[0], v[1]);
+      // Headers are complete before any of the body is received, so the body
+      // buffer can be sized once instead of growing with every chunk.
+      size_t content_length;
+      if (absl::EqualsIgnoreCase(v[0], kContentLengthHeader) &&
+          absl::SimpleAtoi(v[1], &content_length)) {
+        transfer->response_body.reserve(
+            std::min(content_length, kMaxPreallocatedBodySize));
+      }
+      transfer->response_headers.try_emplace(v[0], v[1]);
     }
   }
 
   return size * nmemb;
 }
 
-// userp is set through framework over third_CURLOPT_WRITEHEADER
+// userp is the Transfer set through CURLOPT_WRITEDATA
 size_t CurlHttpClient::BodyCallback(const void *data, size_t size, size_t nmemb,
                                     void *userp) {
-  std::string *body = static_cast<std::string *>(userp);
-  body->append(static_cast<const char *>(data), size * nmemb);
+  auto *transfer = static_cast<Transfer *>(userp);
+  transfer->response_body.append(static_cast<const char *>(data),
+                                 size * nmemb);
   return size * nmemb;
 }
 
-ABSL_CONST_INIT absl::Mutex CurlHttpClient::shared_mutex_(absl::kConstInit);
-
 void CurlHttpClient::LockSharedMutex(CURL *handle, curl_lock_data data,
                                      curl_lock_access laccess, void *useptr) {
-  shared_mutex_.Lock();
+  if (data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+  absl::Mutex &mutex =
+      static_cast<CurlHttpClient *>(useptr)->share_mutexes_[data];
+  if (laccess == CURL_LOCK_ACCESS_SHARED) {
+    mutex.ReaderLock();
+  } else {
+    mutex.Lock();
+  }
+  held_share_access[data] = laccess;
 }
+
 void CurlHttpClient::UnlockSharedMutex(CURL *handle, curl_lock_data data,
                                        void *useptr) {
-  shared_mutex_.Unlock();
+  if (data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+  absl::Mutex &mutex =
+      static_cast<CurlHttpClient *>(useptr)->share_mutexes_[data];
+  if (held_share_access[data] == CURL_LOCK_ACCESS_SHARED) {
+    mutex.ReaderUnlock();
+  } else {
+    mutex.Unlock();
+  }
 }
 
 void CurlHttpClient::SetDefaultCurlOpts(CURL *curl) const {
@@ -414,4 +580,106 @@ void CurlHttpClient::SetDefaultCurlOpts(CURL *curl) const {
   libcurl_->curl_easy_setopt(curl, CURLOPT_SHARE, shared_connection_);
 }
 
+CurlMultiHttpClient::CurlMultiHttpClient(
+    std::unique_ptr<LibCurl> libcurl,
+    std::variant<HttpCredential, TlsCredential> cred)
+    : CurlMultiHttpClient(std::move(libcurl), std::move(cred), {}) {}
+
+CurlMultiHttpClient::CurlMultiHttpClient(
+    std::unique_ptr<LibCurl> libcurl,
+    std::variant<HttpCredential, TlsCredential> cred, Config config)
+    : CurlHttpClient(std::move(libcurl), std::move(cred), config),
+      multi_(this->libcurl()->curl_multi_init()) {
+  CHECK(multi_ != nullptr) << "Failed to create curl multi handle";
+  this->libcurl()->curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS,
+                                     config.max_host_connections);
+  event_loop_ =
+      GetDefaultThreadFactory()->New([this]() { EventLoop(); });
+}
+
+CurlMultiHttpClient::~CurlMultiHttpClient() {
+  {
+    absl::MutexLock mu(&mutex_);
+    shutdown_ = true;
+  }
+  libcurl()->curl_multi_wakeup(multi_);
+  event_loop_->Join();
+  libcurl()->curl_multi_cleanup(multi_);
+}
+
+void CurlMultiHttpClient::StartRequest(Protocol cmd,
+                                       std::unique_ptr<HttpRequest> request,
+                                       ResponseCallback done) {
+  auto pending = std::make_unique<PendingTransfer>();
+  pending->transfer.request = std::move(request);
+  pending->done = std::move(done);
+  if (absl::Status status = PrepareTransfer(cmd, pending->transfer);
+      !status.ok()) {
+    pending->done(std::move(status));
+    return;
+  }
+  {
+    absl::MutexLock mu(&mutex_);
+    if (shutdown_) {
+      ReleaseTransfer(pending->transfer);
+      pending->done(absl::CancelledError("HTTP client is shutting down"));
+      return;
+    }
+    pending_.push_back(std::move(pending));
+  }
+  libcurl()->curl_multi_wakeup(multi_);
+}
+
+void CurlMultiHttpClient::EventLoop() {
+  // Wait at most this long for socket activity before checking for new
+  // transfers; curl_multi_wakeup interrupts the wait earlier.
+  constexpr int kPollTimeoutMs = 1000;
+  while (true) {
+    std::vector<std::unique_ptr<PendingTransfer>> started;
+    bool shutdown;
+    {
+      absl::MutexLock mu(&mutex_);
+      started.swap(pending_);
+      shutdown = shutdown_;
+    }
+    for (auto &pending : started) {
+      CURL *curl = pending->transfer.curl;
+      if (shutdown ||
+          libcurl()->curl_multi_add_handle(multi_, curl) != CURLM_OK) {
+        ReleaseTransfer(pending->transfer);
+        pending->done(absl::CancelledError("Failed to start transfer"));
+        continue;
+      }
+      active_.emplace(curl, std::move(pending));
+    }
+    if (shutdown) break;
+
+    int running = 0;
+    libcurl()->curl_multi_perform(multi_, &running);
+
+    int msgs_in_queue = 0;
+    while (CURLMsg *msg = libcurl()->curl_multi_info_read(multi_,
+                                                          &msgs_in_queue)) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      CURL *curl = msg->easy_handle;
+      CURLcode code = msg->data.result;
+      libcurl()->curl_multi_remove_handle(multi_, curl);
+      auto it = active_.find(curl);
+      if (it == active_.end()) continue;
+      std::unique_ptr<PendingTransfer> done = std::move(it->second);
+      active_.erase(it);
+      done->done(CompleteTransfer(done->transfer, code));
+    }
+
+    libcurl()->curl_multi_poll(multi_, kPollTimeoutMs, nullptr);
+  }
+
+  for (auto &[curl, pending] : active_) {
+    libcurl()->curl_multi_remove_handle(multi_, curl);
+    ReleaseTransfer(pending->transfer);
+    pending->done(absl::CancelledError("HTTP client is shutting down"));
+  }
+  active_.clear();
+}
+
 }  // namespace ecclesia
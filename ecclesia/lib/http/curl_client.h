@@ -22,13 +22,18 @@
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <variant>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/synchronization/mutex.h"
 #include "curl/curl.h"
 #include "ecclesia/lib/http/client.h"
 #include "ecclesia/lib/http/cred.pb.h"
+#include "ecclesia/lib/thread/thread.h"
 
 namespace ecclesia {
 
@@ -97,6 +102,18 @@ class LibCurl {
   virtual CURLSHcode curl_share_setopt(CURLSH *share, CURLSHoption option,
                                        void (*param)(CURL *, curl_lock_data,
                                                      void *)) = 0;
+
+  virtual CURLM *curl_multi_init() = 0;
+  virtual CURLMcode curl_multi_cleanup(CURLM *multi) = 0;
+  virtual CURLMcode curl_multi_setopt(CURLM *multi, CURLMoption option,
+                                      uint64_t param) = 0;
+  virtual CURLMcode curl_multi_add_handle(CURLM *multi, CURL *curl) = 0;
+  virtual CURLMcode curl_multi_remove_handle(CURLM *multi, CURL *curl) = 0;
+  virtual CURLMcode curl_multi_perform(CURLM *multi, int *running_handles) = 0;
+  virtual CURLMcode curl_multi_poll(CURLM *multi, int timeout_ms,
+                                    int *numfds) = 0;
+  virtual CURLMcode curl_multi_wakeup(CURLM *multi) = 0;
+  virtual CURLMsg *curl_multi_info_read(CURLM *multi, int *msgs_in_queue) = 0;
 };
 
 class LibCurlProxy : public LibCurl {
@@ -165,10 +182,32 @@ class LibCurlProxy : public LibCurl {
   CURLSHcode curl_share_setopt(CURLSH *share, CURLSHoption option,
                                void (*param)(CURL *, curl_lock_data,
                                              void *)) override;
+
+  CURLM *curl_multi_init() override;
+
+  CURLMcode curl_multi_cleanup(CURLM *multi) override;
+
+  CURLMcode curl_multi_setopt(CURLM *multi, CURLMoption option,
+                              uint64_t param) override;
+
+  CURLMcode curl_multi_add_handle(CURLM *multi, CURL *curl) override;
+
+  CURLMcode curl_multi_remove_handle(CURLM *multi, CURL *curl) override;
+
+  CURLMcode curl_multi_perform(CURLM *multi, int *running_handles) override;
+
+  CURLMcode curl_multi_poll(CURLM *multi, int timeout_ms,
+                            int *numfds) override;
+
+  CURLMcode curl_multi_wakeup(CURLM *multi) override;
+
+  CURLMsg *curl_multi_info_read(CURLM *multi, int *msgs_in_queue) override;
 };
 
-// The cURL client is NOT threadsafe as the underlying curl operations modify
-// internal connection state in the curl handle.
+// The cURL client is threadsafe: requests may be sent concurrently from any
+// number of threads. Each request performs on its own curl easy handle, taken
+// from a pool guarded by a mutex, and the connection, DNS and TLS session
+// caches shared between the handles are guarded by the share locks.
 class CurlHttpClient : public HttpClient {
  public:
   struct Config {
@@ -195,6 +234,27 @@ class CurlHttpClient : public HttpClient {
     int max_recv_speed = -1;
     // CURLOPT_IPRESOLVE
     HttpClient::Resolver resolver = Resolver::kIPAny;
+    // Maximum number of idle curl easy handles kept for reuse across requests.
+    // Pooled handles keep the options above and the credentials applied, so
+    // only per-request options are set on reuse. 0 disables pooling.
+    size_t max_idle_handles = 16;
+    // CURLMOPT_MAX_HOST_CONNECTIONS, only used by CurlMultiHttpClient. Limits
+    // the connections opened to a single host, and thus the transfers in
+    // flight to it since each transfer holds a connection: the bundled curl
+    // is built without HTTP/2. Transfers beyond the limit are queued until a
+    // connection frees up. The default suits BMCs, which typically accept few
+    // concurrent connections; raise it for wider fan-out. 0 means no limit.
+    uint64_t max_host_connections = 4;
+  };
+
+  // Statistics on the reuse of pooled curl easy handles.
+  struct Stats {
+    // Handles created with curl_easy_init.
+    uint64_t handles_created = 0;
+    // Requests served by a handle taken from the idle pool.
+    uint64_t handles_reused = 0;
+    // Handles cleaned up on release because the idle pool was full.
+    uint64_t handles_discarded = 0;
   };
 
   CurlHttpClient(std::unique_ptr<LibCurl> libcurl,
@@ -220,27 +280,56 @@ class CurlHttpClient : public HttpClient {
 
   Config GetConfig() const { return config_; }
 
+  Stats GetStats() const ABSL_LOCKS_EXCLUDED(handle_pool_mutex_);
+
+ protected:
+  // State of a single request. It must stay at a stable address from
+  // PrepareTransfer until CompleteTransfer as curl writes into it.
+  struct Transfer {
+    std::unique_ptr<HttpRequest> request;
+    CURL *curl = nullptr;
+    struct curl_slist *request_headers = nullptr;
+    char errbuf[CURL_ERROR_SIZE];
+    std::string response_body;
+    HttpHeaders response_headers;
+  };
+
+  // Acquires an easy handle for transfer.request and sets up all of its
+  // request-specific options, ready to be performed.
+  absl::Status PrepareTransfer(Protocol cmd, Transfer &transfer);
+  // Builds the response of a performed transfer, given the result code of the
+  // transfer, and releases its easy handle.
+  absl::StatusOr<HttpResponse> CompleteTransfer(Transfer &transfer,
+                                                CURLcode code);
+  // Releases the easy handle and request headers held by a transfer.
+  void ReleaseTransfer(Transfer &transfer);
+
+  LibCurl *libcurl() const { return libcurl_.get(); }
+
  private:
   absl::StatusOr<HttpResponse> HttpMethod(Protocol cmd,
                                           std::unique_ptr<HttpRequest> request);
   void SetDefaultCurlOpts(CURL *curl) const;
+
+  // Returns an easy handle with the default options and credentials applied,
+  // taken from the idle pool if one is available. Returns nullptr if a new
+  // handle could not be created.
+  CURL *AcquireHandle() ABSL_LOCKS_EXCLUDED(handle_pool_mutex_);
+  // Clears the per-request options of a handle returned by AcquireHandle and
+  // puts it back into the idle pool, or cleans it up if the pool is full.
+  void ReleaseHandle(CURL *curl) ABSL_LOCKS_EXCLUDED(handle_pool_mutex_);
   static size_t HeaderCallback(const void *data, size_t size, size_t nmemb,
                                void *userp);
   static size_t BodyCallback(const void *data, size_t size, size_t nmemb,
                              void *userp);
 
-  // The following mutex is used to statically lock the CURLSH pointer
-  // shared_connection_.
-  static absl::Mutex shared_mutex_;
-
-  // Locking and unlocking functions to be passed to Libcurl share interface
-  // The parameters are required by share interface but are unused in the actual
-  // function definition.
+  // Locking and unlocking functions to be passed to Libcurl share interface.
+  // useptr is the CurlHttpClient owning the share; each kind of shared data
+  // is guarded by its own mutex in share_mutexes_.
   static void LockSharedMutex(CURL *handle, curl_lock_data data,
-                              curl_lock_access laccess, void *useptr)
-      ABSL_EXCLUSIVE_LOCK_FUNCTION(shared_mutex_);
-  static void UnlockSharedMutex(CURL *handle, curl_lock_data data, void *useptr)
-      ABSL_UNLOCK_FUNCTION(shared_mutex_);
+                              curl_lock_access laccess, void *useptr);
+  static void UnlockSharedMutex(CURL *handle, curl_lock_data data,
+                                void *useptr);
 
   std::unique_ptr<LibCurl> libcurl_;
   Config config_;
@@ -250,8 +339,63 @@ class CurlHttpClient : public HttpClient {
   // CURL share interface (https://curl.se/libcurl/c/libcurl-share.html)
   // The share interface lets us captalize on the fact that we're connecting to
   // the same endpoints. By doing so, we can save CPU usage on setting and
-  // finding connections (e.g. TCP handshake)
+  // finding connections (e.g. TCP handshake), DNS lookups and TLS handshakes.
   CURLSH *shared_connection_;
+  // Guards the data shared through shared_connection_, one mutex per
+  // curl_lock_data kind so that e.g. DNS cache lookups do not wait on
+  // connection cache updates.
+  absl::Mutex share_mutexes_[CURL_LOCK_DATA_LAST];
+
+  // Idle easy handles available for reuse. Reusing a handle keeps its
+  // connection, DNS and TLS session state in addition to its options.
+  mutable absl::Mutex handle_pool_mutex_;
+  std::vector<CURL *> idle_handles_ ABSL_GUARDED_BY(handle_pool_mutex_);
+  Stats stats_ ABSL_GUARDED_BY(handle_pool_mutex_);
+};
+
+// A cURL client which performs requests started with StartRequest (and thus
+// ExecuteBatch) concurrently, driving a curl multi handle from a single event
+// loop thread. Transfers to the same host reuse the connections of completed
+// transfers, and at most Config::max_host_connections of them are in flight
+// to a host at a time. The blocking methods
+// inherited from CurlHttpClient still run on the calling thread.
+//
+// Completion callbacks run on the event loop thread. Requests which have not
+// completed when the client is destroyed complete with a CANCELLED status.
+class CurlMultiHttpClient : public CurlHttpClient {
+ public:
+  CurlMultiHttpClient(std::unique_ptr<LibCurl> libcurl,
+                      std::variant<HttpCredential, TlsCredential> cred);
+  CurlMultiHttpClient(std::unique_ptr<LibCurl> libcurl,
+                      std::variant<HttpCredential, TlsCredential> cred,
+                      Config config);
+  ~CurlMultiHttpClient() override;
+
+  void StartRequest(Protocol cmd, std::unique_ptr<HttpRequest> request,
+                    ResponseCallback done) override;
+
+ private:
+  struct PendingTransfer {
+    Transfer transfer;
+    ResponseCallback done;
+  };
+
+  // Runs curl_multi_perform until the client is destroyed.
+  void EventLoop();
+
+  CURLM *const multi_;
+
+  absl::Mutex mutex_;
+  // Transfers started but not yet added to the multi handle.
+  std::vector<std::unique_ptr<PendingTransfer>> pending_
+      ABSL_GUARDED_BY(mutex_);
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+
+  // Transfers added to the multi handle, keyed by easy handle. Only accessed
+  // by the event loop thread.
+  absl::flat_hash_map<CURL *, std::unique_ptr<PendingTransfer>> active_;
+
+  std::unique_ptr<ThreadInterface> event_loop_;
 };
 
 }  // namespace ecclesia
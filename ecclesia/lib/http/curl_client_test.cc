@@ -16,6 +16,7 @@
 
 #include "ecclesia/lib/http/curl_client.h"
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -23,6 +24,7 @@
 #include <cstring>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -33,6 +35,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
 #include "curl/curl.h"
 #include "ecclesia/lib/file/test_filesystem.h"
 #include "ecclesia/lib/http/client.h"
@@ -45,6 +48,7 @@ namespace ecclesia {
 namespace {
 
 using testing::Eq;
+using testing::Ge;
 using testing::Gt;
 
 HttpCredential GetSimpleCredential() {
@@ -426,5 +430,162 @@ TEST_F(CurlHttpClientTest, DeleteError) {
   EXPECT_THAT(result->GetBodyJson(), Eq(result_json));
 }
 
+TEST_F(CurlHttpClientTest, ReusesPooledHandle) {
+  for (int i = 0; i < 3; ++i) {
+    auto req = std::make_unique<HttpClient::HttpRequest>();
+    req->uri = absl::StrFormat("%s/redfish/v1", endpoint_);
+    auto result = curl_http_client_.Get(std::move(req));
+    ASSERT_TRUE(result.ok()) << result.status().message();
+    EXPECT_THAT(result->code, Eq(200));
+  }
+  CurlHttpClient::Stats stats = curl_http_client_.GetStats();
+  EXPECT_THAT(stats.handles_created, Eq(1));
+  EXPECT_THAT(stats.handles_reused, Eq(2));
+  EXPECT_THAT(stats.handles_discarded, Eq(0));
+}
+
+TEST_F(CurlHttpClientTest, PooledHandleDoesNotKeepPreviousMethod) {
+  bool delete_called = false;
+  server_.AddHttpDeleteHandler(
+      "/redfish/v1/Chassis/chassis",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        delete_called = true;
+        req->Reply();
+      });
+
+  auto delete_req = std::make_unique<HttpClient::HttpRequest>();
+  delete_req->uri = absl::StrFormat("%s/redfish/v1/Chassis/chassis", endpoint_);
+  auto delete_result = curl_http_client_.Delete(std::move(delete_req));
+  ASSERT_TRUE(delete_result.ok()) << delete_result.status().message();
+  EXPECT_TRUE(delete_called);
+
+  // The same handle is reused for the GET, which must not be sent as DELETE.
+  delete_called = false;
+  auto get_req = std::make_unique<HttpClient::HttpRequest>();
+  get_req->uri = absl::StrFormat("%s/redfish/v1/Chassis/chassis", endpoint_);
+  auto get_result = curl_http_client_.Get(std::move(get_req));
+  ASSERT_TRUE(get_result.ok()) << get_result.status().message();
+  EXPECT_FALSE(delete_called);
+  EXPECT_THAT(get_result->code, Eq(200));
+  EXPECT_THAT(curl_http_client_.GetStats().handles_reused, Eq(1));
+}
+
+TEST(CurlHttpClientPoolTest, PoolingDisabled) {
+  FakeRedfishServer server("barebones_session_auth/mockup.shar");
+  CurlHttpClient::Config config;
+  config.max_idle_handles = 0;
+  CurlHttpClient client(LibCurlProxy::CreateInstance(), HttpCredential(),
+                        config);
+  for (int i = 0; i < 2; ++i) {
+    auto req = std::make_unique<HttpClient::HttpRequest>();
+    req->uri = absl::StrFormat("%s:%d/redfish/v1", server.GetConfig().hostname,
+                               server.GetConfig().port);
+    auto result = client.Get(std::move(req));
+    ASSERT_TRUE(result.ok()) << result.status().message();
+    EXPECT_THAT(result->code, Eq(200));
+  }
+  CurlHttpClient::Stats stats = client.GetStats();
+  EXPECT_THAT(stats.handles_created, Eq(2));
+  EXPECT_THAT(stats.handles_reused, Eq(0));
+  EXPECT_THAT(stats.handles_discarded, Eq(2));
+}
+
+TEST(CurlMultiHttpClientTest, ExecuteBatchReturnsResponsesInOrder) {
+  FakeRedfishServer server("barebones_session_auth/mockup.shar");
+  std::string endpoint = absl::StrFormat("%s:%d", server.GetConfig().hostname,
+                                         server.GetConfig().port);
+  CurlMultiHttpClient client(LibCurlProxy::CreateInstance(), HttpCredential());
+
+  std::vector<std::string> paths = {"/redfish/v1", "/redfish/v1/Chassis",
+                                    "/redfish/v1/Chassis/chassis",
+                                    "/redfish/v1/SessionService"};
+  std::vector<std::unique_ptr<HttpClient::HttpRequest>> requests;
+  for (int i = 0; i < 10; ++i) {
+    for (const std::string &path : paths) {
+      auto req = std::make_unique<HttpClient::HttpRequest>();
+      req->uri = absl::StrCat(endpoint, path);
+      requests.push_back(std::move(req));
+    }
+  }
+  std::vector<absl::StatusOr<HttpClient::HttpResponse>> responses =
+      client.ExecuteBatch(Protocol::kGet, std::move(requests));
+
+  ASSERT_THAT(responses.size(), Eq(10 * paths.size()));
+  for (size_t i = 0; i < responses.size(); ++i) {
+    ASSERT_TRUE(responses[i].ok()) << responses[i].status().message();
+    EXPECT_THAT(responses[i]->code, Eq(200));
+    EXPECT_THAT(responses[i]->GetBodyJson()["@odata.id"],
+                Eq(paths[i % paths.size()]));
+  }
+}
+
+TEST(CurlMultiHttpClientTest, StartRequestInvokesCallback) {
+  FakeRedfishServer server("barebones_session_auth/mockup.shar");
+  CurlMultiHttpClient client(LibCurlProxy::CreateInstance(), HttpCredential());
+
+  absl::Notification done;
+  absl::StatusOr<HttpClient::HttpResponse> response;
+  auto req = std::make_unique<HttpClient::HttpRequest>();
+  req->uri = absl::StrFormat("%s:%d/redfish/v1", server.GetConfig().hostname,
+                             server.GetConfig().port);
+  client.StartRequest(Protocol::kGet, std::move(req),
+                      [&](absl::StatusOr<HttpClient::HttpResponse> resp) {
+                        response = std::move(resp);
+                        done.Notify();
+                      });
+  done.WaitForNotification();
+  ASSERT_TRUE(response.ok()) << response.status().message();
+  EXPECT_THAT(response->code, Eq(200));
+  EXPECT_THAT(response->GetBodyJson()["@odata.id"], Eq("/redfish/v1"));
+}
+
+TEST_F(CurlHttpClientTest, ConcurrentGetsAcrossClients) {
+  CurlHttpClient other_client(LibCurlProxy::CreateInstance(),
+                              HttpCredential());
+  constexpr int kThreads = 8;
+  constexpr int kRequestsPerThread = 20;
+  std::atomic<int> successes = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    CurlHttpClient *client =
+        t % 2 == 0 ? &curl_http_client_ : &other_client;
+    threads.emplace_back([&, client]() {
+      for (int i = 0; i < kRequestsPerThread; ++i) {
+        auto req = std::make_unique<HttpClient::HttpRequest>();
+        req->uri = absl::StrFormat("%s/redfish/v1", endpoint_);
+        auto result = client->Get(std::move(req));
+        if (result.ok() && result->code == 200) ++successes;
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+  EXPECT_THAT(successes.load(), Eq(kThreads * kRequestsPerThread));
+}
+
+TEST_F(CurlHttpClientTest, GetLargeBodyPreallocatedFromContentLength) {
+  nlohmann::json members = nlohmann::json::array();
+  for (int i = 0; i < 20000; ++i) {
+    members.push_back(
+        {{"@odata.id", absl::StrCat("/redfish/v1/Chassis/chassis/Sensors/", i)},
+         {"Reading", i}});
+  }
+  nlohmann::json expected = {{"Members", members}};
+  std::string data = expected.dump();
+  server_.AddHttpGetHandlerWithData("/redfish/v1/Chassis", data);
+
+  auto req = std::make_unique<HttpClient::HttpRequest>();
+  req->uri = absl::StrFormat("%s/redfish/v1/Chassis", endpoint_);
+  auto result = curl_http_client_.Get(std::move(req));
+  ASSERT_TRUE(result.ok()) << result.status().message();
+  EXPECT_THAT(result->code, Eq(200));
+  EXPECT_THAT(result->body.size(), Eq(data.size()));
+  EXPECT_THAT(result->GetBodyJson(), Eq(expected));
+  // The body buffer is reserved from Content-Length. How far past that a
+  // string may grow is up to the standard library, so only the header the
+  // reservation relies on and the lower bound are checked.
+  ASSERT_TRUE(result->headers.contains("Content-Length"));
+  EXPECT_THAT(result->body.capacity(), Ge(data.size()));
+}
+
 }  // namespace
 }  // namespace ecclesia
@@ -0,0 +1,68 @@
+"""Starlark definitions for build rules embedding compiled Dellicius queries."""
+
+load("//ecclesia/build_defs:embed.bzl", "cc_data_library")
+
+def cc_compiled_query_library(
+        name,
+        queries,
+        cc_namespace,
+        var_name,
+        query_rules = [],
+        visibility = None):
+    """Define a data library containing Dellicius queries compiled at build time.
+
+    The queries are compiled along with their query rules into a binary
+    CompiledQueries proto, named ${name}.binarypb, which is embedded in a
+    cc_library generated by cc_data_library. The embedded files are meant to be
+    passed to QueryEngine through QueryEngineConfiguration::compiled_queries,
+    which then builds the query plans without parsing any text.
+
+    The build fails if a query cannot be compiled, e.g. for a malformed RedPath
+    or a loop in the links between subqueries.
+
+    Args:
+      name: The name of the cc_library that will contain the compiled queries.
+      queries: A list of DelliciusQuery text proto files to compile.
+      cc_namespace: The C++ namespace to wrap the generated variable into.
+      var_name: The name of the C++ variable used to access the data.
+      query_rules: A list of QueryRules text proto files for the queries.
+      visibility: The visibility of the generated cc_library.
+    """
+
+    # Route the files through filegroups, for the same reason as
+    # cc_data_library does. The compiler takes the query rules as a single
+    # comma-separated flag.
+    native.filegroup(
+        name = name + "__queries_filegroup",
+        srcs = queries,
+    )
+    srcs = [":" + name + "__queries_filegroup"]
+    query_rules_arg = ""
+    if query_rules:
+        native.filegroup(
+            name = name + "__query_rules_filegroup",
+            srcs = query_rules,
+        )
+        srcs.append(":" + name + "__query_rules_filegroup")
+        query_rules_arg = (
+            "--query_rules=$$(echo $(locations :%s__query_rules_filegroup) | tr ' ' ',') " %
+            name
+        )
+    native.genrule(
+        name = name + "__compiler",
+        srcs = srcs,
+        outs = [name + ".binarypb"],
+        cmd = ("$(location //ecclesia/lib/redfish/dellicius/tools:query_compiler) " +
+               "--output=$@ %s$(locations :%s__queries_filegroup)") %
+              (query_rules_arg, name),
+        exec_tools = ["//ecclesia/lib/redfish/dellicius/tools:query_compiler"],
+    )
+
+    cc_data_library(
+        name = name,
+        cc_namespace = cc_namespace,
+        data = [":" + name + ".binarypb"],
+        flatten = True,
+        var_name = var_name,
+        visibility = visibility,
+    )
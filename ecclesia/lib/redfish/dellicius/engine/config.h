@@ -18,8 +18,10 @@
 #define ECCLESIA_LIB_REDFISH_DELLICIUS_ENGINE_CONFIG_H_
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
 #include "ecclesia/lib/file/cc_embed_interface.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 
 namespace ecclesia {
 
@@ -32,11 +34,33 @@ struct QueryEngineConfiguration {
     // nodes of the redfish tree queried. The lifetime of cache is tied to the
     // lifetime of the query engine instance.
     bool enable_cached_uri_dispatch = false;
+    // Configures Query Engine to execute queries incrementally: the URIs the
+    // RedPaths resolve to are recorded, and later executions only fetch the
+    // resources the queries read rather than walking the Redfish tree from the
+    // service root. Suited to polling the same queries, e.g. sensor readings.
+    bool enable_incremental_execution = false;
   };
   Flags flags;
   // available and not passed to QueryEngine through engine configuration.
   std::vector<EmbeddedFile> query_files;
   std::vector<EmbeddedFile> query_rules;
+  // Queries compiled at build time with cc_compiled_query_library, along with
+  // their query rules. Their query plans are built without parsing any text,
+  // and take precedence over query_files with the same query id.
+  std::vector<EmbeddedFile> compiled_queries;
+  // Executor on which the Redfish requests of sibling RedPath steps, like
+  // /Chassis[1]/Sensors and /Chassis[2]/Sensors, are dispatched concurrently.
+  // Requests are dispatched one at a time if it is null. Not owned, it must
+  // outlive the QueryEngine, and the RedfishInterface given to the engine must
+  // support concurrent requests if it is set. Interfaces from NewHttpInterface
+  // do when their transport and cache do; the stock ones all qualify:
+  // HttpRedfishTransport with CurlHttpClient, the gRPC transport,
+  // MetricalRedfishTransport, RedfishLoggedTransport, NullCache and
+  // TimeBasedCache.
+  ThreadPool *executor = nullptr;
+  // Interval at which incremental executions walk the Redfish tree from the
+  // service root again, to discover the resources added since.
+  absl::Duration rediscovery_interval = absl::Minutes(5);
 };
 
 }  // namespace ecclesia
@@ -31,9 +31,14 @@
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "ecclesia/lib/redfish/dellicius/engine/compiled_query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/predicate.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/query_planner.h"
+#include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
+#include "ecclesia/lib/redfish/dellicius/utils/parsers.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "re2/re2.h"
 
 namespace ecclesia {
@@ -70,19 +75,38 @@ absl::StatusOr<std::vector<RedPathStep>> RedPathToSteps(
   return steps;
 }
 
+// Compiles the predicate of each RedPath step.
+absl::StatusOr<std::vector<RedPathPredicate>> CompilePredicates(
+    const std::vector<RedPathStep> &steps) {
+  std::vector<RedPathPredicate> predicates;
+  predicates.reserve(steps.size());
+  for (const auto &[node_name, predicate] : steps) {
+    absl::StatusOr<RedPathPredicate> compiled =
+        RedPathPredicate::Compile(predicate);
+    if (!compiled.ok()) return compiled.status();
+    predicates.push_back(*std::move(compiled));
+  }
+  return predicates;
+}
+
 // Generates SubqueryHandles for all Root Subqueries after resolving links
 // within each subquery.
+// RedPaths are parsed unless they come precompiled with a CompiledQuery.
 class SubqueryHandleFactory {
  public:
   static absl::StatusOr<SubqueryHandleCollection> CreateSubqueryHandles(
-      const DelliciusQuery &query, Normalizer *normalizer) {
-    return std::move(SubqueryHandleFactory(query, normalizer))
+      const DelliciusQuery &query, Normalizer *normalizer,
+      const CompiledQuery *compiled_query = nullptr) {
+    return std::move(SubqueryHandleFactory(query, normalizer, compiled_query))
         .GetSubqueryHandles();
   }
 
  private:
-  SubqueryHandleFactory(const DelliciusQuery &query, Normalizer *normalizer)
-      : query_(query), normalizer_(normalizer) {
+  SubqueryHandleFactory(const DelliciusQuery &query, Normalizer *normalizer,
+                        const CompiledQuery *compiled_query)
+      : query_(query),
+        normalizer_(normalizer),
+        compiled_query_(compiled_query) {
     for (const auto &subquery : query.subquery()) {
       id_to_subquery_[subquery.subquery_id()] = subquery;
     }
@@ -140,14 +164,19 @@ class SubqueryHandleFactory {
       return absl::OkStatus();
     }
     // Create a new SubqueryHandle.
-    absl::StatusOr<std::vector<RedPathStep>> steps =
-        RedPathToSteps(subquery.redpath());
+    absl::StatusOr<std::vector<RedPathStep>> steps = GetRedPathSteps(subquery);
     if (!steps.ok()) {
       LOG(ERROR) << "Cannot create SubqueryHandle for " << subquery_id;
       return steps.status();
     }
+    absl::StatusOr<std::vector<RedPathPredicate>> predicates =
+        CompilePredicates(*steps);
+    if (!predicates.ok()) {
+      LOG(ERROR) << "Cannot create SubqueryHandle for " << subquery_id;
+      return predicates.status();
+    }
     auto new_subquery_handle = std::make_unique<QueryPlanner::SubqueryHandle>(
-        subquery, steps.value(), normalizer_);
+        subquery, *std::move(steps), *std::move(predicates), normalizer_);
     // Raw pointer used to link SubqueryHandle with parent subquery if any.
     QueryPlanner::SubqueryHandle *new_subquery_handle_ptr =
         new_subquery_handle.get();
@@ -175,27 +204,92 @@ class SubqueryHandleFactory {
     return absl::OkStatus();
   }
 
+  // Returns the RedPath steps of the subquery from the compiled query if any,
+  // or parses them from the RedPath.
+  absl::StatusOr<std::vector<RedPathStep>> GetRedPathSteps(
+      const DelliciusQuery::Subquery &subquery) const {
+    if (compiled_query_ == nullptr) return RedPathToSteps(subquery.redpath());
+    auto iter = compiled_query_->subquery_id_to_redpath_steps().find(
+        subquery.subquery_id());
+    if (iter == compiled_query_->subquery_id_to_redpath_steps().end()) {
+      return absl::InternalError(absl::StrFormat(
+          "Cannot find compiled RedPath for subquery id: %s",
+          subquery.subquery_id()));
+    }
+    std::vector<RedPathStep> steps;
+    steps.reserve(iter->second.step_size());
+    for (const CompiledQuery::RedPathStep &step : iter->second.step()) {
+      steps.push_back({step.node_name(), step.predicate()});
+    }
+    return steps;
+  }
+
   const DelliciusQuery &query_;
   absl::flat_hash_map<std::string,
                       std::unique_ptr<QueryPlanner::SubqueryHandle>>
       id_to_subquery_handle_;
   absl::flat_hash_map<std::string, DelliciusQuery::Subquery> id_to_subquery_;
   Normalizer *normalizer_;
+  const CompiledQuery *compiled_query_;
 };
 
 }  // namespace
 
 // Builds the default query planner.
-absl::StatusOr<std::unique_ptr<QueryPlannerInterface>> BuildQueryPlanner(
+absl::StatusOr<std::unique_ptr<QueryPlanner>> BuildQueryPlanner(
     const DelliciusQuery &query, RedPathRedfishQueryParams query_params,
-    Normalizer *normalizer) {
+    Normalizer *normalizer, ThreadPool *executor) {
   absl::StatusOr<SubqueryHandleCollection> subquery_handle_collection =
       SubqueryHandleFactory::CreateSubqueryHandles(query, normalizer);
   if (!subquery_handle_collection.ok()) {
     return subquery_handle_collection.status();
   }
   return std::make_unique<QueryPlanner>(
-      query, *std::move(subquery_handle_collection), std::move(query_params));
+      query, *std::move(subquery_handle_collection), std::move(query_params),
+      executor);
+}
+
+absl::StatusOr<CompiledQuery> CompileQuery(
+    const DelliciusQuery &query,
+    const QueryRules::RedPathPrefixSetWithQueryParams &query_rule) {
+  CompiledQuery compiled_query;
+  for (const auto &subquery : query.subquery()) {
+    absl::StatusOr<std::vector<RedPathStep>> steps =
+        RedPathToSteps(subquery.redpath());
+    if (!steps.ok()) return steps.status();
+    CompiledQuery::RedPathSteps &compiled_steps =
+        (*compiled_query.mutable_subquery_id_to_redpath_steps())
+            [subquery.subquery_id()];
+    for (auto &[node_name, predicate] : *steps) {
+      CompiledQuery::RedPathStep *step = compiled_steps.add_step();
+      step->set_node_name(std::move(node_name));
+      step->set_predicate(std::move(predicate));
+    }
+  }
+  *compiled_query.mutable_query() = query;
+  *compiled_query.mutable_query_rule() = query_rule;
+  // Check the links between subqueries the way the query plan would.
+  absl::StatusOr<SubqueryHandleCollection> subquery_handle_collection =
+      SubqueryHandleFactory::CreateSubqueryHandles(
+          compiled_query.query(), /*normalizer=*/nullptr, &compiled_query);
+  if (!subquery_handle_collection.ok()) {
+    return subquery_handle_collection.status();
+  }
+  return compiled_query;
+}
+
+absl::StatusOr<std::unique_ptr<QueryPlanner>> BuildQueryPlanner(
+    const CompiledQuery &compiled_query, Normalizer *normalizer,
+    ThreadPool *executor) {
+  absl::StatusOr<SubqueryHandleCollection> subquery_handle_collection =
+      SubqueryHandleFactory::CreateSubqueryHandles(
+          compiled_query.query(), normalizer, &compiled_query);
+  if (!subquery_handle_collection.ok()) {
+    return subquery_handle_collection.status();
+  }
+  return std::make_unique<QueryPlanner>(
+      compiled_query.query(), *std::move(subquery_handle_collection),
+      ParseQueryRule(compiled_query.query_rule()), executor);
 }
 
 }  // namespace ecclesia
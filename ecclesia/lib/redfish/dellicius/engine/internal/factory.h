@@ -20,10 +20,14 @@
 #include <memory>
 
 #include "absl/memory/memory.h"
+#include "ecclesia/lib/redfish/dellicius/engine/compiled_query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/normalizer.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/query_planner.h"
+#include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
 #include "ecclesia/lib/redfish/node_topology.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 
 namespace ecclesia {
 
@@ -45,10 +49,26 @@ inline std::unique_ptr<Normalizer> BuildDefaultNormalizerWithDevpath(
   return normalizer;
 }
 
-// Builds the default query planner.
-absl::StatusOr<std::unique_ptr<QueryPlannerInterface>> BuildQueryPlanner(
+// Builds the default query planner. If an executor is given, the planner
+// dispatches the Redfish requests of sibling RedPath steps concurrently on it.
+// Query planners built this way can also run together through
+// QueryPlanner::RunMultiple.
+absl::StatusOr<std::unique_ptr<QueryPlanner>> BuildQueryPlanner(
     const DelliciusQuery &query, RedPathRedfishQueryParams query_params,
-    Normalizer *normalizer);
+    Normalizer *normalizer, ThreadPool *executor = nullptr);
+
+// Compiles a query along with its query rule, to be embedded in a binary and
+// built into a query plan at startup without any parsing. RedPaths and links
+// between subqueries are checked as BuildQueryPlanner would.
+absl::StatusOr<CompiledQuery> CompileQuery(
+    const DelliciusQuery &query,
+    const QueryRules::RedPathPrefixSetWithQueryParams &query_rule);
+
+// Builds the default query planner for a compiled query, with the Redfish
+// query parameters of its query rule.
+absl::StatusOr<std::unique_ptr<QueryPlanner>> BuildQueryPlanner(
+    const CompiledQuery &compiled_query, Normalizer *normalizer,
+    ThreadPool *executor = nullptr);
 
 }  // namespace ecclesia
 
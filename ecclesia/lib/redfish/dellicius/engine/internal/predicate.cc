@@ -0,0 +1,227 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/dellicius/engine/internal/predicate.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "ecclesia/lib/redfish/dellicius/utils/path_util.h"
+#include "re2/re2.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+
+namespace {
+
+// Pattern for predicate formatted with relational operators:
+constexpr LazyRE2 kPredicateRegexRelationalOperator = {
+    "^([a-zA-Z#@][0-9a-zA-Z.]*)(?:(!=|>|<|=|>=|<=))([a-zA-Z0-9._#]+)$"};
+
+constexpr absl::string_view kPredicateSelectAll = "*";
+constexpr absl::string_view kPredicateSelectLastIndex = "last()";
+constexpr absl::string_view kBinaryOperandTrue = "true";
+constexpr absl::string_view kBinaryOperandFalse = "false";
+constexpr absl::string_view kBinaryOperandNull = "null";
+constexpr absl::string_view kLogicalOperatorAnd = "and";
+constexpr absl::string_view kLogicalOperatorOr = "or";
+
+// Returns the property at the given path within the node, nullptr if there is
+// no such property.
+const nlohmann::json *FindProperty(const nlohmann::json &node_content,
+                                   const std::vector<std::string> &node_names) {
+  const nlohmann::json *json_obj = &node_content;
+  for (const std::string &name : node_names) {
+    auto iter = json_obj->find(name);
+    if (iter == json_obj->end()) return nullptr;
+    json_obj = &*iter;
+  }
+  return json_obj;
+}
+
+}  // namespace
+
+absl::StatusOr<RedPathPredicate> RedPathPredicate::Compile(
+    absl::string_view predicate) {
+  auto invalid = [predicate]() {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid predicate expression ", predicate));
+  };
+  RedPathPredicate compiled;
+  absl::string_view logical_operation = kLogicalOperatorAnd;
+  for (absl::string_view expr : absl::StrSplit(predicate, ' ')) {
+    // If expression is a logical operator, capture it and move to next
+    // expression
+    if (expr == kLogicalOperatorAnd || expr == kLogicalOperatorOr) {
+      // A binary operator is parsed only when last operator has been applied.
+      // Since last operator has not been applied and we are seeing another
+      // operator in the expression, it can be considered an invalid expression.
+      if (!logical_operation.empty()) {
+        return invalid();
+      }
+      logical_operation = expr;
+      continue;
+    }
+
+    // There should always be a logical operation defined for the predicates.
+    // Default logical operation is 'AND' between a predicate expression and
+    // default boolean operand 'true'
+    if (logical_operation.empty()) {
+      return invalid();
+    }
+
+    Expression expression;
+    expression.is_or = logical_operation == kLogicalOperatorOr;
+    if (expr == kPredicateSelectLastIndex) {
+      expression.type = Expression::Type::kSelectLast;
+    } else if (absl::SimpleAtoi(expr, &expression.index)) {
+      expression.type = Expression::Type::kSelectIndex;
+    } else if (expr.empty() || expr == kPredicateSelectAll) {
+      expression.type = Expression::Type::kSelectAll;
+    } else if (absl::StrContains(expr, '<') || absl::StrContains(expr, '>') ||
+               absl::StrContains(expr, '=')) {
+      // Predicate expression containing relational operators.
+      std::string node_name, op, test_value;
+      if (!RE2::FullMatch(expr, *kPredicateRegexRelationalOperator,
+                          &node_name, &op, &test_value)) {
+        return invalid();
+      }
+      expression.type = Expression::Type::kCompare;
+      expression.node_names = SplitNodeNameForNestedNodes(node_name);
+      if (op == "!=") {
+        expression.op = Operator::kNotEqual;
+      } else if (op == "<") {
+        expression.op = Operator::kLess;
+      } else if (op == ">") {
+        expression.op = Operator::kGreater;
+      } else if (op == "<=") {
+        expression.op = Operator::kLessOrEqual;
+      } else if (op == ">=") {
+        expression.op = Operator::kGreaterOrEqual;
+      }
+      double number;
+      if (absl::SimpleAtod(test_value, &number)) {
+        expression.value = number;
+      } else if (test_value == kBinaryOperandTrue ||
+                 test_value == kBinaryOperandFalse) {
+        expression.value = test_value == kBinaryOperandTrue;
+      } else if (test_value == kBinaryOperandNull) {
+        expression.value = nullptr;
+      } else {
+        expression.value = std::move(test_value);
+      }
+      compiled.needs_node_content_ = true;
+    } else {
+      // Filter node-set by NodeName
+      expression.type = Expression::Type::kHas;
+      expression.node_names = SplitNodeNameForNestedNodes(expr);
+      compiled.needs_node_content_ = true;
+    }
+    compiled.expressions_.push_back(std::move(expression));
+    // Reset logical operation
+    logical_operation = "";
+  }
+  // A trailing logical operator has no right operand.
+  if (!logical_operation.empty()) return invalid();
+  return compiled;
+}
+
+bool RedPathPredicate::Evaluate(size_t node_index, size_t node_set_size,
+                                const nlohmann::json &node_content) const {
+  bool is_filter_success = true;
+  for (const Expression &expression : expressions_) {
+    // Expressions have no side effect, so those which cannot change the
+    // outcome are skipped.
+    if (expression.is_or == is_filter_success) continue;
+    is_filter_success = EvaluateExpression(expression, node_index,
+                                           node_set_size, node_content);
+  }
+  return is_filter_success;
+}
+
+bool RedPathPredicate::EvaluateExpression(const Expression &expression,
+                                          size_t node_index,
+                                          size_t node_set_size,
+                                          const nlohmann::json &node_content) {
+  switch (expression.type) {
+    case Expression::Type::kSelectAll:
+      return true;
+    case Expression::Type::kSelectLast:
+      return node_index == node_set_size - 1;
+    case Expression::Type::kSelectIndex:
+      return node_index == expression.index;
+    case Expression::Type::kHas:
+      return !expression.node_names.empty() &&
+             FindProperty(node_content, expression.node_names) != nullptr;
+    case Expression::Type::kCompare:
+      break;
+  }
+
+  if (expression.node_names.empty()) return false;
+  const nlohmann::json *json_obj =
+      FindProperty(node_content, expression.node_names);
+  if (json_obj == nullptr) return false;
+
+  // Number comparison.
+  if (const double *value = std::get_if<double>(&expression.value)) {
+    double number;
+    if (json_obj->is_number()) {
+      number = json_obj->get<double>();
+    } else if (!json_obj->is_string() ||
+               !absl::SimpleAtod(json_obj->get_ref<const std::string &>(),
+                                 &number)) {
+      return false;
+    }
+    switch (expression.op) {
+      case Operator::kEqual:
+        return number == *value;
+      case Operator::kNotEqual:
+        return number != *value;
+      case Operator::kLess:
+        return number < *value;
+      case Operator::kGreater:
+        return number > *value;
+      case Operator::kLessOrEqual:
+        return number <= *value;
+      case Operator::kGreaterOrEqual:
+        return number >= *value;
+    }
+    return false;
+  }
+
+  // Other values are only tested for equality, or inequality with '!='.
+  bool is_equal;
+  if (const bool *value = std::get_if<bool>(&expression.value)) {
+    is_equal = *json_obj == *value;
+  } else if (std::holds_alternative<std::nullptr_t>(expression.value)) {
+    is_equal = json_obj->is_null();
+  } else {
+    is_equal = *json_obj == std::get<std::string>(expression.value);
+  }
+  return expression.op == Operator::kNotEqual ? !is_equal : is_equal;
+}
+
+}  // namespace ecclesia
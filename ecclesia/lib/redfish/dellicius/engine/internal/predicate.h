@@ -0,0 +1,98 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ECCLESIA_LIB_REDFISH_DELLICIUS_ENGINE_INTERNAL_PREDICATE_H_
+#define ECCLESIA_LIB_REDFISH_DELLICIUS_ENGINE_INTERNAL_PREDICATE_H_
+
+#include <cstddef>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+
+// Predicate expression of a RedPath step, compiled once when the query plan is
+// built and then evaluated on each node of the node-sets the step selects.
+//
+// A predicate is a list of expressions separated by spaces and combined from
+// left to right by the logical operators 'and' and 'or', without precedence.
+// Each expression is one of:
+//   * empty or '*', which selects all the nodes;
+//   * 'last()', which selects the last node of the node-set;
+//   * an index, which selects the node at this index in the node-set;
+//   * 'NodeName<op>value', which compares a property of the node with a
+//     number, 'true', 'false', 'null' or a string, <op> being one of
+//     =, !=, <, >, <= and >=;
+//   * 'NodeName', which selects the nodes that have the property.
+// NodeName may refer to a nested property, e.g. 'Status.Health'.
+class RedPathPredicate {
+ public:
+  // Compiles a predicate expression. Returns InvalidArgument if the expression
+  // is invalid.
+  static absl::StatusOr<RedPathPredicate> Compile(absl::string_view predicate);
+
+  // Returns true if the predicate reads properties of the nodes, in which case
+  // Evaluate needs the content of the node.
+  bool NeedsNodeContent() const { return needs_node_content_; }
+
+  // Returns true if the node at node_index in a node-set of node_set_size
+  // nodes satisfies the predicate. node_content is the JSON content of the
+  // node, and is only read if NeedsNodeContent().
+  bool Evaluate(size_t node_index, size_t node_set_size,
+                const nlohmann::json &node_content) const;
+
+ private:
+  enum class Operator {
+    kEqual,
+    kNotEqual,
+    kLess,
+    kGreater,
+    kLessOrEqual,
+    kGreaterOrEqual,
+  };
+
+  struct Expression {
+    enum class Type { kSelectAll, kSelectLast, kSelectIndex, kCompare, kHas };
+    Type type;
+    // Whether the expression is combined with the previous ones by 'or'
+    // rather than 'and'.
+    bool is_or = false;
+    // Index of the node for kSelectIndex.
+    size_t index = 0;
+    // Path to the property for kCompare and kHas.
+    std::vector<std::string> node_names;
+    // Operator and value for kCompare.
+    Operator op = Operator::kEqual;
+    std::variant<double, bool, std::nullptr_t, std::string> value;
+  };
+
+  RedPathPredicate() = default;
+
+  static bool EvaluateExpression(const Expression &expression,
+                                 size_t node_index, size_t node_set_size,
+                                 const nlohmann::json &node_content);
+
+  std::vector<Expression> expressions_;
+  bool needs_node_content_ = false;
+};
+
+}  // namespace ecclesia
+
+#endif  // ECCLESIA_LIB_REDFISH_DELLICIUS_ENGINE_INTERNAL_PREDICATE_H_
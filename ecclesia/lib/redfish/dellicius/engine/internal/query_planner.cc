@@ -16,7 +16,9 @@
 
 #include "ecclesia/lib/redfish/dellicius/engine/internal/query_planner.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -26,24 +28,28 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
-#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
-#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/predicate.h"
 #include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query_result.pb.h"
-#include "ecclesia/lib/redfish/dellicius/utils/path_util.h"
 #include "ecclesia/lib/redfish/interface.h"
+#include "ecclesia/lib/redfish/property_definitions.h"
 #include "ecclesia/lib/status/macros.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "ecclesia/lib/time/proto.h"
-#include "re2/re2.h"
+#include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
 
@@ -51,191 +57,155 @@ namespace {
 
 using SubqueryHandle = QueryPlanner::SubqueryHandle;
 
-// Pattern for predicate formatted with relational operators:
-constexpr LazyRE2 kPredicateRegexRelationalOperator = {
-    "^([a-zA-Z#@][0-9a-zA-Z.]*)(?:(!=|>|<|=|>=|<=))([a-zA-Z0-9._#]+)$"};
-
 constexpr absl::string_view kPredicateSelectAll = "*";
-constexpr absl::string_view kPredicateSelectLastIndex = "last()";
-constexpr absl::string_view kBinaryOperandTrue = "true";
-constexpr absl::string_view kBinaryOperandFalse = "false";
-constexpr absl::string_view kLogicalOperatorAnd = "and";
-constexpr absl::string_view kLogicalOperatorOr = "or";
-// Supported relational operators
-constexpr std::array<const char *, 6> kRelationsOperators = {
-    "<", ">", "!=", ">=", "<=", "="};
-
-template <typename F>
-bool ApplyNumberComparisonFilter(const nlohmann::json &obj, F comparator) {
-  double number;
-  if (obj.is_number()) {
-    number = obj.get<double>();
-  } else if (!obj.is_string() ||
-             !absl::SimpleAtod(obj.get<std::string>(), &number)) {
-    return false;
-  }
-  return comparator(number);
-}
 
-// Helper function is used to ensure the obtained value equal or not equal to a
-// non-number value.
-template <typename F>
-bool ApplyStringComparisonFilter(F filter_condition,
-                                 absl::string_view inequality_string) {
-  if (inequality_string == "!=") {
-    return !filter_condition();
+// Returns the query parameters the query plan of a RedPath sets for the given
+// RedPath, which are the default ones if none are set.
+GetParams GetParamsForRedPath(const QueryPlanner::RedPathContext &redpath_ctx,
+                              const std::string &redpath) {
+  if (redpath_ctx.query_params != nullptr) {
+    if (auto iter = redpath_ctx.query_params->find(redpath);
+        iter != redpath_ctx.query_params->end()) {
+      return iter->second;
+    }
   }
-  return filter_condition();
+  return GetParams{};
 }
 
-// Handler for predicate expressions containing relational operators.
-bool PredicateFilterByNodeComparison(const RedfishVariant &variant,
-                                     absl::string_view predicate) {
-  std::string node_name, op, test_value;
-  bool ret = false;
-  if (RE2::FullMatch(predicate, *kPredicateRegexRelationalOperator, &node_name,
-                     &op, &test_value)) {
-    double value;
-    auto json_obj = ResolveNodeNameToJsonObj(variant, node_name);
-    if (!json_obj.ok()) {
-      return false;
-    }
+// Returns a string identifying the Redfish request sent with the given query
+// parameters.
+std::string GetParamsToString(const GetParams &params) {
+  return absl::StrCat(
+      params.freshness == GetParams::Freshness::kRequired ? "fresh" : "", ";",
+      params.auto_adjust_levels ? "auto" : "", ";",
+      params.expand.has_value() ? params.expand->ToString() : "");
+}
 
-    // Number comparison.
-    if (absl::SimpleAtod(test_value, &value)) {
-      const auto condition = [&op, value](double number) {
-        if (op == ">=") return number >= value;
-        if (op == ">") return number > value;
-        if (op == "<=") return number <= value;
-        if (op == "<") return number < value;
-        if (op == "!=") return number != value;
-        if (op == "=") return number == value;
-        return false;
-      };
-      ret = ApplyNumberComparisonFilter(*json_obj, condition);
-    } else if (test_value == kBinaryOperandFalse ||
-               test_value == kBinaryOperandTrue) {
-      // For the property value's type is boolean.
-      bool bool_value = test_value != kBinaryOperandFalse;
-      const auto condition = [json_obj, bool_value]() {
-        return *json_obj == bool_value;
-      };
-      ret = ApplyStringComparisonFilter(condition, op);
-    } else if (test_value == "null") {
-      // For the property value is null.
-      const auto condition = [json_obj]() { return json_obj->is_null(); };
-      ret = ApplyStringComparisonFilter(condition, op);
-    } else {
-      // For the property value's type is string.
-      const auto condition = [json_obj, test_value]() {
-        return *json_obj == test_value;
-      };
-      ret = ApplyStringComparisonFilter(condition, op);
-    }
-  }
-  return ret;
+// Returns the key of the record of a node-set in IncrementalState.
+std::string GetNodeSetKey(absl::string_view context_uri,
+                          absl::string_view node_name,
+                          const GetParams &params) {
+  return absl::StrCat(context_uri, " ", node_name, " ",
+                      GetParamsToString(params));
 }
 
-// Handler for '[nodename]'
-// Checks if given Redfish Resource encapsulated in the Variant contains
-// predicate string.
-bool PredicateFilterByNodeName(const RedfishVariant &variant,
-                               absl::string_view predicate) {
-  std::vector<std::string> node_names = SplitNodeNameForNestedNodes(predicate);
-  if (node_names.empty()) {
-    return false;
-  }
-  nlohmann::json leaf = variant.AsObject()->GetContentAsJson();
-  for (auto const &name : node_names) {
-    if (!leaf.contains(name)) {
-      return false;
-    }
-    leaf = leaf.at(name);
+// Returns the URI of a Redfish resource, or nullopt if it has none.
+std::optional<std::string> GetVariantUri(const RedfishVariant &variant) {
+  if (std::unique_ptr<RedfishObject> obj = variant.AsObject()) {
+    return obj->GetUriString();
   }
-  return true;
+  return std::nullopt;
 }
 
-bool ApplyPredicateRule(const RedfishVariant &node, size_t node_index,
-                        size_t node_set_size,
-                        const SubqueryHandle::RedPathIterator &iter) {
-  std::string_view predicate = iter->second;
-  absl::string_view logical_operation = kLogicalOperatorAnd;
-  bool is_filter_success = true;
-  for (absl::string_view expr : absl::StrSplit(predicate, ' ')) {
-    // If expression is a logical operator, capture it and move to next
-    // expression
-    if (expr == kLogicalOperatorAnd || expr == kLogicalOperatorOr) {
-      // A binary operator is parsed only when last operator has been applied.
-      // Since last operator has not been applied and we are seeing another
-      // operator in the expression, it can be considered an invalid expression.
-      if (!logical_operation.empty()) {
-        LOG(ERROR) << "Invalid predicate expression " << predicate;
-        return false;
-      }
-      logical_operation = expr;
-      continue;
-    }
-
-    // There should always be a logical operation defined for the predicates.
-    // Default logical operation is 'AND' between a predicate expression and
-    // default boolean operand 'true'
-    if (logical_operation.empty()) {
-      LOG(ERROR) << "Invalid predicate expression " << predicate;
-      return false;
-    }
+// Returns the members of a collection, or nullptr if it has none.
+std::unique_ptr<RedfishIterable> GetMembers(const RedfishVariant &collection) {
+  std::unique_ptr<RedfishObject> obj = collection.AsObject();
+  if (obj == nullptr) return nullptr;
+  return (*obj)[PropertyMembers::Name].AsIterable();
+}
 
-    size_t num;
-    bool single_predicate_result = false;
-    // If '[last()]' predicate expression, check if current node at last index.
-    if ((expr == kPredicateSelectLastIndex &&
-         node_index == node_set_size - 1) ||
-        // If '[Index]' predicate expression, check if current node at given
-        // index
-        (absl::SimpleAtoi(expr, &num) && num == node_index) ||
-        // If '[*]' predicate expression or empty predicate, no filter required.
-        (expr.empty() || expr == kPredicateSelectAll)) {
-      single_predicate_result = true;
-    } else if (std::any_of(kRelationsOperators.begin(),
-                           kRelationsOperators.end(), [&](const char *op) {
-                             return absl::StrContains(expr, op);
-                           })) {
-      // Look for predicate expression containing relational operators.
-      single_predicate_result = PredicateFilterByNodeComparison(node, expr);
-    } else {
-      // Filter node-set by NodeName
-      single_predicate_result = PredicateFilterByNodeName(node, expr);
-    }
-    // Apply logical operation.
-    if (logical_operation == kLogicalOperatorAnd) {
-      is_filter_success &= single_predicate_result;
-    } else {
-      is_filter_success |= single_predicate_result;
-    }
-    // Reset logical operation
-    logical_operation = "";
+// Returns the URIs of the members of a collection, or nullopt if one of them
+// has none. The members are not fetched for their URIs.
+std::optional<std::vector<std::string>> GetMemberUris(
+    RedfishIterable &members) {
+  size_t size = members.Size();
+  std::vector<std::string> uris;
+  uris.reserve(size);
+  for (size_t index = 0; index < size; ++index) {
+    std::optional<std::string> uri =
+        members.GetUriString(static_cast<int>(index));
+    if (!uri.has_value()) return std::nullopt;
+    uris.push_back(*std::move(uri));
   }
-  return is_filter_success;
+  return uris;
 }
 
+// NodeNames are ordered so that RedPaths are executed in the same order on
+// every run. RedPaths from different query plans may query the same NodeName
+// with different query parameters, so the parameters are part of the key.
 using NodeNameToRedPathContexts =
-    absl::flat_hash_map<std::string, std::vector<QueryPlanner::RedPathContext>>;
+    std::map<std::pair<std::string /* NodeName */, std::string /* Params */>,
+             std::vector<QueryPlanner::RedPathContext>>;
 
 // Deduplicates the next NodeName expression in the RedPath of each subquery
 // and returns NodeName to Subquery Iterators map. This is to ensure Redfish
 // Request is sent out once but the dataset obtained can be processed per
 // Subquery using the mapped RedPathContext objects.
 NodeNameToRedPathContexts DeduplicateNodeNamesAcrossSubqueries(
+    const std::string &last_executed_redpath,
     std::vector<QueryPlanner::RedPathContext> &&redpath_context_multiple) {
   NodeNameToRedPathContexts node_to_redpath_contexts;
   for (auto &&redpath_context : redpath_context_multiple) {
     // Pair resource name and those RedPaths that have this resource as next
     // NodeName.
     std::string node_name = redpath_context.redpath_steps_iterator->first;
-    node_to_redpath_contexts[node_name].push_back(redpath_context);
+    std::string params = GetParamsToString(GetParamsForRedPath(
+        redpath_context, absl::StrCat(last_executed_redpath, "/", node_name)));
+    node_to_redpath_contexts[{std::move(node_name), std::move(params)}]
+        .push_back(redpath_context);
   }
   return node_to_redpath_contexts;
 }
 
+// Shared between the threads running the calls of a ParallelFor, which may
+// outlive the ParallelFor if the executor is busy.
+class ParallelForState {
+ public:
+  ParallelForState(size_t count, std::function<void(size_t)> fn)
+      : count_(count), fn_(std::move(fn)) {}
+
+  // Runs the calls not yet started until there is none left.
+  void Work() {
+    while (true) {
+      size_t index;
+      {
+        absl::MutexLock lock(&mutex_);
+        if (next_ == count_) return;
+        index = next_++;
+      }
+      fn_(index);
+      absl::MutexLock lock(&mutex_);
+      ++done_;
+    }
+  }
+
+  void WaitUntilDone() {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &ParallelForState::IsDone));
+  }
+
+ private:
+  bool IsDone() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return done_ == count_;
+  }
+
+  const size_t count_;
+  const std::function<void(size_t)> fn_;
+  absl::Mutex mutex_;
+  size_t next_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t done_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// Calls fn for each index in [0, count) and returns once all calls are done.
+// Calls are spread over the threads of the executor if there is one, with at
+// most one worker scheduled per executor thread. The calling thread takes part
+// in the work, so that this never waits on an executor whose threads are all
+// busy.
+void ParallelFor(ThreadPool *executor, size_t count,
+                 std::function<void(size_t)> fn) {
+  if (executor == nullptr || executor->NumThreads() == 0 || count <= 1) {
+    for (size_t index = 0; index < count; ++index) fn(index);
+    return;
+  }
+  auto state = std::make_shared<ParallelForState>(count, std::move(fn));
+  size_t num_workers = std::min(count - 1, executor->NumThreads());
+  for (size_t i = 0; i < num_workers; ++i) {
+    executor->Schedule([state] { state->Work(); });
+  }
+  state->Work();
+  state->WaitUntilDone();
+}
+
 }  // namespace
 
 // Normalize Redfish response per the property requirements in subquery.
@@ -264,222 +234,553 @@ absl::StatusOr<SubqueryDataSet *> SubqueryHandle::Normalize(
 }
 
 void QueryPlanner::ExecuteRedPathStepFromEachSubquery(
-    QueryExecutionContext &execution_context, DelliciusQueryResult &result,
-    QueryTracker *tracker) {
-  NodeNameToRedPathContexts node_name_to_redpath_contexts =
-      DeduplicateNodeNamesAcrossSubqueries(
-          std::move(execution_context.redpath_ctx_multiple));
-
-  // Return if the Context Node is invalid or there is no redpath expression
-  // left to process across subqueries.
-  if (execution_context.redfish_object == nullptr ||
-      node_name_to_redpath_contexts.empty()) {
-    return;
+    std::vector<QueryExecutionContext> execution_contexts,
+    QueryTracker *tracker, ThreadPool *executor,
+    IncrementalRunContext *incremental) {
+  while (!execution_contexts.empty()) {
+    // Pair each unique NodeName queried from each context node with the
+    // RedPaths that have it as next step expression.
+    std::vector<NodeSetContext> node_sets;
+    for (QueryExecutionContext &execution_context : execution_contexts) {
+      // Skip the Context Node if it is invalid.
+      if (execution_context.redfish_object == nullptr &&
+          execution_context.uri.empty()) {
+        continue;
+      }
+      for (auto &[key, redpath_ctx_multiple] :
+           DeduplicateNodeNamesAcrossSubqueries(
+               execution_context.last_executed_redpath,
+               std::move(execution_context.redpath_ctx_multiple))) {
+        NodeSetContext &node_set = node_sets.emplace_back();
+        node_set.execution_context = &execution_context;
+        node_set.node_name = key.first;
+        node_set.redpath_ctx_multiple = std::move(redpath_ctx_multiple);
+        // Append the last executed RedPath to construct the next RedPath to
+        // query.
+        node_set.last_executed_redpath = absl::StrCat(
+            execution_context.last_executed_redpath, "/", key.first);
+        node_set.get_params =
+            GetParamsForRedPath(node_set.redpath_ctx_multiple.front(),
+                                node_set.last_executed_redpath);
+      }
+    }
+
+    if (incremental != nullptr) {
+      ResolveNodeSetsFromRecords(node_sets, *incremental, executor);
+      FetchNodeSets(node_sets, executor, incremental->intf);
+      RecordNodeSets(node_sets, *incremental->state);
+    } else {
+      FetchNodeSets(node_sets, executor, nullptr);
+    }
+
+    // Now, for each node-set, apply predicate expressions from each RedPath
+    // to produce the context nodes of the next RedPath Step expressions.
+    // Node-sets are processed in order so that the query result does not
+    // depend on the order in which Redfish requests complete.
+    std::vector<QueryExecutionContext> next_execution_contexts;
+    for (NodeSetContext &node_set : node_sets) {
+      ApplyPredicateFromEachSubquery(node_set, tracker, incremental != nullptr,
+                                     next_execution_contexts);
+    }
+    // Context nodes must outlive the node-sets queried from them.
+    node_sets.clear();
+    execution_contexts = std::move(next_execution_contexts);
   }
+}
 
-  // Maps RedPath of context node to the execution context. This mapping is used
-  // to aggregate Subqueries operating on same context node along with any
-  // metadata applicable to the context node.
-  absl::flat_hash_map<std::string, QueryExecutionContext>
-      redpath_to_execution_ctx;
-
-  // Track last executed RedPath per indexed node. This differs from
-  // last_executed_path which is either a singleton resource or collection
-  std::string last_executed_index_redpath;
-
-  // We will query NodeName from each NodeName to RedPathContexts pair and
-  // apply predicate expressions from each RedPath to filter the nodes
-  // to produce next set of context nodes where each context node will have a
-  // similar NodeName to RedPath Contexts pairing.
-  for (auto &[node_name, redpath_ctx_multiple] :
-       node_name_to_redpath_contexts) {
-    std::string last_executed_redpath = execution_context.last_executed_redpath;
-
-    // Reference to allow capture in the PredicateRunner.
-    std::vector<RedPathContext> &redpath_ctx_list_mapped_to_node =
-        redpath_ctx_multiple;
-
-    // Append the last executed RedPath to construct the next RedPath to query.
-    absl::StrAppend(&last_executed_redpath, "/", node_name);
-    GetParams get_params_for_redpath{};
-    if (auto iter = query_params_.find(last_executed_redpath);
-        iter != query_params_.end()) {
-      get_params_for_redpath = iter->second;
+void QueryPlanner::ResolveNodeSetsFromRecords(
+    std::vector<NodeSetContext> &node_sets, IncrementalRunContext &incremental,
+    ThreadPool *executor) {
+  IncrementalState &state = *incremental.state;
+  std::vector<QueryExecutionContext *> contexts_to_fetch;
+  absl::flat_hash_set<QueryExecutionContext *> seen_contexts;
+  for (NodeSetContext &node_set : node_sets) {
+    bool is_end_of_redpath = false;
+    for (RedPathContext &redpath_ctx : node_set.redpath_ctx_multiple) {
+      SubqueryHandle &subquery_handle = *redpath_ctx.subquery_handle;
+      if (subquery_handle.IsEndOfRedPath(redpath_ctx.redpath_steps_iterator)) {
+        is_end_of_redpath = true;
+      }
+      if (subquery_handle.GetPredicate(redpath_ctx.redpath_steps_iterator)
+              .NeedsNodeContent()) {
+        node_set.needs_node_content = true;
+      }
+    }
+    // Nodes at the end of a RedPath are normalized.
+    node_set.needs_node_content |= is_end_of_redpath;
+
+    QueryExecutionContext &execution_context = *node_set.execution_context;
+    if (!incremental.is_discovery && !execution_context.uri.empty()) {
+      std::optional<IncrementalState::NodeSetRecord> record;
+      {
+        absl::MutexLock lock(&state.mutex_);
+        auto iter = state.node_sets_.find(GetNodeSetKey(
+            execution_context.uri, node_set.node_name, node_set.get_params));
+        if (iter != state.node_sets_.end()) record = iter->second;
+      }
+      if (record.has_value() && !record->is_collection) {
+        node_set.record = *std::move(record);
+        continue;
+      }
+      // Collections are fetched again on every run so that the members they
+      // gain or lose are seen, anywhere in a RedPath. The members of those in
+      // the middle of a RedPath are still resolved from the record, and only
+      // fetched if their content is needed.
+      if (record.has_value() && !record->uri.empty()) {
+        node_set.uri = record->uri;
+        if (!is_end_of_redpath) node_set.record = *std::move(record);
+        continue;
+      }
     }
+    if (execution_context.redfish_object == nullptr &&
+        seen_contexts.insert(&execution_context).second) {
+      contexts_to_fetch.push_back(&execution_context);
+    }
+  }
 
-    // Dispatch Redfish Request for the Redfish Resource associated with the
-    // NodeName expression.
-    RedfishVariant node_set_as_variant = execution_context.redfish_object->Get(
-        node_name, get_params_for_redpath);
+  ParallelFor(executor, contexts_to_fetch.size(),
+              [&contexts_to_fetch, &incremental](size_t index) {
+                QueryExecutionContext &execution_context =
+                    *contexts_to_fetch[index];
+                execution_context.redfish_object =
+                    incremental.intf->CachedGetUri(execution_context.uri)
+                        .AsObject();
+              });
+  for (const QueryExecutionContext *execution_context : contexts_to_fetch) {
+    if (execution_context->redfish_object == nullptr) {
+      absl::MutexLock lock(&state.mutex_);
+      state.needs_rediscovery_ = true;
+      break;
+    }
+  }
+}
 
-    // Add last executed RedPath to the record.
-    if (tracker) {
-      tracker->redpaths_queried.insert(
-          {last_executed_redpath, get_params_for_redpath});
+void QueryPlanner::FetchNodeSets(std::vector<NodeSetContext> &node_sets,
+                                 ThreadPool *executor, RedfishInterface *intf) {
+  // Dispatch Redfish Request for the Redfish Resource associated with each
+  // NodeName expression, unless the node-set is resolved from the record of a
+  // singleton resource.
+  ParallelFor(executor, node_sets.size(), [&node_sets, intf](size_t index) {
+    NodeSetContext &node_set = node_sets[index];
+    if (!node_set.uri.empty()) {
+      node_set.node_set_as_variant.emplace(
+          intf->CachedGetUri(node_set.uri, node_set.get_params));
+      return;
+    }
+    if (node_set.record.has_value()) return;
+    RedfishObject *context_node =
+        node_set.execution_context->redfish_object.get();
+    if (context_node == nullptr) {
+      node_set.node_set_as_variant.emplace(
+          absl::NotFoundError("Context node cannot be fetched"));
+      return;
     }
+    node_set.node_set_as_variant.emplace(
+        context_node->Get(node_set.node_name, node_set.get_params));
+  });
+
+  // Then dispatch the requests for the members of each collection, and for
+  // the recorded nodes whose content is needed.
+  std::vector<std::pair<NodeSetContext *, size_t>> members;
+  for (NodeSetContext &node_set : node_sets) {
+    if (node_set.record.has_value()) {
+      // The members of a recorded collection which is fetched again are the
+      // ones it has now.
+      if (node_set.node_set_as_variant.has_value() &&
+          node_set.node_set_as_variant->status().ok()) {
+        std::optional<std::vector<std::string>> uris;
+        if (std::unique_ptr<RedfishIterable> iter =
+                GetMembers(*node_set.node_set_as_variant)) {
+          uris = GetMemberUris(*iter);
+          if (uris.has_value()) node_set.iter = std::move(iter);
+        }
+        if (uris.has_value()) {
+          node_set.record->uris = *std::move(uris);
+        } else {
+          node_set.node_set_as_variant.emplace(
+              absl::InternalError("Members of collection cannot be read"));
+        }
+      }
+      node_set.nodes.resize(node_set.record->uris.size());
+      if (!node_set.needs_node_content) continue;
+      for (size_t index = 0; index < node_set.nodes.size(); ++index) {
+        members.push_back({&node_set, index});
+      }
+      continue;
+    }
+    if (!node_set.node_set_as_variant->status().ok()) continue;
+    node_set.iter = node_set.node_set_as_variant->AsIterable();
+    if (node_set.iter == nullptr) continue;
+    node_set.nodes.resize(node_set.iter->Size());
+    for (size_t index = 0; index < node_set.nodes.size(); ++index) {
+      members.push_back({&node_set, index});
+    }
+  }
+  ParallelFor(executor, members.size(), [&members, intf](size_t index) {
+    auto [node_set, member_index] = members[index];
+    if (node_set->record.has_value() && node_set->iter == nullptr) {
+      // Members are fetched with the default parameters, as they are through
+      // their collection. Those of a collection fetched again are taken from
+      // it below instead, as it embeds them if it was expanded.
+      node_set->nodes[member_index].emplace(intf->CachedGetUri(
+          node_set->record->uris[member_index],
+          node_set->record->is_collection ? GetParams{}
+                                          : node_set->get_params));
+      return;
+    }
+    node_set->nodes[member_index].emplace(
+        (*node_set->iter)[static_cast<int>(member_index)]);
+  });
+}
 
-    // If NodeName does not resolve to a valid Redfish Resource, skip it!
-    if (!node_set_as_variant.status().ok()) {
+void QueryPlanner::RecordNodeSets(std::vector<NodeSetContext> &node_sets,
+                                  IncrementalState &state) {
+  // Only the records are read and written here, the Redfish resources are all
+  // fetched by now.
+  absl::MutexLock lock(&state.mutex_);
+  for (NodeSetContext &node_set : node_sets) {
+    if (node_set.record.has_value()) {
+      // A recorded node that cannot be fetched anymore may have been removed.
+      for (const std::optional<RedfishVariant> &node : node_set.nodes) {
+        if (node.has_value() && !node->status().ok()) {
+          state.needs_rediscovery_ = true;
+        }
+      }
+      if (!node_set.node_set_as_variant.has_value()) continue;
+      if (!node_set.node_set_as_variant->status().ok()) {
+        state.needs_rediscovery_ = true;
+        continue;
+      }
+      // Same as below, a recorded collection whose members have changed is
+      // likely not the only change in the Redfish tree.
+      auto iter = state.node_sets_.find(
+          GetNodeSetKey(node_set.execution_context->uri, node_set.node_name,
+                        node_set.get_params));
+      if (iter == state.node_sets_.end()) continue;
+      if (iter->second.uris != node_set.record->uris) {
+        state.needs_rediscovery_ = true;
+        iter->second.uris = node_set.record->uris;
+      }
       continue;
     }
-    // At this point we have executed redfish request for a NodeName that
-    // results in a node-set which can be a singleton Redfish resource or
-    // a Collection.
-    // As we are batch processing subqueries, it is possible that a node in
-    // this node-set can satisfy predicates across subqueries. Example
-    // /Chassis[SKU=1234] and /Chassis[Name=Foo] could be the same chassis
-    // instance /Chassis[1].
-    // So instead of iterating over a node-set to apply predicate for each
-    // subquery, we can batch process predicate expressions such that we iterate
-    // the node-set once and for each node we apply all the predicate
-    // expressions.
-    //
-    // On successful filter, map the subquery with the RedPath. The mapped
-    // subqueries then use the Resource associated with the RedPath as context
-    // node for executing next NodeName expression.
-    // Example: {"/Chassis[1]" : {SQ1, SQ4, SQ5}},
-    //           "/Chassis[4]" : {SQ1, SQ4, SQ9}}
-    auto apply_predicate_from_each_subquery = [&](RedfishVariant node,
-                                                  size_t node_index,
-                                                  size_t node_set_size) {
-      for (auto &redpath_ctx : redpath_ctx_list_mapped_to_node) {
-        // On successfully refining the node-set using predicate,
-        // either prepare subquery response or continue query with
-        // subordinate resources of the refined node-set.
-        if (!ApplyPredicateRule(node, node_index, node_set_size,
-                                redpath_ctx.redpath_steps_iterator)) {
-          continue;
+    if (!node_set.node_set_as_variant->status().ok()) {
+      if (!node_set.uri.empty()) state.needs_rediscovery_ = true;
+      continue;
+    }
+    const std::string &context_uri = node_set.execution_context->uri;
+    if (context_uri.empty()) continue;
+    // Node-sets are only recorded if each of their nodes has a URI to be
+    // fetched with.
+    IncrementalState::NodeSetRecord record;
+    record.uri = GetVariantUri(*node_set.node_set_as_variant).value_or("");
+    bool has_uris = true;
+    if (node_set.iter != nullptr) {
+      record.is_collection = true;
+      for (const std::optional<RedfishVariant> &node : node_set.nodes) {
+        std::optional<std::string> uri = GetVariantUri(*node);
+        if (!uri.has_value()) {
+          has_uris = false;
+          break;
+        }
+        record.uris.push_back(*std::move(uri));
+      }
+    } else if (std::optional<std::string> uri =
+                   GetVariantUri(*node_set.node_set_as_variant);
+               uri.has_value()) {
+      record.uris.push_back(*std::move(uri));
+    } else {
+      has_uris = false;
+    }
+    if (!has_uris) continue;
+
+    auto [iter, inserted] = state.node_sets_.try_emplace(
+        GetNodeSetKey(context_uri, node_set.node_name, node_set.get_params));
+    // The Redfish tree is likely to have changed beyond a collection whose
+    // members have changed, e.g. when a board is plugged in.
+    if (!inserted && iter->second.uris != record.uris) {
+      state.needs_rediscovery_ = true;
+    }
+    iter->second = std::move(record);
+  }
+}
+
+void QueryPlanner::ApplyPredicateFromEachSubquery(
+    NodeSetContext &node_set, QueryTracker *tracker, bool is_incremental,
+    std::vector<QueryExecutionContext> &next_execution_contexts) {
+  // Add last executed RedPath to the record.
+  if (tracker) {
+    tracker->redpaths_queried.insert(
+        {node_set.last_executed_redpath, node_set.get_params});
+  }
+
+  // If NodeName does not resolve to a valid Redfish Resource, skip it!
+  if (!node_set.record.has_value() &&
+      !node_set.node_set_as_variant->status().ok()) {
+    return;
+  }
+  // At this point we have executed redfish request for a NodeName that
+  // results in a node-set which can be a singleton Redfish resource or
+  // a Collection.
+  // As we are batch processing subqueries, it is possible that a node in
+  // this node-set can satisfy predicates across subqueries. Example
+  // /Chassis[SKU=1234] and /Chassis[Name=Foo] could be the same chassis
+  // instance /Chassis[1].
+  // So instead of iterating over a node-set to apply predicate for each
+  // subquery, we can batch process predicate expressions such that we iterate
+  // the node-set once and for each node we apply all the predicate
+  // expressions.
+  //
+  // On successful filter, map the subquery with the node. The mapped
+  // subqueries then use the node as context node for executing next NodeName
+  // expression.
+  // Example: {"/Chassis[1]" : {SQ1, SQ4, SQ5}},
+  //           "/Chassis[4]" : {SQ1, SQ4, SQ9}}
+  //
+  // The node is null if it has not been fetched, in which case only its URI is
+  // known and none of the RedPaths reads its content.
+  auto apply_predicate_from_each_subquery = [&](const RedfishVariant *node,
+                                                const std::string *node_uri,
+                                                size_t node_index,
+                                                size_t node_set_size) {
+    // Context for the next step expressions of the RedPaths which select the
+    // node.
+    QueryExecutionContext new_execution_context;
+    bool has_context_node = false;
+    new_execution_context.last_executed_redpath =
+        node_set.last_executed_redpath;
+    std::vector<RedPathContext> &redpath_contexts =
+        new_execution_context.redpath_ctx_multiple;
+    // Content of the node, only copied when the first predicate reading
+    // properties is evaluated.
+    nlohmann::json node_content;
+    bool has_node_content = false;
+    for (auto &redpath_ctx : node_set.redpath_ctx_multiple) {
+      auto &subquery_handle = redpath_ctx.subquery_handle;
+      const RedPathPredicate &predicate =
+          subquery_handle->GetPredicate(redpath_ctx.redpath_steps_iterator);
+      if (predicate.NeedsNodeContent() && !has_node_content) {
+        if (std::unique_ptr<RedfishObject> obj =
+                node != nullptr ? node->AsObject() : nullptr) {
+          node_content = obj->GetContentAsJson();
         }
+        has_node_content = true;
+      }
+      // On successfully refining the node-set using predicate,
+      // either prepare subquery response or continue query with
+      // subordinate resources of the refined node-set.
+      if (!predicate.Evaluate(node_index, node_set_size, node_content)) {
+        continue;
+      }
 
-        auto &subquery_handle = redpath_ctx.subquery_handle;
-        bool is_end_of_redpath =
-            subquery_handle->IsEndOfRedPath(redpath_ctx.redpath_steps_iterator);
-
-        // If there aren't any child subqueries and all step expressions in the
-        // current SubqueryHandle's RedPath have been processed, we can proceed
-        // to data normalization.
-        if (is_end_of_redpath && !subquery_handle->HasChildSubqueries()) {
-          subquery_handle
-              ->Normalize(node, result, redpath_ctx.root_redpath_dataset)
-              .IgnoreError();
-        } else {
-          // Prepare for Querying the next step expression in RedPath. The
-          // context node for the next query operation will be the refined
-          // node-set obtained after applying predicate expression.
-          std::unique_ptr<RedfishObject> obj = node.AsObject();
+      bool is_end_of_redpath =
+          subquery_handle->IsEndOfRedPath(redpath_ctx.redpath_steps_iterator);
+
+      // If there aren't any child subqueries and all step expressions in the
+      // current SubqueryHandle's RedPath have been processed, we can proceed
+      // to data normalization.
+      if (is_end_of_redpath && !subquery_handle->HasChildSubqueries()) {
+        if (node == nullptr) continue;
+        subquery_handle
+            ->Normalize(*node, *redpath_ctx.result,
+                        redpath_ctx.root_redpath_dataset)
+            .IgnoreError();
+        continue;
+      }
+      // Prepare for Querying the next step expression in RedPath. The
+      // context node for the next query operation will be the refined
+      // node-set obtained after applying predicate expression.
+      if (!has_context_node) {
+        if (node != nullptr) {
+          new_execution_context.redfish_object = node->AsObject();
           // Redfish Object must be valid to serve as context node.
-          if (obj == nullptr) {
+          if (new_execution_context.redfish_object == nullptr) {
             continue;
           }
-          auto query_plan_entry =
-              redpath_to_execution_ctx.find(last_executed_index_redpath);
-
-          // We will construct a new execution context using the
-          // filtered Redfish Resource as context node if none exists.
-          if (query_plan_entry == redpath_to_execution_ctx.end()) {
-            QueryExecutionContext new_execution_context;
-            new_execution_context.redfish_object = std::move(obj);
-            new_execution_context.last_executed_redpath = last_executed_redpath;
-            redpath_to_execution_ctx.emplace(last_executed_index_redpath,
-                                             std::move(new_execution_context));
-          }
-
-          // Add all the current subquery handle to the list of Subquery
-          // Handles that share the same context node for their next
-          // redpath expression
-          std::vector<RedPathContext> &redpath_contexts =
-              redpath_to_execution_ctx[last_executed_index_redpath]
-                  .redpath_ctx_multiple;
-          if (is_end_of_redpath) {
-            // All RedPath step expressions of current SubqueryHandle have been
-            // processed. We can normalize the data to prepare the subquery
-            // response.
-            absl::StatusOr<SubqueryDataSet *> last_normalized_dataset;
-            if (last_normalized_dataset = subquery_handle->Normalize(
-                    node, result, redpath_ctx.root_redpath_dataset);
-                !last_normalized_dataset.ok()) {
-              continue;
-            }
-
-            // Since this SubqueryHandle has linked child SubqueryHandles,
-            // we will insert all the child Handles in the execution context
-            // to be executed using the new context node.
-            for (auto &child_subquery_handle :
-                 subquery_handle->GetChildSubqueryHandles()) {
-              if (child_subquery_handle == nullptr) continue;
-              redpath_contexts.push_back(
-                  {child_subquery_handle, *last_normalized_dataset,
-                   child_subquery_handle->GetRedPathIterator()});
-            }
-          } else {
-            redpath_contexts.push_back(redpath_ctx);
-            // Load next step expression in RedPath that will query the redfish
-            // object in the new execution context serving as new context
-            // node.
-            ++redpath_contexts.back().redpath_steps_iterator;
+          if (node_uri != nullptr) {
+            new_execution_context.uri = *node_uri;
+          } else if (is_incremental) {
+            new_execution_context.uri =
+                new_execution_context.redfish_object->GetUriString().value_or(
+                    "");
           }
+        } else {
+          new_execution_context.uri = *node_uri;
         }
+        has_context_node = true;
       }
-    };
-
-    // Apply predicate expression rule on each Redfish Resource in collection.
-    size_t node_count = 1;
-    std::unique_ptr<RedfishIterable> iter = node_set_as_variant.AsIterable();
-    if (iter != nullptr) {
-      node_count = iter->Size();
-      // As query planner is iterating over each resource in collection and
-      // applying predicate expression from all subquery handles mapped to the
-      // node, from tracker's perspective QueryPlanner is executing [*]. Hence
-      // RedPath expressions in tracker will differ from 'last_executed_redpath'
-      // in execution context which creates context for indexed nodes as well.
-      absl::StrAppend(&last_executed_redpath, "[", kPredicateSelectAll, "]");
-      if (tracker) {
-        tracker->redpaths_queried.insert({last_executed_redpath, GetParams{}});
-      }
-      for (size_t index = 0; index < node_count; ++index) {
-        absl::StrAppend(&last_executed_index_redpath, "[", index, "]");
-        apply_predicate_from_each_subquery(node_set_as_variant[index], index,
-                                           node_count);
+
+      // Add all the current subquery handle to the list of Subquery
+      // Handles that share the same context node for their next
+      // redpath expression
+      if (is_end_of_redpath) {
+        // All RedPath step expressions of current SubqueryHandle have been
+        // processed. We can normalize the data to prepare the subquery
+        // response.
+        if (node == nullptr) continue;
+        absl::StatusOr<SubqueryDataSet *> last_normalized_dataset;
+        if (last_normalized_dataset = subquery_handle->Normalize(
+                *node, *redpath_ctx.result, redpath_ctx.root_redpath_dataset);
+            !last_normalized_dataset.ok()) {
+          continue;
+        }
+
+        // Since this SubqueryHandle has linked child SubqueryHandles,
+        // we will insert all the child Handles in the execution context
+        // to be executed using the new context node.
+        for (auto &child_subquery_handle :
+             subquery_handle->GetChildSubqueryHandles()) {
+          if (child_subquery_handle == nullptr) continue;
+          redpath_contexts.push_back(
+              {child_subquery_handle, *last_normalized_dataset,
+               child_subquery_handle->GetRedPathIterator(), redpath_ctx.result,
+               redpath_ctx.query_params});
+        }
+      } else {
+        redpath_contexts.push_back(redpath_ctx);
+        // Load next step expression in RedPath that will query the redfish
+        // object in the new execution context serving as new context
+        // node.
+        ++redpath_contexts.back().redpath_steps_iterator;
       }
-    } else {
-      absl::StrAppend(&last_executed_index_redpath, "[", 0, "]");
-      apply_predicate_from_each_subquery(std::move(node_set_as_variant), 0,
+    }
+    if (!redpath_contexts.empty()) {
+      next_execution_contexts.push_back(std::move(new_execution_context));
+    }
+  };
+
+  // Apply predicate expression rule on each node resolved from the record,
+  // skipping those which cannot be fetched anymore.
+  if (node_set.record.has_value()) {
+    if (tracker && node_set.record->is_collection) {
+      tracker->redpaths_queried.insert(
+          {absl::StrCat(node_set.last_executed_redpath, "[",
+                        kPredicateSelectAll, "]"),
+           GetParams{}});
+    }
+    size_t node_count = node_set.nodes.size();
+    for (size_t index = 0; index < node_count; ++index) {
+      const std::optional<RedfishVariant> &node = node_set.nodes[index];
+      if (node.has_value() && !node->status().ok()) continue;
+      apply_predicate_from_each_subquery(node.has_value() ? &*node : nullptr,
+                                         &node_set.record->uris[index], index,
                                          node_count);
     }
+    return;
   }
-  // Now, for each new context node obtained after applying Predicates, execute
-  // next RedPath Step expression from the mapped RedPath Iterators in the
-  // execution context.
-  for (auto &[_, qec] : redpath_to_execution_ctx) {
-    ExecuteRedPathStepFromEachSubquery(qec, result, tracker);
+
+  // Apply predicate expression rule on each Redfish Resource in collection.
+  if (node_set.iter != nullptr) {
+    // As query planner is iterating over each resource in collection and
+    // applying predicate expression from all subquery handles mapped to the
+    // node, from tracker's perspective QueryPlanner is executing [*]. Hence
+    // RedPath expressions in tracker will differ from 'last_executed_redpath'
+    // in execution context which creates context for indexed nodes as well.
+    if (tracker) {
+      tracker->redpaths_queried.insert(
+          {absl::StrCat(node_set.last_executed_redpath, "[",
+                        kPredicateSelectAll, "]"),
+           GetParams{}});
+    }
+    size_t node_count = node_set.nodes.size();
+    for (size_t index = 0; index < node_count; ++index) {
+      apply_predicate_from_each_subquery(&*node_set.nodes[index], nullptr,
+                                         index, node_count);
+    }
+  } else {
+    apply_predicate_from_each_subquery(&*node_set.node_set_as_variant, nullptr,
+                                       0, 1);
   }
 }
 
 DelliciusQueryResult QueryPlanner::Run(const RedfishVariant &variant,
                                        const Clock &clock,
                                        QueryTracker *tracker) {
-  DelliciusQueryResult result;
+  QueryPlanner *query_planner = this;
+  return std::move(RunMultiple(absl::MakeSpan(&query_planner, 1), variant,
+                               clock, tracker, executor_)
+                       .front());
+}
+
+std::vector<DelliciusQueryResult> QueryPlanner::RunMultiple(
+    absl::Span<QueryPlanner *const> query_planners,
+    const RedfishVariant &variant, const Clock &clock, QueryTracker *tracker,
+    ThreadPool *executor) {
+  QueryExecutionContext root_execution_context{.redfish_object =
+                                                   variant.AsObject()};
+  return RunFromRoot(query_planners, std::move(root_execution_context), clock,
+                     tracker, executor, nullptr);
+}
+
+std::vector<DelliciusQueryResult> QueryPlanner::RunIncremental(
+    absl::Span<QueryPlanner *const> query_planners, RedfishInterface &intf,
+    const Clock &clock, QueryTracker *tracker, ThreadPool *executor,
+    IncrementalState &state) {
+  IncrementalRunContext incremental{.intf = &intf, .state = &state};
+  QueryExecutionContext root_execution_context;
+  {
+    absl::MutexLock lock(&state.mutex_);
+    absl::Time now = clock.Now();
+    if (state.needs_rediscovery_ || state.root_uri_.empty() ||
+        now - state.last_discovery_ >= state.rediscovery_interval_) {
+      // Records are dropped rather than refreshed so that those of the
+      // RedPaths that are not run anymore do not linger.
+      incremental.is_discovery = true;
+      state.node_sets_.clear();
+      state.needs_rediscovery_ = false;
+      state.last_discovery_ = now;
+    }
+    root_execution_context.uri = state.root_uri_;
+  }
+  if (incremental.is_discovery) {
+    root_execution_context.redfish_object = intf.GetRoot().AsObject();
+    if (root_execution_context.redfish_object != nullptr) {
+      root_execution_context.uri =
+          root_execution_context.redfish_object->GetUriString().value_or("");
+      absl::MutexLock lock(&state.mutex_);
+      state.root_uri_ = root_execution_context.uri;
+    }
+  }
+  return RunFromRoot(query_planners, std::move(root_execution_context), clock,
+                     tracker, executor, &incremental);
+}
+
+std::vector<DelliciusQueryResult> QueryPlanner::RunFromRoot(
+    absl::Span<QueryPlanner *const> query_planners,
+    QueryExecutionContext root_execution_context, const Clock &clock,
+    QueryTracker *tracker, ThreadPool *executor,
+    IncrementalRunContext *incremental) {
+  std::vector<DelliciusQueryResult> results(query_planners.size());
   auto timestamp = AbslTimeToProtoTime(clock.Now());
-  if (timestamp.ok()) {
-    *result.mutable_start_timestamp() = *std::move(timestamp);
+  for (size_t i = 0; i < query_planners.size(); ++i) {
+    if (timestamp.ok()) *results[i].mutable_start_timestamp() = *timestamp;
+    results[i].set_query_id(query_planners[i]->plan_id_);
   }
-  result.set_query_id(plan_id_);
-  if (auto obj = variant.AsObject()) {
-    QueryExecutionContext execution_context{.redfish_object = std::move(obj)};
-    for (auto &subquery_handle : subquery_handles_) {
-      if (subquery_handle && subquery_handle->IsRootSubquery()) {
-        execution_context.redpath_ctx_multiple.push_back(
-            {subquery_handle.get(), nullptr,
-             subquery_handle->GetRedPathIterator()});
+  if (root_execution_context.redfish_object != nullptr ||
+      !root_execution_context.uri.empty()) {
+    // The RedPaths of all the query plans start from the same context node,
+    // where they are deduplicated together.
+    for (size_t i = 0; i < query_planners.size(); ++i) {
+      for (auto &subquery_handle : query_planners[i]->subquery_handles_) {
+        if (subquery_handle && subquery_handle->IsRootSubquery()) {
+          root_execution_context.redpath_ctx_multiple.push_back(
+              {subquery_handle.get(), nullptr,
+               subquery_handle->GetRedPathIterator(), &results[i],
+               &query_planners[i]->query_params_});
+        }
       }
     }
-    ExecuteRedPathStepFromEachSubquery(execution_context, result, tracker);
+    std::vector<QueryExecutionContext> execution_contexts;
+    execution_contexts.push_back(std::move(root_execution_context));
+    ExecuteRedPathStepFromEachSubquery(std::move(execution_contexts), tracker,
+                                       executor, incremental);
   }
   timestamp = AbslTimeToProtoTime(clock.Now());
   if (timestamp.ok()) {
-    *result.mutable_end_timestamp() = *std::move(timestamp);
+    for (DelliciusQueryResult &result : results) {
+      *result.mutable_end_timestamp() = *timestamp;
+    }
   }
-  return result;
+  return results;
 }
 
 }  // namespace ecclesia
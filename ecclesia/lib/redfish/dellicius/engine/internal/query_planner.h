@@ -28,12 +28,18 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/predicate.h"
 #include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query_result.pb.h"
 #include "ecclesia/lib/redfish/interface.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "ecclesia/lib/time/clock.h"
 
 namespace ecclesia {
@@ -46,6 +52,18 @@ namespace ecclesia {
 //    auto qp = std::make_unique<QueryPlanner>(
 //        query, subquery_handles, query_params);
 //    qp->Run(service_root, Clock::RealClock(), &tracker);
+//
+// RedPaths are executed one step at a time across all the context nodes of
+// that step. If an executor is given, the Redfish requests of a step are
+// dispatched concurrently on it, so sibling branches like /Chassis[1]/Sensors
+// and /Chassis[2]/Sensors are fetched in parallel. Fetched node-sets are then
+// filtered and normalized on the calling thread, in the same order whether or
+// not an executor is used.
+//
+// RunIncremental executes query plans without walking the Redfish tree from
+// the service root on every run: the URIs each RedPath step resolves to are
+// recorded, and later runs only fetch the resources the predicates and the
+// normalization read, which in steady state are the leaves of the RedPaths.
 class QueryPlanner final : public QueryPlannerInterface {
  public:
   // Provides a subquery level abstraction to traverse RedPath step expressions
@@ -54,13 +72,15 @@ class QueryPlanner final : public QueryPlannerInterface {
    public:
     using RedPathIterator =
         std::vector<std::pair<std::string, std::string>>::const_iterator;
+    // predicates holds the compiled predicate of each RedPath step.
     SubqueryHandle(
         const DelliciusQuery::Subquery &subquery,
         std::vector<std::pair<std::string, std::string>> redpath_steps,
-        Normalizer *normalizer)
+        std::vector<RedPathPredicate> predicates, Normalizer *normalizer)
         : subquery_(subquery),
           normalizer_(normalizer),
-          redpath_steps_(std::move(redpath_steps)) {}
+          redpath_steps_(std::move(redpath_steps)),
+          predicates_(std::move(predicates)) {}
 
     // Parses given Redfish Resource for properties requested in the subquery
     // and prepares dataset to be appended in SubqueryOutput.
@@ -96,6 +116,12 @@ class QueryPlanner final : public QueryPlannerInterface {
 
     std::string RedPathToString() const { return subquery_.redpath(); }
 
+    // Returns the compiled predicate of the step expression the iterator
+    // points to.
+    const RedPathPredicate &GetPredicate(const RedPathIterator &iter) const {
+      return predicates_[iter - redpath_steps_.begin()];
+    }
+
    private:
     DelliciusQuery::Subquery subquery_;
     Normalizer *normalizer_;
@@ -103,6 +129,8 @@ class QueryPlanner final : public QueryPlannerInterface {
     // RedPath of a Subquery.
     // Eg. /Chassis[*]/Sensors[1] - {(Chassis, *), (Sensors, 1)}
     std::vector<std::pair<std::string, std::string>> redpath_steps_;
+    // Predicate of each RedPath Step expression, compiled once.
+    std::vector<RedPathPredicate> predicates_;
     // Index into RedPath step expressions
     size_t redpath_step_index_ = 0;
     std::vector<SubqueryHandle *> child_subquery_handles_;
@@ -119,32 +147,104 @@ class QueryPlanner final : public QueryPlannerInterface {
     // Iterator configured to iterate over RedPath steps - NodeName and
     // Predicate pair
     SubqueryHandle::RedPathIterator redpath_steps_iterator;
+    // Result of the query the RedPath belongs to, and the Redfish query
+    // parameters of its query plan.
+    DelliciusQueryResult *result = nullptr;
+    const RedPathRedfishQueryParams *query_params = nullptr;
   };
 
   // Encapsulates key elements of a query operation.
-  // An execution context is created for each node in Redfish tree during pre
-  // order traversal where each node in the tree acts as the local root for all
+  // An execution context is created for each node in Redfish tree during
+  // traversal where each node in the tree acts as the local root for all
   // redpath iterators.
   struct QueryExecutionContext {
     // Redfish object serving as context node for RedPath expression.
     std::unique_ptr<RedfishObject> redfish_object;
+    // URI of the context node, only set in incremental runs. The Redfish
+    // object is not set if the context node has not been fetched.
+    std::string uri;
     // RedPaths to execute with Redfish object as root.
     std::vector<RedPathContext> redpath_ctx_multiple;
     // Last RedPath executed to get the Redfish object.
     std::string last_executed_redpath;
   };
 
+  // Records the URIs the RedPaths of query plans resolve to, across the
+  // incremental runs of the plans. The Redfish tree is walked again from the
+  // service root every rediscovery_interval, on the run following a failure to
+  // fetch a recorded resource, and on the run following a change in the members
+  // of a collection. Runs sharing a state may overlap, the state is only locked
+  // while records are read or written and never across Redfish requests.
+  class IncrementalState {
+   public:
+    explicit IncrementalState(absl::Duration rediscovery_interval)
+        : rediscovery_interval_(rediscovery_interval) {}
+
+   private:
+    friend class QueryPlanner;
+
+    // Nodes a NodeName resolves to from a context node, in order.
+    struct NodeSetRecord {
+      // URI of the node-set itself, which a collection is fetched again from.
+      std::string uri;
+      bool is_collection = false;
+      std::vector<std::string> uris;
+    };
+
+    const absl::Duration rediscovery_interval_;
+    absl::Mutex mutex_;
+    absl::Time last_discovery_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+    bool needs_rediscovery_ ABSL_GUARDED_BY(mutex_) = false;
+    std::string root_uri_ ABSL_GUARDED_BY(mutex_);
+    // Keyed by the URI of the context node, the NodeName and the query
+    // parameters the node-set is fetched with.
+    absl::flat_hash_map<std::string, NodeSetRecord> node_sets_
+        ABSL_GUARDED_BY(mutex_);
+  };
+
+  // The executor is optional and not owned. The RedfishInterface the plan is
+  // run on must support concurrent requests if an executor is given.
   QueryPlanner(const DelliciusQuery &query,
                std::vector<std::unique_ptr<SubqueryHandle>> subquery_handles,
-               RedPathRedfishQueryParams query_params)
+               RedPathRedfishQueryParams query_params,
+               ThreadPool *executor = nullptr)
       : plan_id_(query.query_id()),
         subquery_handles_(std::move(subquery_handles)),
-        query_params_(std::move(query_params)) {}
+        query_params_(std::move(query_params)),
+        executor_(executor) {}
 
   DelliciusQueryResult Run(const RedfishVariant &variant, const Clock &clock,
                            QueryTracker *tracker) override;
 
+  // Executes several query plans at once using RedfishVariant as root, and
+  // returns their results in the same order. RedPaths are deduplicated across
+  // the plans as they are across the subqueries of a plan, so a node-set the
+  // plans have in common is only fetched once.
+  static std::vector<DelliciusQueryResult> RunMultiple(
+      absl::Span<QueryPlanner *const> query_planners,
+      const RedfishVariant &variant, const Clock &clock, QueryTracker *tracker,
+      ThreadPool *executor);
+
+  // Same as RunMultiple, with the Redfish tree resolved from the URIs recorded
+  // in the given state by the previous runs. Only the nodes whose content is
+  // needed are fetched, by URI, along with the recorded collections so that
+  // their members are up to date. Falls back to fetching the context nodes of
+  // the node-sets which are not recorded yet.
+  static std::vector<DelliciusQueryResult> RunIncremental(
+      absl::Span<QueryPlanner *const> query_planners, RedfishInterface &intf,
+      const Clock &clock, QueryTracker *tracker, ThreadPool *executor,
+      IncrementalState &state);
+
  private:
+  // Context of an incremental run.
+  struct IncrementalRunContext {
+    RedfishInterface *intf = nullptr;
+    IncrementalState *state = nullptr;
+    // Set if the Redfish tree is walked from the service root, in which case
+    // node-sets are recorded but not resolved from the records.
+    bool is_discovery = false;
+  };
+
   // NodeToSubqueryHandles associates Redfish resource pointed by NodeName to
   // all subquery handles at a certain RedPath depth.
   // Example:
@@ -153,19 +253,86 @@ class QueryPlanner final : public QueryPlannerInterface {
   //    NodeToSubqueryHandles at depth 1 : {"Chassis": {SQ1 Handle, SQ2 Handle}}
   using NodeToSubqueryHandles =
       absl::flat_hash_map<std::string, std::vector<SubqueryHandle>>;
-  // Recursively executes RedPath Step expressions across subqueries.
+
+  // Node-set obtained by querying a NodeName from the context node of an
+  // execution context.
+  struct NodeSetContext {
+    // Execution context whose context node the NodeName is queried from.
+    QueryExecutionContext *execution_context = nullptr;
+    std::string node_name;
+    // RedPaths whose next step expression has this NodeName.
+    std::vector<RedPathContext> redpath_ctx_multiple;
+    // RedPath of the node-set and the query parameters it is fetched with.
+    std::string last_executed_redpath;
+    GetParams get_params;
+    std::optional<RedfishVariant> node_set_as_variant;
+    // Set if the node-set is a collection, in which case nodes holds each
+    // member of the collection. Also set for a collection resolved from a
+    // record and fetched again, whose members in nodes are taken from it.
+    std::unique_ptr<RedfishIterable> iter;
+    std::vector<std::optional<RedfishVariant>> nodes;
+    // Set in incremental runs if the node-set is resolved from a record, in
+    // which case the node-set itself is not fetched and nodes only holds the
+    // nodes whose content is needed.
+    std::optional<IncrementalState::NodeSetRecord> record;
+    bool needs_node_content = false;
+    // Set in incremental runs if the node-set is fetched by URI rather than
+    // from its context node. A collection resolved from a record is fetched by
+    // URI for its members only.
+    std::string uri;
+  };
+
+  // Executes the query plans from the given context node, which is the service
+  // root.
+  static std::vector<DelliciusQueryResult> RunFromRoot(
+      absl::Span<QueryPlanner *const> query_planners,
+      QueryExecutionContext root_execution_context, const Clock &clock,
+      QueryTracker *tracker, ThreadPool *executor,
+      IncrementalRunContext *incremental);
+
+  // Executes RedPath Step expressions across subqueries, one step at a time.
   // Dispatches Redfish resource request for each unique NodeName in RedPath
   // Step expressions across subqueries followed by invoking predicate handlers
   // from each subquery to further refine the data that forms the context node
   // of next step expression in each qualified subquery.
-  void ExecuteRedPathStepFromEachSubquery(
-      QueryExecutionContext &execution_context, DelliciusQueryResult &result,
-      QueryTracker *tracker);
+  // In incremental runs, node-sets are resolved from the records where
+  // possible and the others are recorded once fetched.
+  static void ExecuteRedPathStepFromEachSubquery(
+      std::vector<QueryExecutionContext> execution_contexts,
+      QueryTracker *tracker, ThreadPool *executor,
+      IncrementalRunContext *incremental);
+
+  // Looks up the records of the given node-sets, then fetches the context
+  // nodes the node-sets without a usable record are queried from.
+  static void ResolveNodeSetsFromRecords(std::vector<NodeSetContext> &node_sets,
+                                         IncrementalRunContext &incremental,
+                                         ThreadPool *executor);
+
+  // Dispatches the Redfish requests for the given node-sets and the members of
+  // those which are collections, concurrently if there is an executor. Nodes of
+  // node-sets resolved from a record are fetched by URI through intf.
+  static void FetchNodeSets(std::vector<NodeSetContext> &node_sets,
+                            ThreadPool *executor, RedfishInterface *intf);
+
+  // Records the URIs of the fetched node-sets, and flags the state for
+  // rediscovery if a recorded node cannot be fetched or the members of a
+  // collection have changed.
+  static void RecordNodeSets(std::vector<NodeSetContext> &node_sets,
+                             IncrementalState &state);
+
+  // Applies the predicate expressions of each RedPath to the nodes of a
+  // fetched node-set. Normalizes the nodes of RedPaths that are fully
+  // executed and appends the context nodes of the next step expression to
+  // next_execution_contexts.
+  static void ApplyPredicateFromEachSubquery(
+      NodeSetContext &node_set, QueryTracker *tracker, bool is_incremental,
+      std::vector<QueryExecutionContext> &next_execution_contexts);
   const std::string plan_id_;
   // Collection of all SubqueryHandle instances including both root and child
   // handles.
   std::vector<std::unique_ptr<SubqueryHandle>> subquery_handles_;
   const RedPathRedfishQueryParams query_params_;
+  ThreadPool *const executor_;
 };
 
 }  // namespace ecclesia
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/dellicius/engine/internal/predicate.h"
+
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ecclesia/lib/testing/status.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+
+namespace {
+
+constexpr char kSensor[] = R"json({
+  "@odata.id": "/redfish/v1/Chassis/chassis/Sensors/fan0",
+  "Name": "fan0",
+  "Reading": 5000,
+  "ReadingType": "Rotational",
+  "ReadingRangeMax": "16000",
+  "Enabled": true,
+  "Threshold": null,
+  "Status": {"Health": "OK", "State": "Enabled"}
+})json";
+
+RedPathPredicate Compile(absl::string_view predicate) {
+  absl::StatusOr<RedPathPredicate> compiled =
+      RedPathPredicate::Compile(predicate);
+  CHECK(compiled.ok()) << compiled.status();
+  return *std::move(compiled);
+}
+
+bool Evaluate(const RedPathPredicate &predicate, const nlohmann::json &node) {
+  return predicate.Evaluate(/*node_index=*/1, /*node_set_size=*/3, node);
+}
+
+TEST(RedPathPredicateTest, SelectsNodesByPosition) {
+  nlohmann::json node;
+  EXPECT_FALSE(Compile("").NeedsNodeContent());
+  EXPECT_TRUE(Evaluate(Compile(""), node));
+  EXPECT_TRUE(Evaluate(Compile("*"), node));
+  EXPECT_TRUE(Evaluate(Compile("1"), node));
+  EXPECT_FALSE(Evaluate(Compile("2"), node));
+  RedPathPredicate last = Compile("last()");
+  EXPECT_FALSE(last.NeedsNodeContent());
+  EXPECT_FALSE(last.Evaluate(1, 3, node));
+  EXPECT_TRUE(last.Evaluate(2, 3, node));
+}
+
+TEST(RedPathPredicateTest, ComparesProperties) {
+  nlohmann::json sensor = nlohmann::json::parse(kSensor);
+  EXPECT_TRUE(Compile("Reading>4000").NeedsNodeContent());
+  EXPECT_TRUE(Evaluate(Compile("Reading>4000"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Reading>=5000"), sensor));
+  EXPECT_FALSE(Evaluate(Compile("Reading<5000"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Reading<=5000"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Reading!=1"), sensor));
+  // Numbers are also compared with numeric strings.
+  EXPECT_TRUE(Evaluate(Compile("ReadingRangeMax=16000"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("ReadingType=Rotational"), sensor));
+  EXPECT_FALSE(Evaluate(Compile("ReadingType!=Rotational"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Enabled=true"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Enabled!=false"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Threshold=null"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Status.Health=OK"), sensor));
+  EXPECT_FALSE(Evaluate(Compile("Missing=OK"), sensor));
+  EXPECT_FALSE(Evaluate(Compile("Name>1"), sensor));
+}
+
+TEST(RedPathPredicateTest, SelectsNodesByNodeName) {
+  nlohmann::json sensor = nlohmann::json::parse(kSensor);
+  EXPECT_TRUE(Evaluate(Compile("Reading"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("Status.State"), sensor));
+  EXPECT_TRUE(Evaluate(Compile("@odata.id"), sensor));
+  EXPECT_FALSE(Evaluate(Compile("Status.Missing"), sensor));
+  EXPECT_FALSE(Evaluate(Compile("Reading"), nlohmann::json()));
+}
+
+TEST(RedPathPredicateTest, CombinesExpressionsFromLeftToRight) {
+  nlohmann::json sensor = nlohmann::json::parse(kSensor);
+  EXPECT_TRUE(Evaluate(
+      Compile("Reading>4000 and ReadingType=Rotational"),
+      sensor));
+  EXPECT_FALSE(Evaluate(
+      Compile("Reading>4000 and ReadingType=Temperature"),
+      sensor));
+  EXPECT_TRUE(Evaluate(
+      Compile("Reading<4000 or ReadingType=Rotational"),
+      sensor));
+  EXPECT_FALSE(Evaluate(Compile("Reading<4000 or Missing or 2"), sensor));
+  // No precedence: (true or false) and false.
+  EXPECT_FALSE(Evaluate(Compile("Reading or Missing and Missing"), sensor));
+}
+
+TEST(RedPathPredicateTest, InvalidPredicatesFailToCompile) {
+  for (absl::string_view predicate :
+       {"and Reading", "Reading Name", "Reading and or Name", "Reading=>1",
+        "Reading and"}) {
+    EXPECT_THAT(RedPathPredicate::Compile(predicate),
+                IsStatusInvalidArgument())
+        << predicate;
+  }
+}
+
+}  // namespace
+
+}  // namespace ecclesia
@@ -20,6 +20,7 @@
 #include <array>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -28,6 +29,7 @@
 #include "ecclesia/lib/file/test_filesystem.h"
 #include "ecclesia/lib/protobuf/parse.h"
 #include "ecclesia/lib/redfish/dellicius/engine/config.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/testing/test_compiled_queries_embedded.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/testing/test_queries_embedded.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/testing/test_query_rules_embedded.h"
 #include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
@@ -60,7 +62,18 @@ MATCHER(RedPathExpandConfigsEq, "") {
 }
 
 void VerifyTrackedPathWithParamsMatchExpected(
-    const std::vector<RedPathToQueryParams> &actual_configs) {
+    const QueryTracker &query_tracker) {
+  std::vector<RedPathToQueryParams> actual_configs;
+  actual_configs.reserve(query_tracker.redpaths_queried.size());
+  for (const auto &paths_with_params : query_tracker.redpaths_queried) {
+    RedPathToQueryParams redpath_to_query_params;
+    redpath_to_query_params.tracked_path = paths_with_params.first;
+    if (paths_with_params.second.expand.has_value()) {
+      redpath_to_query_params.query_params =
+          paths_with_params.second.expand->ToString();
+    }
+    actual_configs.push_back(redpath_to_query_params);
+  }
   const std::vector<RedPathToQueryParams> expected_configs = {
       RedPathToQueryParams{"/Chassis", "$expand=.($levels=1)"},
       RedPathToQueryParams{"/Chassis[*]", ""},
@@ -144,18 +157,31 @@ TEST_F(QueryEngineTest, QueryEngineWithExpandConfiguration) {
   EXPECT_THAT(intent_output_sensor,
               IgnoringRepeatedFieldOrdering(EqualsProto(response_entries[0])));
 
-  std::vector<RedPathToQueryParams> tracked_configs;
-  tracked_configs.reserve(query_tracker.redpaths_queried.size());
-  for (auto paths_with_params : query_tracker.redpaths_queried) {
-    RedPathToQueryParams redpath_to_query_params;
-    redpath_to_query_params.tracked_path = paths_with_params.first;
-    if (paths_with_params.second.expand.has_value()) {
-      redpath_to_query_params.query_params =
-          paths_with_params.second.expand->ToString();
-    }
-    tracked_configs.push_back(redpath_to_query_params);
-  }
-  VerifyTrackedPathWithParamsMatchExpected(tracked_configs);
+  VerifyTrackedPathWithParamsMatchExpected(query_tracker);
+}
+
+TEST_F(QueryEngineTest, QueryEngineWithCompiledQueries) {
+  std::string assembly_out_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_out/assembly_out.textproto"));
+
+  // Compiled queries carry their own query rules.
+  QueryEngineConfiguration config{
+      .flags{.enable_devpath_extension = false,
+             .enable_cached_uri_dispatch = false},
+      .compiled_queries{kCompiledQueries.begin(), kCompiledQueries.end()}};
+
+  QueryEngine query_engine(config, &clock_, std::move(intf_));
+  QueryTracker query_tracker;
+  std::vector<DelliciusQueryResult> response_entries =
+      query_engine.ExecuteQuery(
+          {"AssemblyCollectorWithPropertyNameNormalization"}, query_tracker);
+  DelliciusQueryResult intent_output_assembly =
+      ParseTextFileAsProtoOrDie<DelliciusQueryResult>(assembly_out_path);
+  EXPECT_EQ(response_entries.size(), 1);
+  EXPECT_THAT(intent_output_assembly,
+              IgnoringRepeatedFieldOrdering(EqualsProto(response_entries[0])));
+
+  VerifyTrackedPathWithParamsMatchExpected(query_tracker);
 }
 
 TEST_F(QueryEngineTest, QueryEngineInvalidQueries) {
@@ -20,17 +20,24 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "ecclesia/lib/file/path.h"
 #include "ecclesia/lib/file/test_filesystem.h"
 #include "ecclesia/lib/protobuf/parse.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/factory.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/query_planner.h"
+#include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query_result.pb.h"
 #include "ecclesia/lib/redfish/interface.h"
@@ -39,10 +46,14 @@
 #include "ecclesia/lib/redfish/topology.h"
 #include "ecclesia/lib/redfish/transport/cache.h"
 #include "ecclesia/lib/redfish/transport/http_redfish_intf.h"
+#include "ecclesia/lib/redfish/transport/interface.h"
 #include "ecclesia/lib/redfish/transport/metrical_transport.h"
 #include "ecclesia/lib/redfish/transport/transport_metrics.pb.h"
 #include "ecclesia/lib/testing/proto.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "ecclesia/lib/time/clock_fake.h"
+#include "single_include/nlohmann/json.hpp"
+#include "tensorflow_serving/util/net_http/server/public/server_request_interface.h"
 
 namespace ecclesia {
 
@@ -51,6 +62,51 @@ namespace {
 constexpr absl::string_view kQuerySamplesLocation =
     "lib/redfish/dellicius/query/samples";
 
+// Forwards requests to a base transport and records the highest number of GET
+// requests which were in flight at the same time.
+class ConcurrencyTrackingTransport : public RedfishTransport {
+ public:
+  explicit ConcurrencyTrackingTransport(std::unique_ptr<RedfishTransport> base)
+      : base_(std::move(base)) {}
+
+  absl::string_view GetRootUri() override { return base_->GetRootUri(); }
+  absl::StatusOr<Result> Get(absl::string_view path) override {
+    {
+      absl::MutexLock lock(&mutex_);
+      peak_in_flight_ = std::max(peak_in_flight_, ++in_flight_);
+    }
+    // Keep the request in flight long enough for concurrent ones to overlap.
+    absl::SleepFor(absl::Milliseconds(5));
+    absl::StatusOr<Result> result = base_->Get(path);
+    absl::MutexLock lock(&mutex_);
+    --in_flight_;
+    return result;
+  }
+  absl::StatusOr<Result> Post(absl::string_view path,
+                              absl::string_view data) override {
+    return base_->Post(path, data);
+  }
+  absl::StatusOr<Result> Patch(absl::string_view path,
+                               absl::string_view data) override {
+    return base_->Patch(path, data);
+  }
+  absl::StatusOr<Result> Delete(absl::string_view path,
+                                absl::string_view data) override {
+    return base_->Delete(path, data);
+  }
+
+  int peak_in_flight() {
+    absl::MutexLock lock(&mutex_);
+    return peak_in_flight_;
+  }
+
+ private:
+  std::unique_ptr<RedfishTransport> base_;
+  absl::Mutex mutex_;
+  int in_flight_ ABSL_GUARDED_BY(mutex_) = 0;
+  int peak_in_flight_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
 class QueryPlannerTestRunner : public ::testing::Test {
  protected:
   QueryPlannerTestRunner() = default;
@@ -61,12 +117,14 @@ class QueryPlannerTestRunner : public ::testing::Test {
   }
 
   void TestQuery(const std::string &query_in_path,
-                 const std::string &query_out_path, Normalizer *normalizer) {
+                 const std::string &query_out_path, Normalizer *normalizer,
+                 ThreadPool *executor = nullptr) {
     CHECK(server_ != nullptr && intf_ != nullptr && clock_ != nullptr)
         << "Test parameters not set!";
     DelliciusQuery query =
         ParseTextFileAsProtoOrDie<DelliciusQuery>(query_in_path);
-    auto qp = BuildQueryPlanner(query, RedPathRedfishQueryParams{}, normalizer);
+    auto qp = BuildQueryPlanner(query, RedPathRedfishQueryParams{}, normalizer,
+                                executor);
     ASSERT_TRUE(qp.ok());
     DelliciusQueryResult query_result =
         (*qp)->Run(intf_->GetRoot(), *clock_, nullptr);
@@ -148,6 +206,28 @@ TEST_F(QueryPlannerTestRunner,
   TestQuery(query_in_path, query_out_path, normalizer_with_devpath.get());
 }
 
+TEST_F(QueryPlannerTestRunner, ExecutorDispatchesRequestsConcurrently) {
+  std::string query_in_path = GetTestDataDependencyPath(JoinFilePaths(
+      kQuerySamplesLocation, "query_in/sensor_in_links.textproto"));
+  std::string query_out_path = GetTestDataDependencyPath(JoinFilePaths(
+      kQuerySamplesLocation, "query_out/sensor_out_links.textproto"));
+  SetTestParams("indus_hmb_shim/mockup.shar", absl::FromUnixSeconds(10));
+  auto transport = std::make_unique<ConcurrencyTrackingTransport>(
+      server_->RedfishClientTransport());
+  ConcurrencyTrackingTransport *tracker = transport.get();
+  auto cache = std::make_unique<NullCache>(transport.get());
+  intf_ = NewHttpInterface(std::move(transport), std::move(cache),
+                           RedfishInterface::kTrusted);
+  auto topology = CreateTopologyFromRedfish(intf_.get());
+  auto normalizer_with_devpath = BuildDefaultNormalizerWithDevpath(topology);
+  ThreadPool executor(4);
+  TestQuery(query_in_path, query_out_path, normalizer_with_devpath.get(),
+            &executor);
+  // Requests ran on the 4 executor threads and on the calling thread.
+  EXPECT_GT(tracker->peak_in_flight(), 1);
+  EXPECT_LE(tracker->peak_in_flight(), 5);
+}
+
 TEST(QueryPlannerTest, CheckQueryPlannerInitFailsWithInvalidSubqueryLinks) {
   std::string query_in_path = GetTestDataDependencyPath(JoinFilePaths(
       kQuerySamplesLocation, "query_in/malformed_query_links.textproto"));
@@ -171,6 +251,33 @@ TEST(QueryPlannerTest,
   EXPECT_FALSE(qp.ok());
 }
 
+TEST(QueryPlannerTest, CompileQueryFailsWithMalformedQueries) {
+  for (absl::string_view query_file :
+       {"query_in/malformed_query.textproto",
+        "query_in/malformed_query_links.textproto"}) {
+    std::string query_in_path = GetTestDataDependencyPath(
+        JoinFilePaths(kQuerySamplesLocation, query_file));
+    DelliciusQuery query =
+        ParseTextFileAsProtoOrDie<DelliciusQuery>(query_in_path);
+    EXPECT_FALSE(
+        CompileQuery(query, QueryRules::RedPathPrefixSetWithQueryParams{})
+            .ok());
+  }
+}
+
+TEST(QueryPlannerTest, CompileQueryFailsWithInvalidPredicate) {
+  DelliciusQuery query = ParseTextProtoOrDie(R"pb(
+    query_id: "InvalidPredicate"
+    subquery {
+      subquery_id: "Sensors"
+      redpath: "/Chassis[*]/Sensors[Reading and]"
+      properties { property: "Name" type: STRING }
+    }
+  )pb");
+  EXPECT_FALSE(
+      CompileQuery(query, QueryRules::RedPathPrefixSetWithQueryParams{}).ok());
+}
+
 TEST(QueryPlannerTest, CheckQueryPlannerSendsOneRequestForEachUri) {
   std::string sensor_in_path = GetTestDataDependencyPath(
       JoinFilePaths(kQuerySamplesLocation, "query_in/sensor_in.textproto"));
@@ -212,6 +319,297 @@ TEST(QueryPlannerTest, CheckQueryPlannerSendsOneRequestForEachUri) {
   }
 }
 
+TEST(QueryPlannerTest, RunMultipleSendsOneRequestForEachUriAcrossQueries) {
+  std::string assembly_in_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_in/assembly_in.textproto"));
+  std::string sensor_in_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_in/sensor_in.textproto"));
+  std::string assembly_out_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_out/assembly_out.textproto"));
+  std::string sensor_out_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_out/sensor_out.textproto"));
+  FakeClock clock(absl::FromUnixSeconds(10));
+  FakeRedfishServer server("indus_hmb_shim/mockup.shar");
+  auto default_normalizer = BuildDefaultNormalizer();
+  RedfishMetrics metrics;
+  {
+    std::unique_ptr<RedfishTransport> base_transport =
+        server.RedfishClientTransport();
+    auto transport = std::make_unique<MetricalRedfishTransport>(
+        std::move(base_transport), Clock::RealClock(), metrics);
+
+    auto cache = std::make_unique<NullCache>(transport.get());
+    auto intf = NewHttpInterface(std::move(transport), std::move(cache),
+                                 RedfishInterface::kTrusted);
+    auto service_root = intf->GetRoot();
+
+    auto assembly_qp = BuildQueryPlanner(
+        ParseTextFileAsProtoOrDie<DelliciusQuery>(assembly_in_path),
+        RedPathRedfishQueryParams{}, default_normalizer.get());
+    ASSERT_TRUE(assembly_qp.ok());
+    auto sensor_qp = BuildQueryPlanner(
+        ParseTextFileAsProtoOrDie<DelliciusQuery>(sensor_in_path),
+        RedPathRedfishQueryParams{}, default_normalizer.get());
+    ASSERT_TRUE(sensor_qp.ok());
+    QueryPlanner *query_planners[] = {assembly_qp->get(), sensor_qp->get()};
+    std::vector<DelliciusQueryResult> results = QueryPlanner::RunMultiple(
+        query_planners, service_root, clock, nullptr, nullptr);
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_THAT(
+        ParseTextFileAsProtoOrDie<DelliciusQueryResult>(assembly_out_path),
+        IgnoringRepeatedFieldOrdering(EqualsProto(results[0])));
+    EXPECT_THAT(
+        ParseTextFileAsProtoOrDie<DelliciusQueryResult>(sensor_out_path),
+        IgnoringRepeatedFieldOrdering(EqualsProto(results[1])));
+  }
+  // Both queries query the Chassis collection, which must only be fetched
+  // once for the two of them.
+  for (const auto &uri_x_metric : *metrics.mutable_uri_to_metrics_map()) {
+    for (const auto &metadata :
+         uri_x_metric.second.request_type_to_metadata()) {
+      EXPECT_EQ(metadata.second.request_count(), 1);
+    }
+  }
+}
+
+TEST(QueryPlannerTest, RunIncrementalOnlyFetchesLeavesOnceDiscovered) {
+  std::string sensor_in_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_in/sensor_in.textproto"));
+  std::string sensor_out_path = GetTestDataDependencyPath(
+      JoinFilePaths(kQuerySamplesLocation, "query_out/sensor_out.textproto"));
+  FakeClock clock(absl::FromUnixSeconds(10));
+  FakeRedfishServer server("indus_hmb_shim/mockup.shar");
+  auto default_normalizer = BuildDefaultNormalizer();
+  RedfishMetrics metrics;
+  auto transport = std::make_unique<MetricalRedfishTransport>(
+      server.RedfishClientTransport(), Clock::RealClock(), metrics);
+  auto cache = std::make_unique<NullCache>(transport.get());
+  auto intf = NewHttpInterface(std::move(transport), std::move(cache),
+                               RedfishInterface::kTrusted);
+  auto sensor_qp = BuildQueryPlanner(
+      ParseTextFileAsProtoOrDie<DelliciusQuery>(sensor_in_path),
+      RedPathRedfishQueryParams{}, default_normalizer.get());
+  ASSERT_TRUE(sensor_qp.ok());
+  QueryPlanner *query_planners[] = {sensor_qp->get()};
+  QueryPlanner::IncrementalState state(absl::Minutes(5));
+  DelliciusQueryResult expected_result =
+      ParseTextFileAsProtoOrDie<DelliciusQueryResult>(sensor_out_path);
+
+  // The first run walks the Redfish tree from the service root.
+  std::vector<DelliciusQueryResult> results = QueryPlanner::RunIncremental(
+      query_planners, *intf, clock, nullptr, nullptr, state);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_THAT(expected_result,
+              IgnoringRepeatedFieldOrdering(EqualsProto(results[0])));
+  EXPECT_TRUE(metrics.uri_to_metrics_map().contains("/redfish/v1"));
+  EXPECT_TRUE(metrics.uri_to_metrics_map().contains("/redfish/v1/Chassis"));
+  size_t discovery_uri_count = metrics.uri_to_metrics_map().size();
+
+  // The next runs fetch the sensors and the collections, but neither the
+  // service root nor the chassis.
+  metrics.Clear();
+  results = QueryPlanner::RunIncremental(query_planners, *intf, clock, nullptr,
+                                         nullptr, state);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_THAT(expected_result,
+              IgnoringRepeatedFieldOrdering(EqualsProto(results[0])));
+  EXPECT_FALSE(metrics.uri_to_metrics_map().contains("/redfish/v1"));
+  EXPECT_TRUE(metrics.uri_to_metrics_map().contains("/redfish/v1/Chassis"));
+  EXPECT_FALSE(
+      metrics.uri_to_metrics_map().contains("/redfish/v1/Chassis/chassis"));
+  EXPECT_TRUE(metrics.uri_to_metrics_map().contains(
+      "/redfish/v1/Chassis/chassis/Sensors"));
+  EXPECT_LT(metrics.uri_to_metrics_map().size(), discovery_uri_count);
+
+  // The tree is walked again once the rediscovery interval has elapsed.
+  metrics.Clear();
+  clock.AdvanceTime(absl::Minutes(5));
+  QueryPlanner::RunIncremental(query_planners, *intf, clock, nullptr, nullptr,
+                               state);
+  EXPECT_TRUE(metrics.uri_to_metrics_map().contains("/redfish/v1"));
+  EXPECT_EQ(metrics.uri_to_metrics_map().size(), discovery_uri_count);
+}
+
+class QueryPlannerIncrementalTest : public ::testing::Test {
+ protected:
+  QueryPlannerIncrementalTest()
+      : server_("indus_hmb_shim/mockup.shar"),
+        clock_(absl::FromUnixSeconds(10)),
+        normalizer_(BuildDefaultNormalizer()),
+        state_(absl::Minutes(5)) {
+    auto transport = std::make_unique<MetricalRedfishTransport>(
+        server_.RedfishClientTransport(), Clock::RealClock(), metrics_);
+    auto cache = std::make_unique<NullCache>(transport.get());
+    intf_ = NewHttpInterface(std::move(transport), std::move(cache),
+                             RedfishInterface::kTrusted);
+    std::string sensor_in_path = GetTestDataDependencyPath(
+        JoinFilePaths(kQuerySamplesLocation, "query_in/sensor_in.textproto"));
+    auto sensor_qp = BuildQueryPlanner(
+        ParseTextFileAsProtoOrDie<DelliciusQuery>(sensor_in_path),
+        RedPathRedfishQueryParams{}, normalizer_.get());
+    CHECK(sensor_qp.ok());
+    sensor_qp_ = *std::move(sensor_qp);
+  }
+
+  static void SendJsonHttpResponse(
+      ::tensorflow::serving::net_http::ServerRequestInterface *req,
+      const nlohmann::json &json) {
+    ::tensorflow::serving::net_http::SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(json.dump());
+    req->Reply();
+  }
+
+  // Serves the chassis collection with the given members.
+  void SetChassisMembers(const std::vector<std::string> &member_uris) {
+    nlohmann::json chassis_collection = {
+        {"@odata.id", "/redfish/v1/Chassis"},
+        {"@odata.type", "#ChassisCollection.ChassisCollection"},
+        {"Members", nlohmann::json::array()},
+        {"Members@odata.count", member_uris.size()},
+        {"Name", "Indus"}};
+    for (const std::string &member_uri : member_uris) {
+      chassis_collection["Members"].push_back(
+          nlohmann::json{{"@odata.id", member_uri}});
+    }
+    server_.AddHttpGetHandler(
+        "/redfish/v1/Chassis",
+        [chassis_collection](
+            ::tensorflow::serving::net_http::ServerRequestInterface *req) {
+          SendJsonHttpResponse(req, chassis_collection);
+        });
+  }
+
+  // Returns the number of sensors the query returns, after clearing the
+  // metrics.
+  int RunSensorQuery() {
+    metrics_.Clear();
+    QueryPlanner *query_planners[] = {sensor_qp_.get()};
+    std::vector<DelliciusQueryResult> results = QueryPlanner::RunIncremental(
+        query_planners, *intf_, clock_, nullptr, nullptr, state_);
+    CHECK_EQ(results.size(), 1);
+    auto iter = results[0].subquery_output_by_id().find("Sensors");
+    if (iter == results[0].subquery_output_by_id().end()) return 0;
+    return iter->second.data_sets_size();
+  }
+
+  bool IsRediscovery() {
+    return metrics_.uri_to_metrics_map().contains("/redfish/v1");
+  }
+
+  FakeRedfishServer server_;
+  FakeClock clock_;
+  std::unique_ptr<Normalizer> normalizer_;
+  RedfishMetrics metrics_;
+  std::unique_ptr<RedfishInterface> intf_;
+  std::unique_ptr<QueryPlanner> sensor_qp_;
+  QueryPlanner::IncrementalState state_;
+};
+
+TEST_F(QueryPlannerIncrementalTest, RediscoversWhenMemberIsAdded) {
+  int sensor_count = RunSensorQuery();
+  ASSERT_GT(sensor_count, 0);
+  EXPECT_EQ(RunSensorQuery(), sensor_count);
+  EXPECT_FALSE(IsRediscovery());
+
+  // Plug in a second chassis sharing the sensors of the first one.
+  nlohmann::json chassis =
+      intf_->CachedGetUri("/redfish/v1/Chassis/chassis")
+          .AsObject()
+          ->GetContentAsJson();
+  chassis["@odata.id"] = "/redfish/v1/Chassis/chassis2";
+  server_.AddHttpGetHandler(
+      "/redfish/v1/Chassis/chassis2",
+      [chassis](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        SendJsonHttpResponse(req, chassis);
+      });
+  SetChassisMembers({"/redfish/v1/Chassis/chassis",
+                     "/redfish/v1/Chassis/chassis2"});
+
+  // The new chassis is seen by the next run, which flags the state for
+  // rediscovery.
+  EXPECT_EQ(RunSensorQuery(), 2 * sensor_count);
+  EXPECT_FALSE(IsRediscovery());
+  EXPECT_EQ(RunSensorQuery(), 2 * sensor_count);
+  EXPECT_TRUE(IsRediscovery());
+  EXPECT_EQ(RunSensorQuery(), 2 * sensor_count);
+  EXPECT_FALSE(IsRediscovery());
+}
+
+TEST_F(QueryPlannerIncrementalTest, RediscoversWhenMemberIsRemoved) {
+  ASSERT_GT(RunSensorQuery(), 0);
+  SetChassisMembers({});
+
+  EXPECT_EQ(RunSensorQuery(), 0);
+  EXPECT_FALSE(IsRediscovery());
+  EXPECT_EQ(RunSensorQuery(), 0);
+  EXPECT_TRUE(IsRediscovery());
+  EXPECT_EQ(RunSensorQuery(), 0);
+  EXPECT_FALSE(IsRediscovery());
+}
+
+TEST_F(QueryPlannerIncrementalTest, RediscoversWhenFetchFails) {
+  int sensor_count = RunSensorQuery();
+  ASSERT_GT(sensor_count, 0);
+  server_.AddHttpGetHandler(
+      "/redfish/v1/Chassis/chassis/Sensors",
+      [](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        req->ReplyWithStatus(
+            ::tensorflow::serving::net_http::HTTPStatusCode::NOT_FOUND);
+      });
+
+  EXPECT_EQ(RunSensorQuery(), 0);
+  EXPECT_FALSE(IsRediscovery());
+  server_.ClearHandlers();
+  EXPECT_EQ(RunSensorQuery(), sensor_count);
+  EXPECT_TRUE(IsRediscovery());
+  EXPECT_EQ(RunSensorQuery(), sensor_count);
+  EXPECT_FALSE(IsRediscovery());
+}
+
+TEST_F(QueryPlannerIncrementalTest, TakesMembersEmbeddedInRecordedCollection) {
+  // The predicate reads the content of each chassis, so the chassis are
+  // fetched on every run unless their collection embeds them.
+  DelliciusQuery query = ParseTextProtoOrDie(R"pb(
+    query_id: "SensorCollector"
+    subquery {
+      subquery_id: "Sensors"
+      redpath: "/Chassis[Sensors]/Sensors[*]"
+      properties { property: "Name" type: STRING }
+    }
+  )pb");
+  auto sensor_qp = BuildQueryPlanner(query, RedPathRedfishQueryParams{},
+                                     normalizer_.get());
+  ASSERT_TRUE(sensor_qp.ok());
+  sensor_qp_ = *std::move(sensor_qp);
+
+  // Serve the chassis embedded in their collection, as when it is expanded.
+  nlohmann::json chassis =
+      intf_->CachedGetUri("/redfish/v1/Chassis/chassis")
+          .AsObject()
+          ->GetContentAsJson();
+  nlohmann::json chassis_collection = {
+      {"@odata.id", "/redfish/v1/Chassis"},
+      {"@odata.type", "#ChassisCollection.ChassisCollection"},
+      {"Members", nlohmann::json::array({chassis})},
+      {"Members@odata.count", 1},
+      {"Name", "Indus"}};
+  server_.AddHttpGetHandler(
+      "/redfish/v1/Chassis",
+      [chassis_collection](
+          ::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        SendJsonHttpResponse(req, chassis_collection);
+      });
+
+  int sensor_count = RunSensorQuery();
+  ASSERT_GT(sensor_count, 0);
+  EXPECT_EQ(RunSensorQuery(), sensor_count);
+  EXPECT_FALSE(IsRediscovery());
+  EXPECT_TRUE(metrics_.uri_to_metrics_map().contains("/redfish/v1/Chassis"));
+  EXPECT_FALSE(
+      metrics_.uri_to_metrics_map().contains("/redfish/v1/Chassis/chassis"));
+}
+
 TEST(QueryPlannerTest, CheckQueryPlannerStopsQueryingOnTransportError) {
   std::string sensor_in_path = GetTestDataDependencyPath(
       JoinFilePaths(kQuerySamplesLocation, "query_in/sensor_in.textproto"));
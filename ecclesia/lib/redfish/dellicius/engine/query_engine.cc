@@ -17,15 +17,18 @@
 #include "ecclesia/lib/redfish/dellicius/engine/query_engine.h"
 
 #include <memory>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "ecclesia/lib/file/cc_embed_interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/compiled_query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/engine/config.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/factory.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/query_planner.h"
 #include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
 #include "ecclesia/lib/redfish/dellicius/query/query_result.pb.h"
@@ -33,6 +36,7 @@
 #include "ecclesia/lib/redfish/interface.h"
 #include "ecclesia/lib/redfish/node_topology.h"
 #include "ecclesia/lib/redfish/topology.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "ecclesia/lib/time/clock.h"
 #include "google/protobuf/text_format.h"
 
@@ -44,7 +48,11 @@ class QueryEngineImpl final : public QueryEngine::QueryEngineIntf {
  public:
   QueryEngineImpl(const QueryEngineConfiguration &config, const Clock *clock,
                   std::unique_ptr<RedfishInterface> intf)
-      : clock_(clock), intf_(std::move(intf)) {
+      : clock_(clock), intf_(std::move(intf)), executor_(config.executor) {
+    if (config.flags.enable_incremental_execution) {
+      incremental_state_ = std::make_unique<QueryPlanner::IncrementalState>(
+          config.rediscovery_interval);
+    }
     if (config.flags.enable_devpath_extension) {
       topology_ = CreateTopologyFromRedfish(intf_.get());
       normalizer_ = BuildDefaultNormalizerWithDevpath(topology_);
@@ -52,6 +60,27 @@ class QueryEngineImpl final : public QueryEngine::QueryEngineIntf {
       normalizer_ = BuildDefaultNormalizer();
     }
 
+    // Build query plans from compiled queries first, since they need no
+    // parsing.
+    for (const EmbeddedFile &compiled_file : config.compiled_queries) {
+      CompiledQueries compiled_queries;
+      if (!compiled_queries.ParseFromArray(compiled_file.data.data(),
+                                           compiled_file.data.size())) {
+        LOG(ERROR) << "Cannot get compiled queries from embedded file "
+                   << compiled_file.name;
+        continue;
+      }
+      for (const CompiledQuery &compiled_query : compiled_queries.query()) {
+        const std::string &query_id = compiled_query.query().query_id();
+        if (id_to_query_plans_.contains(query_id)) continue;
+        absl::StatusOr<std::unique_ptr<QueryPlanner>> query_planner =
+            BuildQueryPlanner(compiled_query, normalizer_.get(),
+                              config.executor);
+        if (!query_planner.ok()) continue;
+        id_to_query_plans_.emplace(query_id, std::move(*query_planner));
+      }
+    }
+
     // Parse query rules from embedded proto messages
     absl::flat_hash_map<std::string, RedPathRedfishQueryParams>
         query_id_to_rules =
@@ -68,23 +97,27 @@ class QueryEngineImpl final : public QueryEngine::QueryEngineIntf {
 
       // Build a query plan if none exists for the query id
       if (id_to_query_plans_.contains(query.query_id())) continue;
-      absl::StatusOr<std::unique_ptr<QueryPlannerInterface>> query_planner;
+      absl::StatusOr<std::unique_ptr<QueryPlanner>> query_planner;
       if (auto iter = query_id_to_rules.find(query.query_id());
           iter != query_id_to_rules.end()) {
         query_planner = BuildQueryPlanner(query, std::move(iter->second),
-                                          normalizer_.get());
+                                          normalizer_.get(), config.executor);
       } else {
         query_planner = BuildQueryPlanner(query, RedPathRedfishQueryParams{},
-                                          normalizer_.get());
+                                          normalizer_.get(), config.executor);
       }
       if (!query_planner.ok()) continue;
       id_to_query_plans_.emplace(query.query_id(), std::move(*query_planner));
     }
   }
 
+  // Executes all the query plans at once, from a single fetch of the service
+  // root, so that Redfish resources the queries have in common are only
+  // fetched once. In incremental execution, the service root is only fetched
+  // when the Redfish tree is rediscovered.
   std::vector<DelliciusQueryResult> ExecuteQuery(
       absl::Span<const absl::string_view> query_ids, QueryTracker *tracker) {
-    std::vector<DelliciusQueryResult> response_entries;
+    std::vector<QueryPlanner *> query_plans;
     for (const absl::string_view query_id : query_ids) {
       auto it = id_to_query_plans_.find(query_id);
       if (it == id_to_query_plans_.end()) {
@@ -95,11 +128,16 @@ class QueryEngineImpl final : public QueryEngine::QueryEngineIntf {
         LOG(ERROR) << "Query plan is null for id " << query_id;
         continue;
       }
-      DelliciusQueryResult result_single =
-          it->second->Run(intf_->GetRoot(), *clock_, tracker);
-      response_entries.push_back(std::move(result_single));
+      query_plans.push_back(it->second.get());
+    }
+    if (query_plans.empty()) return {};
+    if (incremental_state_ != nullptr) {
+      return QueryPlanner::RunIncremental(query_plans, *intf_, *clock_,
+                                          tracker, executor_,
+                                          *incremental_state_);
     }
-    return response_entries;
+    return QueryPlanner::RunMultiple(query_plans, intf_->GetRoot(), *clock_,
+                                     tracker, executor_);
   }
 
   std::vector<DelliciusQueryResult> ExecuteQuery(
@@ -116,12 +154,16 @@ class QueryEngineImpl final : public QueryEngine::QueryEngineIntf {
  private:
   // Data normalizer to inject in QueryPlanner for normalizing redfish
   // response per a given property specification in dellicius subquery.
-  absl::flat_hash_map<std::string, std::unique_ptr<QueryPlannerInterface>>
+  absl::flat_hash_map<std::string, std::unique_ptr<QueryPlanner>>
       id_to_query_plans_;
   const Clock *clock_;
   std::unique_ptr<Normalizer> normalizer_;
   std::unique_ptr<RedfishInterface> intf_;
   NodeTopology topology_;
+  ThreadPool *executor_;
+  // Set if queries are executed incrementally. Shared by all the query plans,
+  // since the node-sets they have in common resolve to the same URIs.
+  std::unique_ptr<QueryPlanner::IncrementalState> incremental_state_;
 };
 
 }  // namespace
@@ -55,6 +55,9 @@
 
 ABSL_FLAG(bool, devpath_enabled, false, "Boolean to enable devpath extension.");
 ABSL_FLAG(bool, metrics_enabled, false, "Boolean to enable redfish metrics.");
+ABSL_FLAG(bool, json_documents_enabled, false,
+          "Boolean to parse Redfish payloads into JsonDocuments instead of "
+          "nlohmann::json.");
 ABSL_FLAG(std::string, hostname, "localhost",
           "Hostname of the Redfish server.");
 ABSL_FLAG(int, port, 8000, "Port number of the server.");
@@ -153,25 +156,31 @@ int QueryMain(int argc, char **argv) {
              .enable_cached_uri_dispatch = false},
       .query_files{embedded_files}};
   // Configure HTTP transport.
+  JsonParserBackend json_parser = absl::GetFlag(FLAGS_json_documents_enabled)
+                                      ? JsonParserBackend::kJsonDocument
+                                      : JsonParserBackend::kNlohmann;
   auto curl_http_client = std::make_unique<CurlHttpClient>(
       LibCurlProxy::CreateInstance(), HttpCredential());
   std::unique_ptr<HttpRedfishTransport> base_transport =
       HttpRedfishTransport::MakeNetwork(
           std::move(curl_http_client),
           absl::StrCat(absl::GetFlag(FLAGS_hostname), ":",
-                       absl::GetFlag(FLAGS_port)));
+                       absl::GetFlag(FLAGS_port)),
+          DefaultHttpHeaderConditionForJson(), json_parser);
   RedfishMetrics transport_metrics;
   std::unique_ptr<RedfishInterface> intf;
-  std::unique_ptr<NullCache> cache;
   std::unique_ptr<RedfishTransport> transport = std::move(base_transport);
   {
     if (absl::GetFlag(FLAGS_metrics_enabled)) {
       transport = std::make_unique<MetricalRedfishTransport>(
           std::move(transport), Clock::RealClock(), transport_metrics);
     }
-    cache = std::make_unique<NullCache>(transport.get());
-    intf = NewHttpInterface(std::move(transport), std::move(cache),
-                            RedfishInterface::kTrusted);
+    intf = NewHttpInterface(
+        std::move(transport),
+        [](RedfishTransport *transport) {
+          return std::make_unique<NullCache>(transport);
+        },
+        RedfishInterface::kTrusted, json_parser);
     if (auto root = intf->GetRoot(); root.AsObject() == nullptr) {
       LOG(ERROR) << "Error connecting to redfish service. "
                  << "Check host configuration";
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This is a command-line utility that compiles Dellicius queries at build time
+// into a binary CompiledQueries proto, for cc_compiled_query_library.
+//
+// The utility takes a list of query files in text format, and optionally files
+// of query rules in text format. Each query is compiled with the rule matching
+// its query id, and the utility fails if any query cannot be parsed or
+// compiled, or if two queries have the same id.
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/statusor.h"
+#include "ecclesia/lib/protobuf/parse.h"
+#include "ecclesia/lib/redfish/dellicius/engine/compiled_query.pb.h"
+#include "ecclesia/lib/redfish/dellicius/engine/internal/factory.h"
+#include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
+#include "ecclesia/lib/redfish/dellicius/query/query.pb.h"
+
+ABSL_FLAG(std::string, output, "",
+          "Path of the binary CompiledQueries proto to write.");
+ABSL_FLAG(std::vector<std::string>, query_rules, {},
+          "Paths of the QueryRules text protos for the queries.");
+
+namespace ecclesia {
+
+namespace {
+
+int QueryCompilerMain(int argc, char **argv) {
+  std::vector<char *> args = absl::ParseCommandLine(argc, argv);
+  absl::InitializeLog();
+
+  std::string output_path = absl::GetFlag(FLAGS_output);
+  if (output_path.empty()) {
+    LOG(ERROR) << "output was not specified";
+    return 1;
+  }
+  // Strip off the leading entry of args. The rest of the arguments are the
+  // query files to compile.
+  args.erase(args.begin());
+
+  QueryRules query_rules;
+  for (const std::string &rules_path : absl::GetFlag(FLAGS_query_rules)) {
+    query_rules.MergeFrom(ParseTextFileAsProtoOrDie<QueryRules>(rules_path));
+  }
+
+  CompiledQueries compiled_queries;
+  absl::flat_hash_set<std::string> query_ids;
+  for (const char *query_path : args) {
+    DelliciusQuery query =
+        ParseTextFileAsProtoOrDie<DelliciusQuery>(query_path);
+    if (!query_ids.insert(query.query_id()).second) {
+      LOG(ERROR) << "Multiple queries with id " << query.query_id();
+      return 1;
+    }
+    const auto &id_to_rule = query_rules.query_id_to_params_rule();
+    QueryRules::RedPathPrefixSetWithQueryParams query_rule;
+    if (auto iter = id_to_rule.find(query.query_id());
+        iter != id_to_rule.end()) {
+      query_rule = iter->second;
+    }
+    absl::StatusOr<CompiledQuery> compiled_query =
+        CompileQuery(query, query_rule);
+    if (!compiled_query.ok()) {
+      LOG(ERROR) << "Cannot compile query " << query_path << ": "
+                 << compiled_query.status();
+      return 1;
+    }
+    *compiled_queries.add_query() = *std::move(compiled_query);
+  }
+
+  std::ofstream output(output_path, std::ofstream::binary);
+  if (!output.is_open() || !compiled_queries.SerializeToOstream(&output)) {
+    LOG(ERROR) << "Cannot write compiled queries to " << output_path;
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+}  // namespace ecclesia
+
+int main(int argc, char **argv) {
+  return ecclesia::QueryCompilerMain(argc, argv);
+}
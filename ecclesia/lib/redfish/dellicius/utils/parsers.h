@@ -20,9 +20,15 @@
 #include "absl/container/flat_hash_map.h"
 #include "ecclesia/lib/file/cc_embed_interface.h"
 #include "ecclesia/lib/redfish/dellicius/engine/internal/interface.h"
+#include "ecclesia/lib/redfish/dellicius/engine/query_rules.pb.h"
 
 namespace ecclesia {
 
+// Returns the Redfish query parameters configured by the query rule of a query.
+RedPathRedfishQueryParams ParseQueryRule(
+    const QueryRules::RedPathPrefixSetWithQueryParams
+        &prefix_set_with_query_params);
+
 absl::flat_hash_map<std::string, RedPathRedfishQueryParams>
 ParseQueryRulesFromEmbeddedFiles(
     const std::vector<EmbeddedFile> &embedded_query_rules);
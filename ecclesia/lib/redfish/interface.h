@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -214,8 +215,12 @@ class RedfishVariant final {
   };
 
   // Helper structures used with IndexHelper class
-  // Denote a loop through an iterator.
-  struct IndexEach {};
+  // Denote a loop through an iterator. If prefetch is not 0, the elements are
+  // prefetched with up to that many fetches in flight, see
+  // RedfishIterable::Prefetch.
+  struct IndexEach {
+    size_t prefetch = 0;
+  };
   // Denotes that item is a named element of the redfish schema and should be
   // read using GetArgs parameters
   struct IndexGetWithArgs {
@@ -244,6 +249,13 @@ class RedfishVariant final {
       return *this;
     }
 
+    // Same as Each(), but the elements are prefetched with up to
+    // max_in_flight fetches in flight.
+    IndexHelper EachPrefetched(size_t max_in_flight) {
+      AppendIndex(IndexEach{.prefetch = max_in_flight});
+      return *this;
+    }
+
     IndexHelper Get(std::string index, GetParams args = {}) {
       AppendIndex(IndexGetWithArgs{std::move(index), std::move(args)});
       return *this;
@@ -307,6 +319,11 @@ class RedfishVariant final {
     return IndexHelper(*this, IndexType(IndexEach()));
   }
 
+  IndexHelper EachPrefetched(size_t max_in_flight) const {
+    return IndexHelper(*this,
+                       IndexType(IndexEach{.prefetch = max_in_flight}));
+  }
+
   std::unique_ptr<RedfishObject> AsObject() const {
     if (!ptr_) return nullptr;
     return ptr_->AsObject();
@@ -401,6 +418,20 @@ class RedfishIterable {
   // payload corresponding to that "@odata.id".
   virtual RedfishVariant operator[](int index) const = 0;
 
+  // Starts fetching the payloads of all the elements in the background, in
+  // index order and with at most max_in_flight fetches at a time. Accessing
+  // the elements in order through operator[] then waits for fetches which are
+  // already in flight instead of issuing them one after the other. Each
+  // prefetched payload is only returned once; accessing an element again
+  // fetches it as usual. Implementations which have nothing to fetch ignore
+  // this.
+  virtual void Prefetch(size_t max_in_flight) {}
+
+  // Returns the URI of the element at a given index, or nullopt if it has none.
+  // This resolves the element, so implementations which can read the URI from
+  // the payload of the Collection or Array override it to skip the fetch.
+  virtual std::optional<std::string> GetUriString(int index) const;
+
   class Iterator {
    public:
     using difference_type = size_t;
@@ -514,6 +545,13 @@ class RedfishObject {
                                                RedfishVariant value)>) = 0;
 };
 
+inline std::optional<std::string> RedfishIterable::GetUriString(
+    int index) const {
+  std::unique_ptr<RedfishObject> obj = (*this)[index].AsObject();
+  if (obj == nullptr) return std::nullopt;
+  return obj->GetUriString();
+}
+
 // RedfishInterface provides initial access points to the Redfish resource tree.
 class RedfishInterface {
  public:
@@ -743,6 +781,7 @@ RedfishIterReturnValue RedfishVariant::IndexHelper::Do(
           // then drill down to each of the elements.
           auto iter = root.AsIterable();
           if (!iter) return RedfishIterReturnValue::kContinue;
+          if (index_value.prefetch > 0) iter->Prefetch(index_value.prefetch);
           for (auto entry : *iter) {
             if (Do(entry, rest, what) == RedfishIterReturnValue::kStop) {
               return RedfishIterReturnValue::kStop;
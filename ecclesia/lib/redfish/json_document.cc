@@ -0,0 +1,632 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/json_document.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "ecclesia/lib/status/macros.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+namespace {
+
+// Maximum nesting of arrays and objects, to bound the recursion of the parser.
+constexpr size_t kMaxDepth = 512;
+
+// String sizes and offsets are stored on 31 bits.
+constexpr size_t kMaxTextSize = (size_t{1} << 31) - 1;
+
+// Integers with at most that many digits always fit in an int64_t.
+constexpr size_t kMaxInt64SafeDigits = 18;
+
+// Numbers are validated when parsing, so converting them cannot fail.
+int64_t ToInt64(absl::string_view number) {
+  int64_t value;
+  return absl::SimpleAtoi(number, &value) ? value : 0;
+}
+
+uint64_t ToUint64(absl::string_view number) {
+  uint64_t value;
+  return absl::SimpleAtoi(number, &value) ? value : 0;
+}
+
+double ToDouble(absl::string_view number) {
+  double value;
+  return absl::SimpleAtod(number, &value) ? value : 0;
+}
+
+// Appends the UTF-8 encoding of the given code point.
+void AppendUtf8(uint32_t code_point, std::string *out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Parses the 4 hexadecimal digits of a \uXXXX escape sequence at text[*pos].
+absl::StatusOr<uint32_t> ParseHex4(absl::string_view text, size_t *pos) {
+  if (text.size() - *pos < 4) {
+    return absl::InvalidArgumentError("truncated \\u escape");
+  }
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    char c = text[(*pos)++];
+    value <<= 4;
+    if (c >= '0' && c <= '9') {
+      value |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      value |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      value |= c - 'A' + 10;
+    } else {
+      return absl::InvalidArgumentError("invalid \\u escape");
+    }
+  }
+  return value;
+}
+
+// Parses the XXXX of a \uXXXX escape sequence at text[*pos], and of the low
+// surrogate that must follow it if it is a high surrogate.
+absl::StatusOr<uint32_t> ParseCodePoint(absl::string_view text, size_t *pos) {
+  ECCLESIA_ASSIGN_OR_RETURN(uint32_t code_point, ParseHex4(text, pos));
+  if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+    return absl::InvalidArgumentError("unexpected low surrogate");
+  }
+  if (code_point < 0xD800 || code_point > 0xDBFF) return code_point;
+  if (text.substr(*pos, 2) != "\\u") {
+    return absl::InvalidArgumentError("missing low surrogate");
+  }
+  *pos += 2;
+  ECCLESIA_ASSIGN_OR_RETURN(uint32_t low, ParseHex4(text, pos));
+  if (low < 0xDC00 || low > 0xDFFF) {
+    return absl::InvalidArgumentError("invalid low surrogate");
+  }
+  return 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+}
+
+// Decodes the characters of a string from text[*pos] up to its closing quote,
+// leaving *pos after the quote. They are appended to `out`, or only validated
+// if it is null. On error, *pos is left near the invalid character.
+absl::Status DecodeString(absl::string_view text, size_t *pos,
+                          std::string *out) {
+  while (true) {
+    if (*pos >= text.size()) {
+      return absl::InvalidArgumentError("unterminated string");
+    }
+    char c = text[(*pos)++];
+    if (c == '"') return absl::OkStatus();
+    if (static_cast<unsigned char>(c) < 0x20) {
+      return absl::InvalidArgumentError("control character in string");
+    }
+    if (c != '\\') {
+      if (out != nullptr) out->push_back(c);
+      continue;
+    }
+    if (*pos >= text.size()) {
+      return absl::InvalidArgumentError("unterminated string");
+    }
+    switch (c = text[(*pos)++]) {
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u': {
+        ECCLESIA_ASSIGN_OR_RETURN(uint32_t code_point,
+                                  ParseCodePoint(text, pos));
+        if (out != nullptr) AppendUtf8(code_point, out);
+        continue;
+      }
+      default:
+        return absl::InvalidArgumentError("invalid escape sequence");
+    }
+    if (out != nullptr) out->push_back(c);
+  }
+}
+
+// The parser scans strings and whitespace a word at a time rather than a byte
+// at a time, testing all the bytes of a word at once with bitwise arithmetic.
+// This is the portable equivalent of the SIMD scans of parsers like simdjson,
+// and avoids depending on the instruction sets of the target.
+using Word = uint64_t;
+
+constexpr Word kOnes = ~Word{0} / 0xFF;
+constexpr Word kHighBits = kOnes * 0x80;
+
+Word LoadWord(const char *data) {
+  Word word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+// Returns a non-zero value iff one of the bytes of the word is lower than n,
+// which must be at most 0x80.
+constexpr Word HasByteLessThan(Word word, uint8_t n) {
+  return (word - kOnes * n) & ~word & kHighBits;
+}
+
+// Returns a non-zero value iff one of the bytes of the word is equal to c.
+constexpr Word HasByte(Word word, char c) {
+  return HasByteLessThan(word ^ (kOnes * static_cast<uint8_t>(c)), 1);
+}
+
+// Returns whether any byte of the word ends the plain part of a string: a
+// quote, a backslash or a control character.
+constexpr bool HasStringSpecialByte(Word word) {
+  return (HasByte(word, '"') | HasByte(word, '\\') |
+          HasByteLessThan(word, 0x20)) != 0;
+}
+
+static_assert(!HasStringSpecialByte(0x6867666564636261));  // "abcdefgh"
+static_assert(HasStringSpecialByte(0x6867666522636261));   // "abc\"efgh"
+static_assert(HasStringSpecialByte(0x68676665645C6261));   // "ab\\defgh"
+static_assert(HasStringSpecialByte(0x0A67666564636261));   // "abcdefg\n"
+static_assert(!HasStringSpecialByte(0xAC82E22164636261));  // "abcd!€"
+
+}  // namespace
+
+// Recursive descent parser filling the buffers of a JsonDocument. Children of
+// arrays and objects are collected on scratch stacks while their container is
+// being parsed and moved to the document once it is closed, which keeps the
+// children of every container contiguous.
+class JsonDocument::Parser {
+ public:
+  explicit Parser(JsonDocument *doc) : doc_(*doc), text_(doc->text_) {}
+
+  absl::Status Parse() {
+    SkipWhitespace();
+    ECCLESIA_RETURN_IF_ERROR(ParseValue(0).status());
+    SkipWhitespace();
+    if (pos_ != text_.size()) return Error("unexpected trailing characters");
+    return absl::OkStatus();
+  }
+
+ private:
+  absl::Status Error(absl::string_view what) const {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Invalid JSON at offset %d: %s", pos_, what));
+  }
+
+  void SkipWhitespace() {
+    // Pretty printed payloads indent with runs of spaces, which are skipped a
+    // word at a time.
+    constexpr Word kSpaces = kOnes * ' ';
+    while (pos_ < text_.size()) {
+      if (text_.size() - pos_ >= sizeof(Word) &&
+          LoadWord(text_.data() + pos_) == kSpaces) {
+        pos_ += sizeof(Word);
+        continue;
+      }
+      char c = text_[pos_];
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+      ++pos_;
+    }
+  }
+
+  bool Consume(char c) {
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t NewNode(Type type) {
+    Node node{};
+    node.type = type;
+    doc_.nodes_.push_back(node);
+    return static_cast<uint32_t>(doc_.nodes_.size() - 1);
+  }
+
+  // Parses a value into a new node and returns the index of that node.
+  absl::StatusOr<uint32_t> ParseValue(size_t depth) {
+    if (pos_ >= text_.size()) return Error("unexpected end of text");
+    switch (text_[pos_]) {
+      case '{':
+        return ParseObject(depth);
+      case '[':
+        return ParseArray(depth);
+      case '"': {
+        uint32_t index = NewNode(Type::kString);
+        bool escaped;
+        ECCLESIA_ASSIGN_OR_RETURN(StringRef string, ParseString(&escaped));
+        Node &node = doc_.nodes_[index];
+        node.string = string;
+        node.escaped = escaped;
+        return index;
+      }
+      case 't':
+        return ParseLiteral("true", Type::kBool, true);
+      case 'f':
+        return ParseLiteral("false", Type::kBool, false);
+      case 'n':
+        return ParseLiteral("null", Type::kNull, false);
+      default:
+        return ParseNumber();
+    }
+  }
+
+  absl::StatusOr<uint32_t> ParseLiteral(absl::string_view literal, Type type,
+                                        bool value) {
+    if (text_.substr(pos_, literal.size()) != literal) {
+      return Error("invalid literal");
+    }
+    pos_ += literal.size();
+    uint32_t index = NewNode(type);
+    doc_.nodes_[index].boolean = value;
+    return index;
+  }
+
+  absl::StatusOr<uint32_t> ParseNumber() {
+    size_t start = pos_;
+    bool is_float = false;
+    Consume('-');
+    if (Consume('0')) {
+      // No leading zeros.
+    } else if (!ConsumeDigits()) {
+      return Error("invalid value");
+    }
+    if (Consume('.')) {
+      is_float = true;
+      if (!ConsumeDigits()) return Error("invalid number fraction");
+    }
+    if (Consume('e') || Consume('E')) {
+      is_float = true;
+      if (!Consume('+')) Consume('-');
+      if (!ConsumeDigits()) return Error("invalid number exponent");
+    }
+    absl::string_view number = text_.substr(start, pos_ - start);
+
+    // The number is only converted when read, but its type is needed now.
+    // Only integers too long to surely fit in an int64_t are converted to find
+    // it. As nlohmann::json, integers which do not fit in 64 bits are stored
+    // as floating point numbers.
+    Type type = Type::kDouble;
+    if (!is_float) {
+      size_t digits = number.size() - (number[0] == '-' ? 1 : 0);
+      if (int64_t value;
+          digits <= kMaxInt64SafeDigits || absl::SimpleAtoi(number, &value)) {
+        type = Type::kInt;
+      } else if (uint64_t value;
+                 number[0] != '-' && absl::SimpleAtoi(number, &value)) {
+        type = Type::kUint;
+      }
+    }
+    uint32_t index = NewNode(type);
+    doc_.nodes_[index].string =
+        StringRef{.offset = static_cast<uint32_t>(start),
+                  .size = static_cast<uint32_t>(number.size()),
+                  .unescaped = 0};
+    return index;
+  }
+
+  bool ConsumeDigits() {
+    size_t start = pos_;
+    while (pos_ < text_.size() && absl::ascii_isdigit(text_[pos_])) ++pos_;
+    return pos_ != start;
+  }
+
+  // Parses a string starting at the opening quote. Strings without escape
+  // sequences refer to the text of the document. If `escaped` is null, others
+  // are unescaped into the unescaped_ buffer. Otherwise, they are only
+  // validated and refer to their escaped text, to be decoded when read, and
+  // *escaped tells whether the string had escape sequences.
+  absl::StatusOr<StringRef> ParseString(bool *escaped) {
+    size_t start = ++pos_;
+    while (text_.size() - pos_ >= sizeof(Word) &&
+           !HasStringSpecialByte(LoadWord(text_.data() + pos_))) {
+      pos_ += sizeof(Word);
+    }
+    while (pos_ < text_.size() && text_[pos_] != '"' && text_[pos_] != '\\') {
+      if (static_cast<unsigned char>(text_[pos_]) < 0x20) {
+        return Error("control character in string");
+      }
+      ++pos_;
+    }
+    if (pos_ >= text_.size()) return Error("unterminated string");
+    if (escaped != nullptr) *escaped = text_[pos_] != '"';
+    if (text_[pos_] == '"') {
+      ++pos_;
+      return StringRef{.offset = static_cast<uint32_t>(start),
+                       .size = static_cast<uint32_t>(pos_ - 1 - start),
+                       .unescaped = 0};
+    }
+
+    if (escaped != nullptr) {
+      if (absl::Status status = DecodeString(text_, &pos_, nullptr);
+          !status.ok()) {
+        return Error(status.message());
+      }
+      return StringRef{.offset = static_cast<uint32_t>(start),
+                       .size = static_cast<uint32_t>(pos_ - 1 - start),
+                       .unescaped = 0};
+    }
+    std::string &out = doc_.unescaped_;
+    size_t offset = out.size();
+    out.append(text_.data() + start, pos_ - start);
+    if (absl::Status status = DecodeString(text_, &pos_, &out); !status.ok()) {
+      return Error(status.message());
+    }
+    return StringRef{.offset = static_cast<uint32_t>(offset),
+                     .size = static_cast<uint32_t>(out.size() - offset),
+                     .unescaped = 1};
+  }
+
+  absl::StatusOr<uint32_t> ParseArray(size_t depth) {
+    if (depth >= kMaxDepth) return Error("nesting too deep");
+    ++pos_;
+    uint32_t index = NewNode(Type::kArray);
+    size_t scratch_start = element_scratch_.size();
+    SkipWhitespace();
+    if (!Consume(']')) {
+      while (true) {
+        ECCLESIA_ASSIGN_OR_RETURN(uint32_t element, ParseValue(depth + 1));
+        element_scratch_.push_back(element);
+        SkipWhitespace();
+        if (Consume(']')) break;
+        if (!Consume(',')) return Error("expected ',' or ']'");
+        SkipWhitespace();
+      }
+    }
+    Node &node = doc_.nodes_[index];
+    node.first = static_cast<uint32_t>(doc_.elements_.size());
+    node.size = static_cast<uint32_t>(element_scratch_.size() - scratch_start);
+    doc_.elements_.insert(doc_.elements_.end(),
+                          element_scratch_.begin() + scratch_start,
+                          element_scratch_.end());
+    element_scratch_.resize(scratch_start);
+    return index;
+  }
+
+  absl::StatusOr<uint32_t> ParseObject(size_t depth) {
+    if (depth >= kMaxDepth) return Error("nesting too deep");
+    ++pos_;
+    uint32_t index = NewNode(Type::kObject);
+    size_t scratch_start = member_scratch_.size();
+    SkipWhitespace();
+    if (!Consume('}')) {
+      while (true) {
+        if (pos_ >= text_.size() || text_[pos_] != '"') {
+          return Error("expected object key");
+        }
+        ECCLESIA_ASSIGN_OR_RETURN(StringRef key, ParseString(nullptr));
+        SkipWhitespace();
+        if (!Consume(':')) return Error("expected ':'");
+        SkipWhitespace();
+        ECCLESIA_ASSIGN_OR_RETURN(uint32_t value, ParseValue(depth + 1));
+        member_scratch_.push_back(Member{.key = key, .value = value});
+        SkipWhitespace();
+        if (Consume('}')) break;
+        if (!Consume(',')) return Error("expected ',' or '}'");
+        SkipWhitespace();
+      }
+    }
+
+    // Sort the members by key. The sort is stable so that the last of
+    // repeated keys can be kept, as nlohmann::json does.
+    auto begin = member_scratch_.begin() + scratch_start;
+    auto end = member_scratch_.end();
+    std::stable_sort(begin, end, [this](const Member &a, const Member &b) {
+      return doc_.GetString(a.key) < doc_.GetString(b.key);
+    });
+    Node &node = doc_.nodes_[index];
+    node.first = static_cast<uint32_t>(doc_.members_.size());
+    for (auto it = begin; it != end; ++it) {
+      if (std::next(it) != end &&
+          doc_.GetString(it->key) == doc_.GetString(std::next(it)->key)) {
+        continue;
+      }
+      doc_.members_.push_back(*it);
+    }
+    node.size = static_cast<uint32_t>(doc_.members_.size() - node.first);
+    member_scratch_.resize(scratch_start);
+    return index;
+  }
+
+  JsonDocument &doc_;
+  absl::string_view text_;
+  size_t pos_ = 0;
+  std::vector<uint32_t> element_scratch_;
+  std::vector<Member> member_scratch_;
+};
+
+absl::StatusOr<std::unique_ptr<JsonDocument>> JsonDocument::Parse(
+    std::string text) {
+  auto owned_text = std::make_shared<const std::string>(std::move(text));
+  absl::string_view view = *owned_text;
+  return Parse(view, std::move(owned_text));
+}
+
+absl::StatusOr<std::unique_ptr<JsonDocument>> JsonDocument::Parse(
+    absl::string_view text, std::shared_ptr<const void> owner) {
+  if (text.size() > kMaxTextSize) {
+    return absl::InvalidArgumentError("JSON text is too large");
+  }
+  std::unique_ptr<JsonDocument> doc(new JsonDocument(text, std::move(owner)));
+  ECCLESIA_RETURN_IF_ERROR(Parser(doc.get()).Parse());
+  // Documents usually outlive their parsing by far, e.g. in a cache, so give
+  // back the unused capacity of the buffers.
+  doc->unescaped_.shrink_to_fit();
+  doc->nodes_.shrink_to_fit();
+  doc->elements_.shrink_to_fit();
+  doc->members_.shrink_to_fit();
+  return doc;
+}
+
+size_t JsonDocument::SizeBytes() const {
+  size_t size = sizeof(*this) + unescaped_.capacity() +
+                nodes_.capacity() * sizeof(Node) +
+                elements_.capacity() * sizeof(uint32_t) +
+                members_.capacity() * sizeof(Member);
+  absl::MutexLock lock(&unescaped_values_mutex_);
+  for (const auto &[index, value] : unescaped_values_) {
+    size += sizeof(index) + sizeof(value) + value.capacity();
+  }
+  return size;
+}
+
+absl::string_view JsonDocument::GetUnescapedValue(uint32_t index) const {
+  absl::MutexLock lock(&unescaped_values_mutex_);
+  auto [it, inserted] = unescaped_values_.try_emplace(index);
+  if (inserted) {
+    size_t pos = nodes_[index].string.offset;
+    // The string was validated when parsing, so this cannot fail.
+    DecodeString(text_, &pos, &it->second).IgnoreError();
+  }
+  return it->second;
+}
+
+std::optional<bool> JsonDocument::Value::AsBool() const {
+  if (!is_bool()) return std::nullopt;
+  return node().boolean;
+}
+
+std::optional<int64_t> JsonDocument::Value::AsInt64() const {
+  switch (type()) {
+    case Type::kInt:
+      return ToInt64(doc_->GetString(node().string));
+    case Type::kUint:
+      return static_cast<int64_t>(ToUint64(doc_->GetString(node().string)));
+    default:
+      return std::nullopt;
+  }
+}
+
+std::optional<double> JsonDocument::Value::AsDouble() const {
+  switch (type()) {
+    case Type::kInt:
+      return static_cast<double>(ToInt64(doc_->GetString(node().string)));
+    case Type::kUint:
+      return static_cast<double>(ToUint64(doc_->GetString(node().string)));
+    case Type::kDouble:
+      return ToDouble(doc_->GetString(node().string));
+    default:
+      return std::nullopt;
+  }
+}
+
+std::optional<absl::string_view> JsonDocument::Value::AsString() const {
+  if (!is_string()) return std::nullopt;
+  if (node().escaped) return doc_->GetUnescapedValue(index_);
+  return doc_->GetString(node().string);
+}
+
+size_t JsonDocument::Value::size() const {
+  return is_array() || is_object() ? node().size : 0;
+}
+
+std::optional<JsonDocument::Value> JsonDocument::Value::At(
+    size_t index) const {
+  if (!is_array() || index >= node().size) return std::nullopt;
+  return Value(doc_, doc_->elements_[node().first + index]);
+}
+
+std::optional<JsonDocument::Value> JsonDocument::Value::Find(
+    absl::string_view key) const {
+  if (!is_object()) return std::nullopt;
+  auto begin = doc_->members_.begin() + node().first;
+  auto end = begin + node().size;
+  auto it = std::lower_bound(begin, end, key,
+                             [this](const Member &member, absl::string_view k) {
+                               return doc_->GetString(member.key) < k;
+                             });
+  if (it == end || doc_->GetString(it->key) != key) return std::nullopt;
+  return Value(doc_, it->value);
+}
+
+absl::string_view JsonDocument::Value::MemberKey(size_t index) const {
+  return doc_->GetString(doc_->members_[node().first + index].key);
+}
+
+JsonDocument::Value JsonDocument::Value::MemberValue(size_t index) const {
+  return Value(doc_, doc_->members_[node().first + index].value);
+}
+
+nlohmann::json JsonDocument::Value::ToJson() const {
+  switch (type()) {
+    case Type::kNull:
+      return nullptr;
+    case Type::kBool:
+      return node().boolean;
+    case Type::kInt:
+      return *AsInt64();
+    case Type::kUint:
+      return ToUint64(doc_->GetString(node().string));
+    case Type::kDouble:
+      return *AsDouble();
+    case Type::kString:
+      return std::string(*AsString());
+    case Type::kArray: {
+      nlohmann::json json = nlohmann::json::array();
+      for (size_t i = 0; i < node().size; ++i) {
+        json.push_back(Value(doc_, doc_->elements_[node().first + i]).ToJson());
+      }
+      return json;
+    }
+    case Type::kObject: {
+      nlohmann::json json = nlohmann::json::object();
+      for (size_t i = 0; i < node().size; ++i) {
+        json[std::string(MemberKey(i))] = MemberValue(i).ToJson();
+      }
+      return json;
+    }
+  }
+  return nlohmann::json::value_t::discarded;
+}
+
+}  // namespace ecclesia
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ECCLESIA_LIB_REDFISH_JSON_DOCUMENT_H_
+#define ECCLESIA_LIB_REDFISH_JSON_DOCUMENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+
+// JsonDocument is an immutable, compact representation of a parsed JSON text.
+//
+// Unlike nlohmann::json, which allocates every object, key and string on its
+// own, a JsonDocument keeps the whole document in a few contiguous buffers:
+//   * the original text, which numbers and strings refer to. It can be
+//     borrowed from its owner, such as a cached response, instead of copied;
+//   * a buffer holding the few keys that had to be unescaped;
+//   * a vector of fixed size nodes;
+//   * vectors of array elements and object members. The members of each
+//     object are sorted by key so lookups are binary searches.
+// Parsing only grows these few buffers, whatever the shape of the document,
+// and destroying the document frees everything at once.
+//
+// Values are decoded on demand: parsing only validates numbers and string
+// values with escape sequences, which are converted when they are read. As
+// most readers only look at a few properties of a Redfish payload, most of
+// them are never decoded. Unescaped string values are kept for later reads.
+// Arrays and objects are still indexed when parsing, so that a document
+// shared between threads is never restructured by its readers.
+//
+// As with nlohmann::json, members of an object are iterated in key order and
+// the last one wins if a key is repeated.
+class JsonDocument {
+ public:
+  enum class Type : uint8_t {
+    kNull,
+    kBool,
+    // A number without fraction or exponent that fits in an int64_t.
+    kInt,
+    // A number without fraction or exponent that only fits in an uint64_t.
+    kUint,
+    kDouble,
+    kString,
+    kArray,
+    kObject,
+  };
+
+ private:
+  struct Node;
+
+ public:
+  // A lightweight handle on a value within a document. Values are only valid
+  // as long as the document they were obtained from.
+  class Value {
+   public:
+    Type type() const { return node().type; }
+    bool is_null() const { return type() == Type::kNull; }
+    bool is_bool() const { return type() == Type::kBool; }
+    bool is_number() const {
+      return type() == Type::kInt || type() == Type::kUint ||
+             type() == Type::kDouble;
+    }
+    bool is_integer() const {
+      return type() == Type::kInt || type() == Type::kUint;
+    }
+    bool is_string() const { return type() == Type::kString; }
+    bool is_array() const { return type() == Type::kArray; }
+    bool is_object() const { return type() == Type::kObject; }
+
+    // Typed accessors, converting the value from the text of the document.
+    // They return std::nullopt if the value does not have a matching type.
+    // Integers are converted the same way as nlohmann::json::get<T>() would.
+    std::optional<bool> AsBool() const;
+    std::optional<int64_t> AsInt64() const;
+    std::optional<double> AsDouble() const;
+    // The returned view is valid as long as the document.
+    std::optional<absl::string_view> AsString() const;
+
+    // Number of elements of an array or members of an object, 0 otherwise.
+    size_t size() const;
+
+    // Returns the array element at the given index, std::nullopt if this is
+    // not an array or the index is out of range.
+    std::optional<Value> At(size_t index) const;
+
+    // Returns the member with the given key, std::nullopt if this is not an
+    // object or it has no such member.
+    std::optional<Value> Find(absl::string_view key) const;
+
+    // Returns the key and the value of the index-th member of an object, in
+    // key order. The index must be lower than size().
+    absl::string_view MemberKey(size_t index) const;
+    Value MemberValue(size_t index) const;
+
+    // Converts the value, including all its children, into an
+    // nlohmann::json.
+    nlohmann::json ToJson() const;
+
+   private:
+    friend class JsonDocument;
+    Value(const JsonDocument *doc, uint32_t index) : doc_(doc), index_(index) {}
+
+    const Node &node() const { return doc_->nodes_[index_]; }
+
+    const JsonDocument *doc_;
+    uint32_t index_;
+  };
+
+  // Parses the given JSON text. Returns InvalidArgument if the text is not
+  // valid JSON or is larger than 2GiB.
+  static absl::StatusOr<std::unique_ptr<JsonDocument>> Parse(std::string text);
+  // Same as above for a text held by `owner`, e.g. a cached response. The
+  // document refers to the text instead of copying it, and keeps `owner` alive
+  // for as long as it is.
+  static absl::StatusOr<std::unique_ptr<JsonDocument>> Parse(
+      absl::string_view text, std::shared_ptr<const void> owner);
+
+  JsonDocument(const JsonDocument &) = delete;
+  JsonDocument &operator=(const JsonDocument &) = delete;
+
+  Value root() const { return Value(this, 0); }
+
+  // The text the document was parsed from.
+  absl::string_view text() const { return text_; }
+
+  // Approximate number of bytes used by the document, excluding its text which
+  // may be shared with the owner of the text.
+  size_t SizeBytes() const;
+
+ private:
+  // A string or a number stored either in text_ or, for keys which had escape
+  // sequences, in unescaped_.
+  struct StringRef {
+    uint32_t offset;
+    uint32_t size : 31;
+    uint32_t unescaped : 1;
+  };
+
+  struct Node {
+    Type type;
+    // For strings, whether `string` is escaped text to decode when read.
+    bool escaped;
+    // Number of children for arrays and objects.
+    uint32_t size;
+    union {
+      bool boolean;
+      // The text of a number or a string.
+      StringRef string;
+      // Index of the first child in elements_ or members_.
+      uint32_t first;
+    };
+  };
+
+  struct Member {
+    StringRef key;
+    uint32_t value;
+  };
+
+  class Parser;
+
+  JsonDocument(absl::string_view text, std::shared_ptr<const void> text_owner)
+      : text_owner_(std::move(text_owner)), text_(text) {}
+
+  absl::string_view GetString(StringRef ref) const {
+    absl::string_view buffer = ref.unescaped ? unescaped_ : text_;
+    return buffer.substr(ref.offset, ref.size);
+  }
+
+  // Returns the string value of the node at `index`, which had escape
+  // sequences, decoding it on first use.
+  absl::string_view GetUnescapedValue(uint32_t index) const
+      ABSL_LOCKS_EXCLUDED(unescaped_values_mutex_);
+
+  // Keeps text_ alive.
+  std::shared_ptr<const void> text_owner_;
+  absl::string_view text_;
+  std::string unescaped_;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> elements_;
+  std::vector<Member> members_;
+  // String values decoded so far, by node index. The map is node based so that
+  // views of the values stay valid as it grows.
+  mutable absl::Mutex unescaped_values_mutex_;
+  mutable absl::node_hash_map<uint32_t, std::string> unescaped_values_
+      ABSL_GUARDED_BY(unescaped_values_mutex_);
+};
+
+}  // namespace ecclesia
+
+#endif  // ECCLESIA_LIB_REDFISH_JSON_DOCUMENT_H_
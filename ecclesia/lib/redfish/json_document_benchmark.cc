@@ -0,0 +1,148 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "ecclesia/lib/file/dir.h"
+#include "ecclesia/lib/file/path.h"
+#include "ecclesia/lib/redfish/json_document.h"
+#include "single_include/nlohmann/json.hpp"
+
+// These benchmarks compare the parsers available to RedfishInterface on the
+// payloads of a Redfish mockup tree, e.g. one of ecclesia/redfish_mockups.
+// Throughput is reported in bytes of JSON text per second.
+ABSL_FLAG(std::string, redfish_mockup_dir_for_benchmark, "",
+          "The directory of the Redfish mockup whose JSON files are parsed");
+
+namespace ecclesia {
+namespace {
+
+// Appends the content of all the JSON files under dirname which nlohmann::json
+// can parse. Some mockups contain empty files, which are skipped.
+void ReadJsonFiles(const std::string &dirname,
+                   std::vector<std::string> *payloads) {
+  CHECK_OK(WithEachFileInDirectory(dirname, [&](absl::string_view entry) {
+    std::string path = JoinFilePaths(dirname, entry);
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return;
+    if (S_ISDIR(st.st_mode)) {
+      ReadJsonFiles(path, payloads);
+      return;
+    }
+    if (!absl::EndsWith(entry, ".json")) return;
+    std::ifstream file(path);
+    std::string payload((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    if (nlohmann::json::accept(payload)) payloads->push_back(payload);
+  }));
+}
+
+const std::vector<std::string> &GetPayloads() {
+  static const std::vector<std::string> *const payloads = [] {
+    std::string dirname = absl::GetFlag(FLAGS_redfish_mockup_dir_for_benchmark);
+    CHECK(!dirname.empty()) << "--redfish_mockup_dir_for_benchmark is not set";
+    auto *payloads = new std::vector<std::string>();
+    ReadJsonFiles(dirname, payloads);
+    CHECK(!payloads->empty()) << "no JSON files found under " << dirname;
+    return payloads;
+  }();
+  return *payloads;
+}
+
+void SetBytesProcessed(benchmark::State &state) {
+  size_t bytes = 0;
+  for (const std::string &payload : GetPayloads()) bytes += payload.size();
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+void BM_ParseNlohmannJson(benchmark::State &state) {
+  const std::vector<std::string> &payloads = GetPayloads();
+  for (auto s : state) {
+    for (const std::string &payload : payloads) {
+      benchmark::DoNotOptimize(nlohmann::json::parse(payload, nullptr, false));
+    }
+  }
+  SetBytesProcessed(state);
+}
+
+void BM_ParseJsonDocument(benchmark::State &state) {
+  const std::vector<std::string> &payloads = GetPayloads();
+  for (auto s : state) {
+    for (const std::string &payload : payloads) {
+      benchmark::DoNotOptimize(JsonDocument::Parse(payload));
+    }
+  }
+  SetBytesProcessed(state);
+}
+
+// The following benchmarks parse each payload and then read a few properties
+// of it, as most readers of Redfish resources do.
+void BM_ReadPropertiesNlohmannJson(benchmark::State &state) {
+  const std::vector<std::string> &payloads = GetPayloads();
+  for (auto s : state) {
+    for (const std::string &payload : payloads) {
+      nlohmann::json json = nlohmann::json::parse(payload, nullptr, false);
+      if (!json.is_object()) continue;
+      benchmark::DoNotOptimize(json.find("Name"));
+      if (auto status = json.find("Status");
+          status != json.end() && status->is_object()) {
+        benchmark::DoNotOptimize(status->find("Health"));
+      }
+    }
+  }
+  SetBytesProcessed(state);
+}
+
+void BM_ReadPropertiesJsonDocument(benchmark::State &state) {
+  const std::vector<std::string> &payloads = GetPayloads();
+  for (auto s : state) {
+    for (const std::string &payload : payloads) {
+      absl::StatusOr<std::unique_ptr<JsonDocument>> doc =
+          JsonDocument::Parse(payload);
+      if (!doc.ok()) continue;
+      JsonDocument::Value root = (*doc)->root();
+      benchmark::DoNotOptimize(root.Find("Name"));
+      if (std::optional<JsonDocument::Value> status = root.Find("Status");
+          status.has_value()) {
+        benchmark::DoNotOptimize(status->Find("Health"));
+      }
+    }
+  }
+  SetBytesProcessed(state);
+}
+
+BENCHMARK(BM_ParseNlohmannJson);
+BENCHMARK(BM_ParseJsonDocument);
+BENCHMARK(BM_ReadPropertiesNlohmannJson);
+BENCHMARK(BM_ReadPropertiesJsonDocument);
+
+}  // namespace
+}  // namespace ecclesia
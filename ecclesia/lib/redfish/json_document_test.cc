@@ -0,0 +1,234 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/json_document.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Optional;
+
+constexpr absl::string_view kChassis = R"json({
+  "@odata.id": "/redfish/v1/Chassis/chassis",
+  "Name": "chassis",
+  "Status": {"State": "Enabled", "Health": "OK"},
+  "Temperatures": [
+    {"ReadingCelsius": 37, "UpperThresholdCritical": 85.5},
+    {"ReadingCelsius": -4, "UpperThresholdCritical": null}
+  ],
+  "PowerOn": true,
+  "Serial": "SN\u00e9\n\ud83d\ude00"
+})json";
+
+std::unique_ptr<JsonDocument> ParseOrDie(absl::string_view text) {
+  absl::StatusOr<std::unique_ptr<JsonDocument>> doc =
+      JsonDocument::Parse(std::string(text));
+  EXPECT_TRUE(doc.ok()) << doc.status();
+  return doc.ok() ? *std::move(doc) : nullptr;
+}
+
+TEST(JsonDocumentTest, NavigatesObjectsAndArrays) {
+  std::unique_ptr<JsonDocument> doc = ParseOrDie(kChassis);
+  ASSERT_NE(doc, nullptr);
+  JsonDocument::Value root = doc->root();
+  ASSERT_TRUE(root.is_object());
+  EXPECT_THAT(root.size(), Eq(6));
+
+  std::optional<JsonDocument::Value> name = root.Find("Name");
+  ASSERT_TRUE(name.has_value());
+  EXPECT_THAT(name->AsString(), Optional(Eq("chassis")));
+
+  std::optional<JsonDocument::Value> state = root.Find("Status");
+  ASSERT_TRUE(state.has_value());
+  EXPECT_THAT(state->Find("State")->AsString(), Optional(Eq("Enabled")));
+  EXPECT_FALSE(state->Find("Missing").has_value());
+
+  std::optional<JsonDocument::Value> temperatures = root.Find("Temperatures");
+  ASSERT_TRUE(temperatures.has_value());
+  ASSERT_TRUE(temperatures->is_array());
+  EXPECT_THAT(temperatures->size(), Eq(2));
+  EXPECT_THAT(temperatures->At(0)->Find("ReadingCelsius")->AsInt64(),
+              Optional(Eq(37)));
+  EXPECT_THAT(temperatures->At(1)->Find("ReadingCelsius")->AsInt64(),
+              Optional(Eq(-4)));
+  EXPECT_THAT(temperatures->At(0)->Find("UpperThresholdCritical")->AsDouble(),
+              Optional(Eq(85.5)));
+  EXPECT_TRUE(temperatures->At(1)->Find("UpperThresholdCritical")->is_null());
+  EXPECT_FALSE(temperatures->At(2).has_value());
+
+  EXPECT_THAT(root.Find("PowerOn")->AsBool(), Optional(Eq(true)));
+  EXPECT_THAT(root.Find("PowerOn")->AsString(), Eq(std::nullopt));
+}
+
+TEST(JsonDocumentTest, MembersAreIteratedInKeyOrder) {
+  std::unique_ptr<JsonDocument> doc =
+      ParseOrDie(R"json({"b": 1, "c": 3, "a": 2})json");
+  ASSERT_NE(doc, nullptr);
+  JsonDocument::Value root = doc->root();
+  ASSERT_THAT(root.size(), Eq(3));
+  EXPECT_THAT(root.MemberKey(0), Eq("a"));
+  EXPECT_THAT(root.MemberValue(0).AsInt64(), Optional(Eq(2)));
+  EXPECT_THAT(root.MemberKey(1), Eq("b"));
+  EXPECT_THAT(root.MemberValue(1).AsInt64(), Optional(Eq(1)));
+  EXPECT_THAT(root.MemberKey(2), Eq("c"));
+  EXPECT_THAT(root.MemberValue(2).AsInt64(), Optional(Eq(3)));
+}
+
+TEST(JsonDocumentTest, LastRepeatedKeyWins) {
+  std::unique_ptr<JsonDocument> doc =
+      ParseOrDie(R"json({"a": 1, "b": 2, "a": 3})json");
+  ASSERT_NE(doc, nullptr);
+  EXPECT_THAT(doc->root().size(), Eq(2));
+  EXPECT_THAT(doc->root().Find("a")->AsInt64(), Optional(Eq(3)));
+  EXPECT_THAT(doc->root().MemberKey(0), Eq("a"));
+  EXPECT_THAT(doc->root().MemberKey(1), Eq("b"));
+}
+
+TEST(JsonDocumentTest, FindsMembersOfLargeObjects) {
+  std::string text = "{";
+  for (int i = 0; i < 1000; ++i) {
+    absl::StrAppend(&text, i == 0 ? "" : ",", "\"key", i, "\": ", i);
+  }
+  // Repeat a few keys, which must keep their last value.
+  absl::StrAppend(&text, ", \"key7\": -7, \"key999\": -999}");
+  std::unique_ptr<JsonDocument> doc = ParseOrDie(text);
+  ASSERT_NE(doc, nullptr);
+  JsonDocument::Value root = doc->root();
+  EXPECT_THAT(root.size(), Eq(1000));
+  for (int i = 0; i < 1000; ++i) {
+    int64_t expected = i == 7 || i == 999 ? -i : i;
+    EXPECT_THAT(root.Find(absl::StrCat("key", i))->AsInt64(),
+                Optional(Eq(expected)));
+  }
+  EXPECT_FALSE(root.Find("key1000").has_value());
+}
+
+TEST(JsonDocumentTest, UnescapesStrings) {
+  std::unique_ptr<JsonDocument> doc =
+      ParseOrDie(R"json({"a\"b": "\\\/\b\f\n\r\t\u0041"})json");
+  ASSERT_NE(doc, nullptr);
+  EXPECT_THAT(doc->root().Find("a\"b")->AsString(),
+              Optional(Eq("\\/\b\f\n\r\tA")));
+}
+
+TEST(JsonDocumentTest, UnescapesStringsWhenRead) {
+  constexpr absl::string_view kText = R"json(["a\nb", "c\u00e9", "plain"])json";
+  std::unique_ptr<JsonDocument> doc = ParseOrDie(kText);
+  ASSERT_NE(doc, nullptr);
+  std::optional<absl::string_view> first = doc->root().At(0)->AsString();
+  ASSERT_THAT(first, Optional(Eq("a\nb")));
+  EXPECT_THAT(doc->root().At(1)->AsString(), Optional(Eq("c\u00e9")));
+  // Later reads return the value decoded on the first one.
+  EXPECT_THAT(doc->root().At(0)->AsString()->data(), Eq(first->data()));
+  EXPECT_THAT(doc->root().At(2)->AsString(), Optional(Eq("plain")));
+  EXPECT_THAT(doc->root().ToJson(), Eq(nlohmann::json::parse(kText)));
+}
+
+TEST(JsonDocumentTest, StoresLargeIntegers) {
+  std::unique_ptr<JsonDocument> doc =
+      ParseOrDie("[9223372036854775807, 18446744073709551615, "
+                 "18446744073709551616, -9223372036854775808]");
+  ASSERT_NE(doc, nullptr);
+  JsonDocument::Value root = doc->root();
+  EXPECT_THAT(root.At(0)->type(), Eq(JsonDocument::Type::kInt));
+  EXPECT_THAT(root.At(0)->AsInt64(),
+              Optional(Eq(std::numeric_limits<int64_t>::max())));
+  EXPECT_THAT(root.At(1)->type(), Eq(JsonDocument::Type::kUint));
+  EXPECT_THAT(root.At(2)->type(), Eq(JsonDocument::Type::kDouble));
+  EXPECT_THAT(root.At(3)->AsInt64(),
+              Optional(Eq(std::numeric_limits<int64_t>::min())));
+}
+
+TEST(JsonDocumentTest, ConvertsNumbersWhenRead) {
+  std::unique_ptr<JsonDocument> doc =
+      ParseOrDie("[-0, 1.5e3, -2.25, 12345678901234567890123, 1E-2]");
+  ASSERT_NE(doc, nullptr);
+  JsonDocument::Value root = doc->root();
+  EXPECT_THAT(root.At(0)->AsInt64(), Optional(Eq(0)));
+  EXPECT_THAT(root.At(1)->type(), Eq(JsonDocument::Type::kDouble));
+  EXPECT_THAT(root.At(1)->AsDouble(), Optional(Eq(1500.0)));
+  EXPECT_THAT(root.At(1)->AsInt64(), Eq(std::nullopt));
+  EXPECT_THAT(root.At(2)->AsDouble(), Optional(Eq(-2.25)));
+  EXPECT_THAT(root.At(3)->type(), Eq(JsonDocument::Type::kDouble));
+  EXPECT_THAT(root.At(3)->AsDouble(), Optional(Eq(1.2345678901234568e22)));
+  EXPECT_THAT(root.At(4)->AsDouble(), Optional(Eq(0.01)));
+}
+
+TEST(JsonDocumentTest, ConvertsToNlohmannJson) {
+  std::unique_ptr<JsonDocument> doc = ParseOrDie(kChassis);
+  ASSERT_NE(doc, nullptr);
+  EXPECT_THAT(doc->root().ToJson(), Eq(nlohmann::json::parse(kChassis)));
+  EXPECT_THAT(doc->root().Find("Status")->ToJson(),
+              Eq(nlohmann::json::parse(R"json({
+                "State": "Enabled", "Health": "OK"
+              })json")));
+}
+
+TEST(JsonDocumentTest, BorrowsTextFromItsOwner) {
+  auto text = std::make_shared<const std::string>(kChassis);
+  absl::StatusOr<std::unique_ptr<JsonDocument>> doc =
+      JsonDocument::Parse(*text, text);
+  ASSERT_TRUE(doc.ok()) << doc.status();
+  EXPECT_THAT((*doc)->text().data(), Eq(text->data()));
+  std::weak_ptr<const std::string> weak_text = text;
+  text.reset();
+  // The document keeps the text alive.
+  EXPECT_FALSE(weak_text.expired());
+  EXPECT_THAT((*doc)->root().Find("Name")->AsString(), Optional(Eq("chassis")));
+  doc->reset();
+  EXPECT_TRUE(weak_text.expired());
+}
+
+TEST(JsonDocumentTest, ParsesScalarDocuments) {
+  std::unique_ptr<JsonDocument> doc = ParseOrDie(" \"text\" ");
+  ASSERT_NE(doc, nullptr);
+  EXPECT_THAT(doc->root().AsString(), Optional(Eq("text")));
+}
+
+TEST(JsonDocumentTest, RejectsInvalidJson) {
+  for (absl::string_view text :
+       {"", "{", "[1,]", "{\"a\" 1}", "{\"a\": 1,}", "01", "1.", "-", "tru",
+        "\"abc", "\"\\x\"", "\"\\ud800\"", "\"\\udc00\"", "[1] 2",
+        "{\"a\":\"\x01\"}", "{1: 2}"}) {
+    EXPECT_THAT(JsonDocument::Parse(std::string(text)).status().code(),
+                Eq(absl::StatusCode::kInvalidArgument))
+        << text;
+  }
+}
+
+TEST(JsonDocumentTest, RejectsDeeplyNestedJson) {
+  std::string text = std::string(1000, '[') + std::string(1000, ']');
+  EXPECT_THAT(JsonDocument::Parse(text).status().code(),
+              Eq(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace ecclesia
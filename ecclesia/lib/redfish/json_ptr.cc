@@ -16,28 +16,122 @@
 
 #include "ecclesia/lib/redfish/json_ptr.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <optional>
 #include <string>
 
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/string_view.h"
+#include "ecclesia/lib/redfish/json_document.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
+namespace {
 
-nlohmann::json HandleJsonPtr(nlohmann::json json,
-                             absl::string_view pointer_str) {
-  try {
-    nlohmann::json::json_pointer ptr((std::string(pointer_str)));
-    return json.at(ptr);
-  } catch (...) {
-    // We use a general catch for any exceptions from parsing the json_pointer
-    // and accessing the json with it. We avoid specific exception catching in
-    // case nlohmann::json ever gets updated with new exceptions being thrown
-    // to avoid accidentally breaking dependents of this code. In general,
-    // we treat any exceptions thrown (bad pointer syntax, pointer reference not
-    // found, etc.) as a failure to handle the JSON pointer and return the same
-    // discarded value in all cases.
-    return nlohmann::json::value_t::discarded;
+// Unescapes a reference token ("~1" -> "/", "~0" -> "~"). Returns false if the
+// token holds an invalid escape sequence.
+bool UnescapeToken(absl::string_view token, std::string *unescaped) {
+  unescaped->clear();
+  unescaped->reserve(token.size());
+  for (size_t i = 0; i < token.size(); ++i) {
+    if (token[i] != '~') {
+      unescaped->push_back(token[i]);
+      continue;
+    }
+    if (++i == token.size()) return false;
+    if (token[i] == '0') {
+      unescaped->push_back('~');
+    } else if (token[i] == '1') {
+      unescaped->push_back('/');
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses an array index token. RFC6901 only allows non-negative decimal
+// numbers without leading zeros; "-" never refers to an existing element.
+bool ParseArrayIndex(absl::string_view token, size_t *index) {
+  if (token.empty() || (token.size() > 1 && token[0] == '0')) return false;
+  for (char c : token) {
+    if (!absl::ascii_isdigit(c)) return false;
   }
+  return absl::SimpleAtoi(token, index);
+}
+
+bool IsObject(const nlohmann::json *json) { return json->is_object(); }
+bool IsArray(const nlohmann::json *json) { return json->is_array(); }
+std::optional<const nlohmann::json *> FindMember(const nlohmann::json *json,
+                                                 const std::string &key) {
+  auto itr = json->find(key);
+  if (itr == json->end()) return std::nullopt;
+  return &*itr;
+}
+std::optional<const nlohmann::json *> FindElement(const nlohmann::json *json,
+                                                  size_t index) {
+  if (index >= json->size()) return std::nullopt;
+  return &(*json)[index];
+}
+
+bool IsObject(const JsonDocument::Value &value) { return value.is_object(); }
+bool IsArray(const JsonDocument::Value &value) { return value.is_array(); }
+std::optional<JsonDocument::Value> FindMember(const JsonDocument::Value &value,
+                                              const std::string &key) {
+  return value.Find(key);
+}
+std::optional<JsonDocument::Value> FindElement(
+    const JsonDocument::Value &value, size_t index) {
+  return value.At(index);
+}
+
+// Walks the reference tokens of a JSON pointer from the given node. Node is
+// either a pointer to an nlohmann::json or a JsonDocument::Value, which are
+// navigated through the FindMember() and FindElement() overloads above.
+template <typename Node>
+std::optional<Node> WalkJsonPtr(Node node, absl::string_view pointer_str) {
+  if (pointer_str.empty()) return node;
+  if (pointer_str[0] != '/') return std::nullopt;
+  std::string key;
+  while (!pointer_str.empty()) {
+    // Drop the leading '/' and split off the next reference token.
+    pointer_str.remove_prefix(1);
+    size_t end = std::min(pointer_str.find('/'), pointer_str.size());
+    absl::string_view token = pointer_str.substr(0, end);
+    pointer_str.remove_prefix(end);
+    std::optional<Node> child;
+    if (IsObject(node)) {
+      // The key buffer is reused across tokens rather than allocated per token.
+      if (!UnescapeToken(token, &key)) return std::nullopt;
+      child = FindMember(node, key);
+    } else if (size_t index; IsArray(node) && ParseArrayIndex(token, &index)) {
+      child = FindElement(node, index);
+    }
+    if (!child.has_value()) return std::nullopt;
+    node = *child;
+  }
+  return node;
+}
+
+}  // namespace
+
+const nlohmann::json *ResolveJsonPtr(const nlohmann::json &json,
+                                     absl::string_view pointer_str) {
+  return WalkJsonPtr(&json, pointer_str).value_or(nullptr);
+}
+
+std::optional<JsonDocument::Value> ResolveJsonPtr(
+    JsonDocument::Value value, absl::string_view pointer_str) {
+  return WalkJsonPtr(value, pointer_str);
+}
+
+nlohmann::json HandleJsonPtr(const nlohmann::json &json,
+                             absl::string_view pointer_str) {
+  const nlohmann::json *resolved = ResolveJsonPtr(json, pointer_str);
+  if (resolved == nullptr) return nlohmann::json::value_t::discarded;
+  return *resolved;
 }
 
 }  // namespace ecclesia
@@ -17,16 +17,29 @@
 #ifndef ECCLESIA_LIB_REDFISH_JSON_PTR_H_
 #define ECCLESIA_LIB_REDFISH_JSON_PTR_H_
 
+#include <optional>
+
 #include "absl/strings/string_view.h"
+#include "ecclesia/lib/redfish/json_document.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
 
 // Resolves a JSON pointer, as defined by RFC6901.
 // See https://datatracker.ietf.org/doc/html/rfc6901
+// Returns a pointer to the pointed-to JSON within the given document on
+// success, nullptr on failure. Resolution only walks the referenced path and
+// never copies any part of the document.
+const nlohmann::json *ResolveJsonPtr(const nlohmann::json &json,
+                                     absl::string_view pointer_str);
+// Same as above, for a value within a JsonDocument.
+std::optional<JsonDocument::Value> ResolveJsonPtr(
+    JsonDocument::Value value, absl::string_view pointer_str);
+
+// Resolves a JSON pointer, as defined by RFC6901.
 // Returns a copy of the pointed-to JSON on success, json::value_t::discarded
 // on failure.
-nlohmann::json HandleJsonPtr(nlohmann::json json,
+nlohmann::json HandleJsonPtr(const nlohmann::json &json,
                              absl::string_view pointer_str);
 
 }  // namespace ecclesia
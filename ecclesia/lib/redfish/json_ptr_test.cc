@@ -16,14 +16,21 @@
 
 #include "ecclesia/lib/redfish/json_ptr.h"
 
+#include <memory>
+#include <optional>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "ecclesia/lib/redfish/json_document.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
 namespace {
 
 using testing::Eq;
+using testing::IsNull;
+using testing::Optional;
 
 // Sample JSON taken from https://datatracker.ietf.org/doc/html/rfc6901
 // Note that backslash characters are escaped by the json::parse function,
@@ -152,5 +159,48 @@ TEST(JsonPtrTest, InvalidPointer) {
   EXPECT_TRUE(HandleJsonPtr(starting_json, "noslash").is_discarded());
 }
 
+TEST(JsonPtrTest, InvalidArrayIndex) {
+  nlohmann::json starting_json =
+      nlohmann::json::parse(kSampleJson, nullptr, /*allow_exceptions=*/false);
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/foo/2").is_discarded());
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/foo/01").is_discarded());
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/foo/-").is_discarded());
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/foo/+1").is_discarded());
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/foo/0/bar").is_discarded());
+}
+
+TEST(JsonPtrTest, InvalidEscape) {
+  nlohmann::json starting_json =
+      nlohmann::json::parse(kSampleJson, nullptr, /*allow_exceptions=*/false);
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/m~2n").is_discarded());
+  EXPECT_TRUE(HandleJsonPtr(starting_json, "/m~").is_discarded());
+}
+
+TEST(JsonPtrTest, ResolveReturnsNodeWithinDocument) {
+  nlohmann::json starting_json =
+      nlohmann::json::parse(kSampleJson, nullptr, /*allow_exceptions=*/false);
+  EXPECT_THAT(ResolveJsonPtr(starting_json, ""), Eq(&starting_json));
+  EXPECT_THAT(ResolveJsonPtr(starting_json, "/foo/1"),
+              Eq(&starting_json["foo"][1]));
+  EXPECT_THAT(ResolveJsonPtr(starting_json, "/m~0n"),
+              Eq(&starting_json["m~n"]));
+  EXPECT_THAT(ResolveJsonPtr(starting_json, "/something"), IsNull());
+}
+
+TEST(JsonPtrTest, ResolveWithinJsonDocument) {
+  absl::StatusOr<std::unique_ptr<JsonDocument>> doc =
+      JsonDocument::Parse(kSampleJson);
+  ASSERT_TRUE(doc.ok()) << doc.status();
+  std::optional<JsonDocument::Value> value =
+      ResolveJsonPtr((*doc)->root(), "/foo/1");
+  ASSERT_TRUE(value.has_value());
+  EXPECT_THAT(value->AsString(), Optional(Eq("baz")));
+  value = ResolveJsonPtr((*doc)->root(), "/a~1b");
+  ASSERT_TRUE(value.has_value());
+  EXPECT_THAT(value->AsInt64(), Optional(Eq(1)));
+  EXPECT_FALSE(ResolveJsonPtr((*doc)->root(), "/foo/2").has_value());
+  EXPECT_FALSE(ResolveJsonPtr((*doc)->root(), "noslash").has_value());
+}
+
 }  // namespace
 }  // namespace ecclesia
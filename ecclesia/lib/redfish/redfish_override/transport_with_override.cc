@@ -21,12 +21,15 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "ecclesia/lib/http/codes.h"
 #include "ecclesia/lib/redfish/proto/redfish_v1.grpc.pb.h"
 #include "ecclesia/lib/redfish/proto/redfish_v1.pb.h"
 #include "ecclesia/lib/redfish/redfish_override/rf_override.pb.h"
@@ -355,6 +358,34 @@ absl::StatusOr<RedfishTransport::Result> RedfishTransportWithOverride::Get(
   if (!get_result.ok()) {
     return get_result;
   }
+  ApplyOverrides(path, *get_result);
+  return *get_result;
+}
+
+absl::StatusOr<RedfishTransport::Result>
+RedfishTransportWithOverride::GetIfNoneMatch(absl::string_view path,
+                                             absl::string_view etag) {
+  auto get_result = redfish_transport_->GetIfNoneMatch(path, etag);
+  if (get_result.ok() && get_result->code != HTTP_CODE_NOT_MODIFIED) {
+    ApplyOverrides(path, *get_result);
+  }
+  return get_result;
+}
+
+std::vector<absl::StatusOr<RedfishTransport::Result>>
+RedfishTransportWithOverride::GetMany(
+    absl::Span<const absl::string_view> paths) {
+  auto results = redfish_transport_->GetMany(paths);
+  for (size_t i = 0; i < results.size() && i < paths.size(); ++i) {
+    if (results[i].ok()) {
+      ApplyOverrides(paths[i], *results[i]);
+    }
+  }
+  return results;
+}
+
+void RedfishTransportWithOverride::ApplyOverrides(absl::string_view path,
+                                                  Result &result) {
   auto extend_pos = path.find_first_of('?');
   if (extend_pos != std::string::npos) {
     path = path.substr(0, extend_pos);
@@ -367,7 +398,7 @@ absl::StatusOr<RedfishTransport::Result> RedfishTransportWithOverride::Get(
   if (iter != override_policy_.override_content_map_uri().end()) {
     for (const auto &field : iter->second.override_field()) {
       auto update_status =
-          ResultUpdateHelper(field, *get_result, redfish_transport_.get());
+          ResultUpdateHelper(field, result, redfish_transport_.get());
       if (!update_status.ok()) {
         LOG(WARNING) << absl::StrFormat(
             "Failed to perform override to uri: %s, failure: %s.", path,
@@ -382,7 +413,7 @@ absl::StatusOr<RedfishTransport::Result> RedfishTransportWithOverride::Get(
     }
     for (const auto &field : override_content.override_field()) {
       auto update_status =
-          ResultUpdateHelper(field, *get_result, redfish_transport_.get());
+          ResultUpdateHelper(field, result, redfish_transport_.get());
       if (!update_status.ok()) {
         LOG(WARNING) << absl::StrFormat(
             "Failed to perform override to uri: %s, failure: %s.", path,
@@ -390,7 +421,6 @@ absl::StatusOr<RedfishTransport::Result> RedfishTransportWithOverride::Get(
       }
     }
   }
-  return *get_result;
 }
 
 }  // namespace ecclesia
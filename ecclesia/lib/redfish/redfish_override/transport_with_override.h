@@ -20,9 +20,11 @@
 #include <memory>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/redfish_override/rf_override.pb.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 #include "grpcpp/security/credentials.h"
@@ -59,6 +61,17 @@ class RedfishTransportWithOverride : public RedfishTransport {
   // from the underneath transport layer.
   absl::StatusOr<Result> Get(absl::string_view path) override;
 
+  // Performs a conditional GET through the underneath transport. Overrides are
+  // applied unless the service answers that the resource is unchanged, in
+  // which case there is no body to override.
+  absl::StatusOr<Result> GetIfNoneMatch(absl::string_view path,
+                                        absl::string_view etag) override;
+
+  // Fetches all paths through the underneath transport's GetMany and applies
+  // the overrides to each response.
+  std::vector<absl::StatusOr<Result>> GetMany(
+      absl::Span<const absl::string_view> paths) override;
+
   // A helper function to get the original response, i.e., without any override.
   absl::StatusOr<Result> GetOriginalResponse(absl::string_view path) {
     return redfish_transport_->Get(path);
@@ -82,6 +95,9 @@ class RedfishTransportWithOverride : public RedfishTransport {
   }
 
  private:
+  // Applies the override policy matching path to a response fetched for it.
+  void ApplyOverrides(absl::string_view path, Result &result);
+
   std::unique_ptr<RedfishTransport> redfish_transport_;
 
   const OverridePolicy override_policy_;
@@ -16,57 +16,593 @@
 
 #include "ecclesia/lib/redfish/transport/cache.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
 #include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
+#include "ecclesia/lib/http/codes.h"
+#include "ecclesia/lib/redfish/json_document.h"
+#include "ecclesia/lib/redfish/property_definitions.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 #include "ecclesia/lib/time/clock.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
+namespace {
+
+constexpr absl::string_view kEtagHeader = "ETag";
+constexpr absl::string_view kContentTypeHeader = "Content-Type";
+constexpr absl::string_view kJsonContentType = "application/json";
+
+// Expand type of a $expand query expanding all resources.
+constexpr char kExpandAll = '*';
+// Every expand type, as produced by RedfishQueryParamExpand.
+constexpr char kExpandTypes[] = {kExpandAll, '.', '~'};
+
+// The parts of a path with a $expand query in the format produced by
+// RedfishQueryParamExpand, such as "/redfish/v1/Chassis?$expand=.($levels=2)".
+struct ExpandQuery {
+  absl::string_view base_path;
+  char type;
+  size_t levels;
+};
+
+// Returns the $expand query of a path, or nullopt if it has none.
+std::optional<ExpandQuery> ParseExpandQuery(absl::string_view path) {
+  size_t query_start = path.find('?');
+  if (query_start == absl::string_view::npos) return std::nullopt;
+  absl::string_view query = path.substr(query_start + 1);
+  if (!absl::ConsumePrefix(&query, "$expand=") || query.empty()) {
+    return std::nullopt;
+  }
+  char type = query.front();
+  query.remove_prefix(1);
+  size_t levels;
+  if (!absl::ConsumePrefix(&query, "($levels=") ||
+      !absl::ConsumeSuffix(&query, ")") || !absl::SimpleAtoi(query, &levels)) {
+    return std::nullopt;
+  }
+  return ExpandQuery{path.substr(0, query_start), type, levels};
+}
+
+// Returns the path of a resource expanded with the given levels; the plain
+// path if there are none.
+std::string ExpandedPath(absl::string_view base_path, char type,
+                         size_t levels) {
+  if (levels == 0) return std::string(base_path);
+  return absl::StrCat(base_path, "?$expand=", absl::string_view(&type, 1),
+                      "($levels=", levels, ")");
+}
+
+// Returns the ETag header of a result, or an empty string if there is none.
+std::string GetEtag(const RedfishTransport::Result &result) {
+  for (const auto &[name, value] : result.headers) {
+    if (absl::EqualsIgnoreCase(name, kEtagHeader)) return value;
+  }
+  return "";
+}
+
+// Estimates the memory held by a JSON value, counting each node along with
+// the characters of its strings and object keys.
+size_t EstimateJsonSize(const nlohmann::json &json) {
+  size_t size = sizeof(nlohmann::json);
+  if (json.is_string()) {
+    size += json.get_ref<const std::string &>().size();
+  } else if (json.is_object()) {
+    for (const auto &item : json.items()) {
+      size += item.key().size() + EstimateJsonSize(item.value());
+    }
+  } else if (json.is_array()) {
+    for (const nlohmann::json &element : json) {
+      size += EstimateJsonSize(element);
+    }
+  }
+  return size;
+}
+
+// Estimates the memory held by a cached result stored under `path`, along with
+// the document parsed from it if any.
+size_t EstimateEntrySize(absl::string_view path,
+                         const RedfishTransport::Result &result,
+                         const JsonDocument *document) {
+  size_t size = 2 * path.size();  // Key in the map and in the LRU list.
+  for (const auto &[name, value] : result.headers) {
+    size += name.size() + value.size();
+  }
+  if (const auto *json = std::get_if<nlohmann::json>(&result.body)) {
+    size += EstimateJsonSize(*json);
+  } else {
+    size += std::get<RedfishTransport::bytes>(result.body).size();
+  }
+  if (document != nullptr) size += document->SizeBytes();
+  return size;
+}
+
+// Returns true if a result has a body that can be cached: either parsed JSON,
+// or JSON left as bytes by the transport for the interface to parse.
+bool HasJsonBody(const RedfishTransport::Result &result) {
+  if (std::holds_alternative<nlohmann::json>(result.body)) return true;
+  for (const auto &[name, value] : result.headers) {
+    if (absl::EqualsIgnoreCase(name, kContentTypeHeader)) {
+      return absl::StartsWithIgnoreCase(value, kJsonContentType);
+    }
+  }
+  return false;
+}
+
+// Returns the number of shards to use for a configured number of shards.
+size_t NumShards(size_t num_shards) { return std::max<size_t>(num_shards, 1); }
+
+// Splits a cache-wide limit evenly between shards, rounding up so that the
+// limit of 0 (no limit) is preserved.
+size_t PerShardLimit(size_t limit, size_t num_shards) {
+  return (limit + num_shards - 1) / num_shards;
+}
+
+// Wraps a result fetched from a transport so that it can be shared.
+RedfishCachedGetterInterface::GetResult ShareResult(
+    absl::StatusOr<RedfishTransport::Result> result) {
+  if (!result.ok()) return {.result = result.status(), .is_fresh = true};
+  return {.result = std::make_shared<const RedfishTransport::Result>(
+              *std::move(result)),
+          .is_fresh = true};
+}
+
+}  // namespace
+
+std::shared_ptr<const JsonDocument> ParseJsonDocument(
+    std::shared_ptr<const RedfishTransport::Result> result) {
+  const auto *bytes = std::get_if<RedfishTransport::bytes>(&result->body);
+  if (bytes == nullptr || !HasJsonBody(*result)) return nullptr;
+  absl::string_view text(reinterpret_cast<const char *>(bytes->data()),
+                         bytes->size());
+  absl::StatusOr<std::unique_ptr<JsonDocument>> document =
+      JsonDocument::Parse(text, std::move(result));
+  if (!document.ok()) return nullptr;
+  return *std::move(document);
+}
 
 RedfishCachedGetterInterface::GetResult NullCache::CachedGetInternal(
     absl::string_view path) {
   // Report uncached call as this is nullcache
-  return {.result = transport_->Get(path), .is_fresh = true};
+  return ShareResult(transport_->Get(path));
 }
 
 RedfishCachedGetterInterface::GetResult NullCache::UncachedGetInternal(
     absl::string_view path) {
-  return {.result = transport_->Get(path), .is_fresh = true};
+  return ShareResult(transport_->Get(path));
+}
+
+TimeBasedCache::TimeBasedCache(
+    RedfishTransport *transport, Clock *clock, absl::Duration max_age,
+    Config config, std::optional<const ApiComplexityContextManager *> manager)
+    : RedfishCachedGetterInterface(manager),
+      transport_(transport),
+      clock_(clock),
+      max_age_(max_age),
+      ttl_policy_(std::move(config.ttl_policy)),
+      store_(std::move(config.store)),
+      max_stale_(config.max_stale),
+      refresh_ahead_(config.refresh_ahead),
+      max_shard_entries_(
+          PerShardLimit(config.max_entries, NumShards(config.num_shards))),
+      max_shard_bytes_(
+          PerShardLimit(config.max_bytes, NumShards(config.num_shards))),
+      shards_(NumShards(config.num_shards)) {
+  if (max_stale_ > absl::ZeroDuration() ||
+      refresh_ahead_ > absl::ZeroDuration()) {
+    refresh_pool_ =
+        std::make_unique<ThreadPool>(std::max(config.refresh_threads, 1));
+  }
+  if (store_ != nullptr) RestoreEntries();
+}
+
+TimeBasedCache::~TimeBasedCache() { WaitForRefreshes(); }
+
+TimeBasedCache::Shard &TimeBasedCache::GetShard(absl::string_view path) {
+  absl::string_view base_path = path.substr(0, path.find('?'));
+  return shards_[absl::HashOf(base_path) % shards_.size()];
+}
+
+absl::Duration TimeBasedCache::GetMaxAge(
+    absl::string_view path, const RedfishTransport::Result &result,
+    const JsonDocument *document) const {
+  if (ttl_policy_ == nullptr) return max_age_;
+  if (const auto *json = std::get_if<nlohmann::json>(&result.body)) {
+    return ttl_policy_->GetMaxAge(path, *json).value_or(max_age_);
+  }
+  std::optional<absl::string_view> odata_type;
+  if (ttl_policy_->HasTypeRules() && document != nullptr) {
+    if (std::optional<JsonDocument::Value> value =
+            document->root().Find(PropertyOdataType::Name);
+        value.has_value()) {
+      odata_type = value->AsString();
+    }
+  }
+  return ttl_policy_->GetMaxAgeForType(path, odata_type).value_or(max_age_);
+}
+
+absl::Duration TimeBasedCache::GetRetention(const CacheEntry &entry) const {
+  // Entries are kept as long as they may be served stale. Entries with an ETag
+  // get one more max age window before they are purged, as revalidating them
+  // is much cheaper than fetching them again.
+  absl::Duration retention = entry.max_age + max_stale_;
+  if (!entry.etag.empty()) retention += entry.max_age;
+  return retention;
+}
+
+void TimeBasedCache::RestoreEntries() {
+  absl::Time now = clock_->Now();
+  for (auto &[path, stored] : store_->TakeLoadedEntries()) {
+    CacheEntry entry;
+    entry.insert_time = stored.insert_time;
+    entry.data = std::make_shared<const RedfishTransport::Result>(
+        std::move(stored.result));
+    entry.document = ParseJsonDocument(entry.data);
+    entry.max_age = GetMaxAge(path, *entry.data, entry.document.get());
+    entry.etag = std::move(stored.etag);
+    if (now - entry.insert_time >= GetRetention(entry)) {
+      // However old, an entry with an ETag is cheaper to revalidate than to
+      // fetch again. It is restored as just expired, which makes the next
+      // CachedGet revalidate it with If-None-Match, and gives it the
+      // retention of any expired entry.
+      if (entry.etag.empty()) continue;
+      entry.insert_time = now - entry.max_age - max_stale_;
+    }
+    entry.bytes = EstimateEntrySize(path, *entry.data, entry.document.get());
+
+    Shard &shard = GetShard(path);
+    absl::MutexLock mu(&shard.mutex);
+    PutEntry(shard, path, std::move(entry));
+    ++shard.stats.restored;
+  }
 }
 
 RedfishCachedGetterInterface::GetResult TimeBasedCache::CachedGetInternal(
     absl::string_view path) {
+  Shard &shard = GetShard(path);
+  std::string etag;
+  std::shared_ptr<InFlightGet> in_flight;
+  bool is_leader = false;
+  {
+    absl::MutexLock mu(&shard.mutex);
+    auto val = shard.cache.find(path);
+    if (val != shard.cache.end()) {
+      absl::Duration age = clock_->Now() - val->second.insert_time;
+      absl::Duration max_age = val->second.max_age;
+      if (age < max_age + max_stale_) {
+        ++shard.stats.hits;
+        shard.TouchEntry(val->second);
+        if (age >= max_age) {
+          ++shard.stats.stale_hits;
+          StartBackgroundRefresh(shard, path, val->second.etag);
+        } else if (refresh_ahead_ > absl::ZeroDuration() &&
+                   age >= max_age - refresh_ahead_) {
+          StartBackgroundRefresh(shard, path, val->second.etag);
+        }
+        // Report cached result
+        return {.result = val->second.data,
+                .is_fresh = false,
+                .document = val->second.document};
+      }
+      etag = val->second.etag;
+    }
+    if (CacheEntry *entry = FindCoveringEntry(shard, path, clock_->Now());
+        entry != nullptr) {
+      ++shard.stats.hits;
+      ++shard.stats.covering_hits;
+      shard.TouchEntry(*entry);
+      return {.result = entry->data,
+              .is_fresh = false,
+              .document = entry->document};
+    }
+    ++shard.stats.misses;
+    auto [it, inserted] = shard.in_flight.try_emplace(path);
+    if (inserted) {
+      it->second = std::make_shared<InFlightGet>();
+      is_leader = true;
+    } else {
+      ++shard.stats.coalesced_gets;
+    }
+    in_flight = it->second;
+  }
+  if (!is_leader) {
+    in_flight->done.WaitForNotification();
+    return in_flight->result;
+  }
+
+  FinishInFlight(shard, path, *in_flight, FetchForCache(shard, path, etag));
+  return in_flight->result;
+}
+
+TimeBasedCache::CacheEntry *TimeBasedCache::FindCoveringEntry(
+    Shard &shard, absl::string_view path, absl::Time now) {
+  std::optional<ExpandQuery> expand = ParseExpandQuery(path);
+  std::vector<char> types;
+  if (expand.has_value()) {
+    // Expanding all resources covers expanding only some of them.
+    types.push_back(expand->type);
+    if (expand->type != kExpandAll) types.push_back(kExpandAll);
+  } else {
+    // A plain path is covered by the resource expanded in any way, e.g. a
+    // member embedded in its expanded collection: the expanded resource has
+    // all the properties of the plain one.
+    if (path.find('?') != absl::string_view::npos) return nullptr;
+    expand = ExpandQuery{path, kExpandAll, 0};
+    types.assign(std::begin(kExpandTypes), std::end(kExpandTypes));
+  }
+  for (size_t levels = std::max<size_t>(expand->levels, 1);
+       levels <= shard.max_expand_levels; ++levels) {
+    for (char type : types) {
+      if (levels == expand->levels && type == expand->type) continue;
+      auto it = shard.cache.find(ExpandedPath(expand->base_path, type, levels));
+      if (it != shard.cache.end() &&
+          now - it->second.insert_time < it->second.max_age) {
+        return &it->second;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void TimeBasedCache::StartBackgroundRefresh(Shard &shard,
+                                            absl::string_view path,
+                                            absl::string_view etag) {
+  auto [it, inserted] = shard.in_flight.try_emplace(path);
+  if (!inserted) return;
+  it->second = std::make_shared<InFlightGet>();
+  ++shard.stats.background_refreshes;
+  {
+    absl::MutexLock mu(&refresh_mutex_);
+    ++pending_refreshes_;
+  }
+  refresh_pool_->Schedule([this, &shard, path = std::string(path),
+                           etag = std::string(etag),
+                           in_flight = it->second]() {
+    FinishInFlight(shard, path, *in_flight, FetchForCache(shard, path, etag));
+    absl::MutexLock mu(&refresh_mutex_);
+    --pending_refreshes_;
+  });
+}
+
+void TimeBasedCache::FinishInFlight(Shard &shard, absl::string_view path,
+                                    InFlightGet &in_flight, GetResult result) {
+  in_flight.result = std::move(result);
+  {
+    // The result is already cached, so later misses will not need the
+    // in-flight fetch once it is removed.
+    absl::MutexLock mu(&shard.mutex);
+    shard.in_flight.erase(path);
+  }
+  in_flight.done.Notify();
+}
+
+void TimeBasedCache::WaitForRefreshes() {
+  absl::MutexLock mu(&refresh_mutex_);
+  refresh_mutex_.Await(absl::Condition(
+      +[](int *pending) { return *pending == 0; }, &pending_refreshes_));
+}
+
+RedfishCachedGetterInterface::GetResult TimeBasedCache::FetchForCache(
+    Shard &shard, absl::string_view path, absl::string_view etag) {
+  if (etag.empty()) return StoreFreshResult(shard, path, transport_->Get(path));
+
+  auto result = transport_->GetIfNoneMatch(path, etag);
+  if (!result.ok() || result->code != HTTP_CODE_NOT_MODIFIED) {
+    return StoreFreshResult(shard, path, std::move(result));
+  }
+  std::optional<GetResult> revalidated;
+  absl::Time now = clock_->Now();
   {
-    absl::MutexLock mu(&cache_lock_);
-    auto val = cache_.find(path);
-    if (val != cache_.end() &&
-        (clock_->Now() - val->second.insert_time) < max_age_) {
-      // Report cached result
-      return {.result = val->second.data, .is_fresh = false};
+    // The service confirmed the cached data is current, so it is as good as a
+    // freshly fetched result.
+    absl::MutexLock mu(&shard.mutex);
+    auto val = shard.cache.find(path);
+    if (val != shard.cache.end() && val->second.etag == etag) {
+      val->second.insert_time = now;
+      shard.TouchEntry(val->second);
+      revalidated = {.result = val->second.data,
+                     .is_fresh = true,
+                     .document = val->second.document};
     }
   }
-  auto result = transport_->Get(path);
-  absl::MutexLock mu(&cache_lock_);
-  if (result.ok() && std::holds_alternative<nlohmann::json>(result->body)) {
-    cache_[path] = CacheEntry{.insert_time = clock_->Now(), .data = result};
+  if (revalidated.has_value()) {
+    if (store_ != nullptr) store_->AppendRevalidation(path, etag, now);
+    return *std::move(revalidated);
   }
-  return {.result = result, .is_fresh = true};
+  // The entry was replaced while revalidating it; fetch the full resource.
+  return StoreFreshResult(shard, path, transport_->Get(path));
 }
 
 RedfishCachedGetterInterface::GetResult TimeBasedCache::UncachedGetInternal(
     absl::string_view path) {
-  auto result = transport_->Get(path);
-  absl::MutexLock mu(&cache_lock_);
-  if (result.ok() && std::holds_alternative<nlohmann::json>(result->body)) {
-    cache_[path] = CacheEntry{.insert_time = clock_->Now(), .data = result};
+  return StoreFreshResult(GetShard(path), path, transport_->Get(path));
+}
+
+TimeBasedCache::Stats TimeBasedCache::GetStats() const {
+  Stats stats;
+  for (const Shard &shard : shards_) {
+    absl::MutexLock mu(&shard.mutex);
+    stats.hits += shard.stats.hits;
+    stats.covering_hits += shard.stats.covering_hits;
+    stats.stale_hits += shard.stats.stale_hits;
+    stats.background_refreshes += shard.stats.background_refreshes;
+    stats.misses += shard.stats.misses;
+    stats.coalesced_gets += shard.stats.coalesced_gets;
+    stats.evictions += shard.stats.evictions;
+    stats.purged += shard.stats.purged;
+    stats.restored += shard.stats.restored;
+    stats.embedded_entries += shard.stats.embedded_entries;
+    stats.entries += shard.cache.size();
+    stats.bytes += shard.bytes;
+  }
+  return stats;
+}
+
+RedfishCachedGetterInterface::GetResult TimeBasedCache::StoreFreshResult(
+    Shard &shard, absl::string_view path,
+    absl::StatusOr<RedfishTransport::Result> result) {
+  GetResult shared = ShareResult(std::move(result));
+  if (!shared.result.ok() || !HasJsonBody(**shared.result)) return shared;
+  const RedfishTransport::Result &data = **shared.result;
+  CacheEntry entry;
+  entry.insert_time = clock_->Now();
+  entry.data = *shared.result;
+  entry.document = ParseJsonDocument(entry.data);
+  shared.document = entry.document;
+  entry.max_age = GetMaxAge(path, data, entry.document.get());
+  entry.etag = GetEtag(data);
+  entry.bytes = EstimateEntrySize(path, data, entry.document.get());
+  if (store_ != nullptr) {
+    store_->AppendResult(path, entry.etag, entry.insert_time, entry.data);
+  }
+  absl::Time now = entry.insert_time;
+  {
+    absl::MutexLock mu(&shard.mutex);
+    PutEntry(shard, path, std::move(entry));
+  }
+  // Resources embedded in bytes bodies are not split out, as that would mean
+  // parsing every expanded response here as well as in the interface.
+  if (std::optional<ExpandQuery> expand = ParseExpandQuery(path);
+      expand.has_value() && expand->levels > 0 &&
+      std::holds_alternative<nlohmann::json>(data.body)) {
+    StoreEmbeddedResources(std::get<nlohmann::json>(data.body), expand->type,
+                           expand->levels, now);
+  }
+  PurgeExpiredEntries(now);
+  return shared;
+}
+
+void TimeBasedCache::StoreEmbeddedResources(const nlohmann::json &json,
+                                            char expand_type, size_t levels,
+                                            absl::Time insert_time) {
+  for (const nlohmann::json &value : json) {
+    if (value.is_array()) {
+      StoreEmbeddedResources(value, expand_type, levels, insert_time);
+      continue;
+    }
+    if (!value.is_object()) continue;
+    // An object with an @odata.id and other properties is an expanded
+    // resource, with one less level of expansion than its parent. Anything
+    // else, such as a reference or a complex property, is searched further.
+    auto odata_id = value.find(PropertyOdataId::Name);
+    if (odata_id == value.end() || !odata_id->is_string() ||
+        value.size() == 1 ||
+        absl::StrContains(odata_id->get_ref<const std::string &>(), '#')) {
+      StoreEmbeddedResources(value, expand_type, levels, insert_time);
+      continue;
+    }
+    StoreEmbeddedResource(
+        ExpandedPath(odata_id->get_ref<const std::string &>(), expand_type,
+                     levels - 1),
+        value, insert_time);
+    if (levels > 1) {
+      StoreEmbeddedResources(value, expand_type, levels - 1, insert_time);
+    }
+  }
+}
+
+void TimeBasedCache::StoreEmbeddedResource(const std::string &path,
+                                           const nlohmann::json &json,
+                                           absl::Time insert_time) {
+  auto data = std::make_shared<RedfishTransport::Result>();
+  data->code = HTTP_CODE_REQUEST_OK;
+  data->body = json;
+  CacheEntry entry;
+  entry.insert_time = insert_time;
+  entry.max_age = GetMaxAge(path, *data, nullptr);
+  entry.bytes = EstimateEntrySize(path, *data, nullptr);
+  entry.data = std::move(data);
+
+  Shard &shard = GetShard(path);
+  absl::MutexLock mu(&shard.mutex);
+  // A fresh entry fetched on its own is kept, as it may have an ETag.
+  auto it = shard.cache.find(path);
+  if (it != shard.cache.end() &&
+      insert_time - it->second.insert_time < it->second.max_age) {
+    return;
+  }
+  PutEntry(shard, path, std::move(entry));
+  ++shard.stats.embedded_entries;
+}
+
+void TimeBasedCache::PutEntry(Shard &shard, absl::string_view path,
+                              CacheEntry entry) {
+  auto [it, inserted] = shard.cache.try_emplace(path);
+  if (inserted) {
+    shard.lru.emplace_front(path);
+    entry.lru_position = shard.lru.begin();
+  } else {
+    shard.bytes -= it->second.bytes;
+    shard.TouchEntry(it->second);
+    entry.lru_position = it->second.lru_position;
+  }
+  shard.bytes += entry.bytes;
+  it->second = std::move(entry);
+  if (std::optional<ExpandQuery> expand = ParseExpandQuery(path);
+      expand.has_value()) {
+    shard.max_expand_levels =
+        std::max(shard.max_expand_levels, expand->levels);
+  }
+  EvictEntries(shard);
+}
+
+void TimeBasedCache::Shard::TouchEntry(CacheEntry &entry) {
+  lru.splice(lru.begin(), lru, entry.lru_position);
+}
+
+void TimeBasedCache::Shard::EraseEntry(CacheMap::iterator it) {
+  bytes -= it->second.bytes;
+  lru.erase(it->second.lru_position);
+  cache.erase(it);
+}
+
+void TimeBasedCache::EvictEntries(Shard &shard) {
+  while (!shard.lru.empty() &&
+         ((max_shard_entries_ > 0 &&
+           shard.cache.size() > max_shard_entries_) ||
+          (max_shard_bytes_ > 0 && shard.bytes > max_shard_bytes_))) {
+    shard.EraseEntry(shard.cache.find(shard.lru.back()));
+    ++shard.stats.evictions;
+  }
+}
+
+void TimeBasedCache::PurgeExpiredEntries(absl::Time now) {
+  {
+    absl::MutexLock mu(&purge_mutex_);
+    if (now - last_purge_ < max_age_) return;
+    last_purge_ = now;
+  }
+  for (Shard &shard : shards_) {
+    absl::MutexLock mu(&shard.mutex);
+    for (auto it = shard.cache.begin(); it != shard.cache.end();) {
+      if (now - it->second.insert_time >= GetRetention(it->second)) {
+        shard.EraseEntry(it++);
+        ++shard.stats.purged;
+      } else {
+        ++it;
+      }
+    }
   }
-  return {.result = result, .is_fresh = true};
 }
 
 }  // namespace ecclesia
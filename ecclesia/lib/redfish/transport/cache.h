@@ -17,8 +17,13 @@
 #ifndef ECCLESIA_LIB_REDFISH_TRANSPORT_CACHE_H_
 #define ECCLESIA_LIB_REDFISH_TRANSPORT_CACHE_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
@@ -27,9 +32,14 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "ecclesia/lib/complexity_tracker/complexity_tracker.h"
+#include "ecclesia/lib/redfish/json_document.h"
+#include "ecclesia/lib/redfish/transport/cache_ttl_policy.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
+#include "ecclesia/lib/redfish/transport/persistent_cache_store.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "ecclesia/lib/time/clock.h"
 
 namespace ecclesia {
@@ -39,11 +49,15 @@ namespace ecclesia {
 class RedfishCachedGetterInterface {
  public:
   struct GetResult {
-    // Result of the Redfish GET request.
-    absl::StatusOr<RedfishTransport::Result> result;
+    // Result of the Redfish GET request. The result may be shared with the
+    // cache and other callers, so it is never modified once returned.
+    absl::StatusOr<std::shared_ptr<const RedfishTransport::Result>> result;
     // True if the result was fetched from a live service. False if the result
     // was fetched from a cache.
     bool is_fresh;
+    // Document parsed from a JSON body left as bytes by the transport, if the
+    // cache keeps one along with the result; nullptr otherwise.
+    std::shared_ptr<const JsonDocument> document;
   };
 
   // Manager can be nullptr when used outside of mmanager
@@ -86,6 +100,12 @@ class RedfishCachedGetterInterface {
   std::optional<const ApiComplexityContextManager *> manager_;
 };
 
+// Returns the JsonDocument of a result whose JSON body was left as bytes by the
+// transport, or nullptr if the body is not such valid JSON. The document refers
+// to the body rather than copying it, and keeps the result alive.
+std::shared_ptr<const JsonDocument> ParseJsonDocument(
+    std::shared_ptr<const RedfishTransport::Result> result);
+
 // No cache policy; there is no cache and CachedGet is equivalent to
 // UncachedGet.
 class NullCache : public RedfishCachedGetterInterface {
@@ -106,16 +126,110 @@ class NullCache : public RedfishCachedGetterInterface {
 };
 
 // Time-based cache policy. A cached entry will be returned as long as it was
-// last fetched within a max_age_ window.
+// last fetched within a max_age_ window, which may be chosen per resource by a
+// CacheTtlPolicy. Once an entry that carried an ETag
+// expires, it is revalidated with a conditional GET; if the service answers
+// 304 Not Modified, the cached data is kept and its max_age_ window restarts.
+//
+// Concurrent CachedGet calls missing on the same path are coalesced: the first
+// one fetches from the service and the others wait for and share its result.
+//
+// The cache can be bounded in entries and in estimated bytes, in which case
+// the least recently used entries are evicted first. Expired entries are also
+// purged, at most once per max_age_, when new results are stored; entries with
+// an ETag are kept for one more max_age_ so they can still be revalidated.
+//
+// Paths are spread over independently locked shards so that concurrent readers
+// rarely contend, and entries are shared rather than copied on a hit. JSON
+// bodies left as bytes by the transport are parsed into a JsonDocument once,
+// when they are stored, and the document is shared along with the entry.
+//
+// To bound latency, the cache can also serve expired entries for a while
+// (stale-while-revalidate) and refresh entries about to expire (refresh-ahead),
+// with the refreshes running on background threads.
+//
+// Fetched entries can also be written to a PersistentCacheStore, which warms
+// up the cache when it is created again after a restart.
+//
+// The cache understands the $expand query added by HttpRedfishInterface. The
+// resources embedded in an expanded response are cached on their own, so that
+// they can answer GETs of the resources themselves, and a request for some
+// $levels of expansion is answered by a fresh entry with more levels.
 class TimeBasedCache : public RedfishCachedGetterInterface {
  public:
+  struct Config {
+    // Maximum number of cached entries. 0 means no limit.
+    size_t max_entries = 0;
+    // Maximum estimated size of the cached entries in bytes. 0 means no limit.
+    size_t max_bytes = 0;
+    // Number of independently locked shards. The limits above are split evenly
+    // between the shards, so eviction order is only LRU within a shard.
+    size_t num_shards = 16;
+    // How long past max_age an entry may still be returned by CachedGet while
+    // it is refreshed in the background. Zero disables stale-while-revalidate.
+    absl::Duration max_stale = absl::ZeroDuration();
+    // A hit on an entry expiring within this duration starts a background
+    // refresh, so frequently read paths never expire. Zero disables it.
+    absl::Duration refresh_ahead = absl::ZeroDuration();
+    // Number of threads running background refreshes, if any are enabled.
+    int refresh_threads = 1;
+    // Chooses the max age of each resource when it is stored. Resources not
+    // matched by the policy, or all of them if it is null, use max_age.
+    std::shared_ptr<const CacheTtlPolicy> ttl_policy;
+    // If set, the cache starts with the entries read back from the store which
+    // are not expired yet, and with the ones which have an ETag, however old,
+    // to be revalidated when they are next read. Every entry fetched
+    // afterwards is queued to be written to the store in the background.
+    std::shared_ptr<PersistentCacheStore> store;
+  };
+
+  struct Stats {
+    // Number of CachedGet calls answered from the cache.
+    int64_t hits = 0;
+    // Number of hits answered by an entry expanded with more levels than
+    // requested, including plain requests answered by an expanded entry.
+    int64_t covering_hits = 0;
+    // Number of hits which returned an expired entry, as allowed by max_stale.
+    int64_t stale_hits = 0;
+    // Number of refreshes started in the background.
+    int64_t background_refreshes = 0;
+    // Number of CachedGet calls which went to the service, including the ones
+    // that revalidated an expired entry or were coalesced.
+    int64_t misses = 0;
+    // Number of CachedGet calls which waited on a fetch of the same path
+    // already in flight instead of issuing their own.
+    int64_t coalesced_gets = 0;
+    // Number of entries evicted to stay within the Config limits.
+    int64_t evictions = 0;
+    // Number of expired entries purged.
+    int64_t purged = 0;
+    // Number of entries restored from the persistent store.
+    int64_t restored = 0;
+    // Number of entries stored from resources embedded in expanded responses.
+    int64_t embedded_entries = 0;
+    // Current number of entries and their estimated size in bytes.
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
   TimeBasedCache(
       RedfishTransport *transport, Clock *clock, absl::Duration max_age,
       std::optional<const ApiComplexityContextManager *> manager = std::nullopt)
-      : RedfishCachedGetterInterface(manager),
-        transport_(transport),
-        clock_(clock),
-        max_age_(max_age) {}
+      : TimeBasedCache(transport, clock, max_age, Config(), manager) {}
+
+  TimeBasedCache(RedfishTransport *transport, Clock *clock,
+                 absl::Duration max_age, Config config,
+                 std::optional<const ApiComplexityContextManager *> manager =
+                     std::nullopt);
+
+  // Waits for background refreshes to complete before destroying the cache.
+  ~TimeBasedCache() override;
+
+  // Returns the statistics summed over all shards.
+  Stats GetStats() const;
+
+  // Blocks until all background refreshes started so far have completed.
+  void WaitForRefreshes() ABSL_LOCKS_EXCLUDED(refresh_mutex_);
 
  protected:
   GetResult CachedGetInternal(absl::string_view path) override;
@@ -124,14 +238,131 @@ class TimeBasedCache : public RedfishCachedGetterInterface {
  private:
   struct CacheEntry {
     absl::Time insert_time;
-    absl::StatusOr<RedfishTransport::Result> data;
+    // How long the entry stays fresh after insert_time.
+    absl::Duration max_age;
+    std::shared_ptr<const RedfishTransport::Result> data;
+    // Document parsed from data if its JSON body was left as bytes.
+    std::shared_ptr<const JsonDocument> document;
+    // ETag of the cached response; empty if the service did not send one.
+    std::string etag;
+    // Estimated size of the entry in bytes.
+    size_t bytes = 0;
+    // Position of the entry's path in the shard's lru list.
+    std::list<std::string>::iterator lru_position;
+  };
+  using CacheMap = absl::flat_hash_map<std::string, CacheEntry>;
+
+  // A fetch in progress for a path that missed the cache. Callers missing on
+  // the same path wait for `done` and then share `result`.
+  struct InFlightGet {
+    absl::Notification done;
+    GetResult result;
+  };
+
+  // An independently locked part of the cache holding the paths hashed to it.
+  struct Shard {
+    // Marks an entry as the most recently used.
+    void TouchEntry(CacheEntry &entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+    // Removes an entry along with its LRU and size bookkeeping.
+    void EraseEntry(CacheMap::iterator it) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+
+    mutable absl::Mutex mutex;
+    CacheMap cache ABSL_GUARDED_BY(mutex);
+    // Cached paths ordered from the most to the least recently used.
+    std::list<std::string> lru ABSL_GUARDED_BY(mutex);
+    // Sum of the estimated sizes of all entries.
+    size_t bytes ABSL_GUARDED_BY(mutex) = 0;
+    // Most $levels of expansion of any entry stored so far.
+    size_t max_expand_levels ABSL_GUARDED_BY(mutex) = 0;
+    absl::flat_hash_map<std::string, std::shared_ptr<InFlightGet>> in_flight
+        ABSL_GUARDED_BY(mutex);
+    Stats stats ABSL_GUARDED_BY(mutex);
   };
+
+  // Returns the shard of a path. All the expansions of a resource share the
+  // shard of the resource.
+  Shard &GetShard(absl::string_view path);
+
+  // Returns how long a result fetched for a path stays fresh. A body left as
+  // bytes is only read, through its document if it has one, when the TTL
+  // policy has rules matching the @odata.type of resources.
+  absl::Duration GetMaxAge(absl::string_view path,
+                           const RedfishTransport::Result &result,
+                           const JsonDocument *document) const;
+  // Returns how long an entry is kept before it is purged.
+  absl::Duration GetRetention(const CacheEntry &entry) const;
+
+  // Inserts or replaces the entry of a path, then evicts entries as needed.
+  void PutEntry(Shard &shard, absl::string_view path, CacheEntry entry)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard.mutex);
+  // Inserts the entries read back from the persistent store which are still
+  // worth keeping.
+  void RestoreEntries();
+
+  // Returns a fresh entry of an expanded path with at least as many levels of
+  // expansion as requested by `path`, or nullptr if there is none. A plain
+  // path is covered by any expansion of the same resource.
+  CacheEntry *FindCoveringEntry(Shard &shard, absl::string_view path,
+                                absl::Time now)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard.mutex);
+  // Caches the resources embedded in `json`, part of a response expanded with
+  // `expand_type` and `levels` remaining levels.
+  void StoreEmbeddedResources(const nlohmann::json &json, char expand_type,
+                              size_t levels, absl::Time insert_time);
+  // Caches an embedded resource unless its path has a fresh entry already.
+  void StoreEmbeddedResource(const std::string &path,
+                             const nlohmann::json &json,
+                             absl::Time insert_time);
+
+  // Starts refreshing a path in the background unless a fetch of the path is
+  // already in flight.
+  void StartBackgroundRefresh(Shard &shard, absl::string_view path,
+                              absl::string_view etag)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard.mutex);
+  // Publishes the result of an in-flight fetch to the callers waiting on it.
+  void FinishInFlight(Shard &shard, absl::string_view path,
+                      InFlightGet &in_flight, GetResult result)
+      ABSL_LOCKS_EXCLUDED(shard.mutex);
+
+  // Fetches a path that missed the cache, revalidating the expired entry if
+  // `etag` is non-empty.
+  GetResult FetchForCache(Shard &shard, absl::string_view path,
+                          absl::string_view etag)
+      ABSL_LOCKS_EXCLUDED(shard.mutex);
+
+  // Caches a result fetched from the service if it holds a JSON body, either
+  // parsed or as bytes with a JSON Content-Type.
+  GetResult StoreFreshResult(Shard &shard, absl::string_view path,
+                             absl::StatusOr<RedfishTransport::Result> result)
+      ABSL_LOCKS_EXCLUDED(shard.mutex);
+
+  // Evicts least recently used entries until the shard limits are met.
+  void EvictEntries(Shard &shard) ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard.mutex);
+  // Removes expired entries from all shards if none were purged within the
+  // last default max_age_.
+  void PurgeExpiredEntries(absl::Time now) ABSL_LOCKS_EXCLUDED(purge_mutex_);
+
   RedfishTransport *transport_;
   const Clock *clock_;
   const absl::Duration max_age_;
-  absl::Mutex cache_lock_;
-  absl::flat_hash_map<std::string, CacheEntry> cache_
-      ABSL_GUARDED_BY(cache_lock_);
+  const std::shared_ptr<const CacheTtlPolicy> ttl_policy_;
+  const std::shared_ptr<PersistentCacheStore> store_;
+  const absl::Duration max_stale_;
+  const absl::Duration refresh_ahead_;
+  // Limits applied to each shard; 0 means no limit.
+  const size_t max_shard_entries_;
+  const size_t max_shard_bytes_;
+  std::vector<Shard> shards_;
+  // Guards when the last purge ran; never held together with a shard mutex.
+  absl::Mutex purge_mutex_;
+  absl::Time last_purge_ ABSL_GUARDED_BY(purge_mutex_) = absl::InfinitePast();
+
+  // Number of background refreshes scheduled but not yet completed.
+  absl::Mutex refresh_mutex_;
+  int pending_refreshes_ ABSL_GUARDED_BY(refresh_mutex_) = 0;
+  // Runs background refreshes; null if they are disabled. Declared last so
+  // that it finishes the queued refreshes before the rest of the cache goes.
+  std::unique_ptr<ThreadPool> refresh_pool_;
 };
 
 }  // namespace ecclesia
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/transport/cache_ttl_policy.h"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/redfish/property_definitions.h"
+#include "ecclesia/lib/redfish/transport/cache_policy.pb.h"
+#include "ecclesia/lib/status/macros.h"
+#include "ecclesia/lib/time/proto.h"
+#include "re2/re2.h"
+#include "re2/set.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+namespace {
+
+// Returns the resource type of an @odata.type without its namespace version,
+// for example "Sensor" for "#Sensor.v1_2_0.Sensor".
+absl::string_view ResourceType(absl::string_view odata_type) {
+  absl::ConsumePrefix(&odata_type, "#");
+  return odata_type.substr(0, odata_type.find('.'));
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> CacheTtlPolicy::Create(
+    const CachePolicy &policy) {
+  // The constructor is private, so std::make_unique cannot be used.
+  auto ttl_policy = absl::WrapUnique(new CacheTtlPolicy());
+  for (const CachePolicy::TtlRule &rule : policy.rules()) {
+    size_t index = ttl_policy->max_ages_.size();
+    absl::Duration max_age = absl::InfiniteDuration();
+    if (rule.has_max_age()) {
+      ECCLESIA_ASSIGN_OR_RETURN(max_age,
+                                AbslDurationFromProtoDuration(rule.max_age()));
+      if (max_age < absl::ZeroDuration()) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Cache rule ", index, " has a negative max_age"));
+      }
+    }
+    ttl_policy->max_ages_.push_back(max_age);
+
+    switch (rule.match_case()) {
+      case CachePolicy::TtlRule::kUriRegex: {
+        std::string error;
+        if (ttl_policy->uri_rules_.Add(rule.uri_regex(), &error) < 0) {
+          return absl::InvalidArgumentError(absl::StrCat(
+              "Cache rule ", index, " has an invalid uri_regex: ", error));
+        }
+        ttl_policy->uri_rule_indices_.push_back(index);
+        break;
+      }
+      case CachePolicy::TtlRule::kOdataType:
+        // Only the first rule for a type can ever match.
+        ttl_policy->type_rule_indices_.try_emplace(rule.odata_type(), index);
+        break;
+      default:
+        return absl::InvalidArgumentError(
+            absl::StrCat("Cache rule ", index, " has nothing to match"));
+    }
+  }
+  if (!ttl_policy->uri_rule_indices_.empty() &&
+      !ttl_policy->uri_rules_.Compile()) {
+    return absl::ResourceExhaustedError("Unable to compile the cache rules");
+  }
+  return ttl_policy;
+}
+
+std::optional<absl::Duration> CacheTtlPolicy::GetMaxAge(
+    absl::string_view path, const nlohmann::json &json) const {
+  std::optional<absl::string_view> odata_type;
+  if (!type_rule_indices_.empty() && json.is_object()) {
+    auto it = json.find(PropertyOdataType::Name);
+    if (it != json.end() && it->is_string()) {
+      odata_type = it->get_ref<const std::string &>();
+    }
+  }
+  return GetMaxAgeForType(path, odata_type);
+}
+
+std::optional<absl::Duration> CacheTtlPolicy::GetMaxAgeForType(
+    absl::string_view path, std::optional<absl::string_view> odata_type) const {
+  std::optional<size_t> first_rule;
+  if (!uri_rule_indices_.empty()) {
+    // Rules match the path alone, so that they also apply to the requests
+    // made with query parameters.
+    absl::string_view uri_path = path.substr(0, path.find('?'));
+    std::vector<int> matches;
+    if (uri_rules_.Match(uri_path, &matches)) {
+      for (int match : matches) {
+        size_t index = uri_rule_indices_[match];
+        if (!first_rule.has_value() || index < *first_rule) first_rule = index;
+      }
+    }
+  }
+  if (odata_type.has_value()) {
+    auto it = type_rule_indices_.find(ResourceType(*odata_type));
+    if (it != type_rule_indices_.end() &&
+        (!first_rule.has_value() || it->second < *first_rule)) {
+      first_rule = it->second;
+    }
+  }
+  if (!first_rule.has_value()) return std::nullopt;
+  return max_ages_[*first_rule];
+}
+
+}  // namespace ecclesia
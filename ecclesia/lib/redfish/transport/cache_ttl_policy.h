@@ -0,0 +1,77 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ECCLESIA_LIB_REDFISH_TRANSPORT_CACHE_TTL_POLICY_H_
+#define ECCLESIA_LIB_REDFISH_TRANSPORT_CACHE_TTL_POLICY_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/redfish/transport/cache_policy.pb.h"
+#include "re2/re2.h"
+#include "re2/set.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+
+// Chooses the max age of cached Redfish resources from a CachePolicy.
+//
+// All URI rules are compiled into a single RE2::Set so that a path is matched
+// against every rule in one pass, and @odata.type rules are looked up by hash.
+class CacheTtlPolicy {
+ public:
+  // Compiles a policy, returning an error if a rule is invalid.
+  static absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> Create(
+      const CachePolicy &policy);
+
+  CacheTtlPolicy(const CacheTtlPolicy &) = delete;
+  CacheTtlPolicy &operator=(const CacheTtlPolicy &) = delete;
+
+  // Returns the max age of the first rule matching a resource, or nullopt if
+  // no rule matches it.
+  std::optional<absl::Duration> GetMaxAge(absl::string_view path,
+                                          const nlohmann::json &json) const;
+  // Same as above for a resource with the given @odata.type, if it has one.
+  std::optional<absl::Duration> GetMaxAgeForType(
+      absl::string_view path,
+      std::optional<absl::string_view> odata_type) const;
+
+  // Returns whether some rules match the @odata.type of resources, so that
+  // callers only need to read the type of a resource if this is true.
+  bool HasTypeRules() const { return !type_rule_indices_.empty(); }
+
+ private:
+  CacheTtlPolicy() : uri_rules_(RE2::DefaultOptions, RE2::ANCHOR_BOTH) {}
+
+  // Max age of each rule, in the order of the policy.
+  std::vector<absl::Duration> max_ages_;
+  // Matches URIs, returning indices into uri_rule_indices_.
+  RE2::Set uri_rules_;
+  // Index in max_ages_ of each URI rule added to uri_rules_.
+  std::vector<size_t> uri_rule_indices_;
+  // Index in max_ages_ of the first rule for each resource type.
+  absl::flat_hash_map<std::string, size_t> type_rule_indices_;
+};
+
+}  // namespace ecclesia
+
+#endif  // ECCLESIA_LIB_REDFISH_TRANSPORT_CACHE_TTL_POLICY_H_
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/transport/cache_ttl_policy.h"
+
+#include <memory>
+#include <optional>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/protobuf/parse.h"
+#include "ecclesia/lib/redfish/transport/cache_policy.pb.h"
+#include "ecclesia/lib/testing/status.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Optional;
+
+TEST(CacheTtlPolicyTest, MatchesUriRegex) {
+  CachePolicy policy = ParseTextProtoOrDie(R"pb(
+    rules {
+      uri_regex: "/redfish/v1/Chassis/[^/]+/Sensors/.*"
+      max_age { seconds: 1 }
+    }
+  )pb");
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(policy);
+  ASSERT_THAT(ttl_policy, IsOk());
+
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/1/Sensors/fan0",
+                                       nlohmann::json::object()),
+              Optional(Eq(absl::Seconds(1))));
+  // The whole URI has to match.
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/1/Sensors",
+                                       nlohmann::json::object()),
+              Eq(std::nullopt));
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/1",
+                                       nlohmann::json::object()),
+              Eq(std::nullopt));
+}
+
+TEST(CacheTtlPolicyTest, MatchesUriRegexWithoutQueryString) {
+  CachePolicy policy = ParseTextProtoOrDie(R"pb(
+    rules {
+      uri_regex: "/redfish/v1/Chassis/[^/]+/Sensors"
+      max_age { seconds: 1 }
+    }
+  )pb");
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(policy);
+  ASSERT_THAT(ttl_policy, IsOk());
+
+  EXPECT_THAT((*ttl_policy)->GetMaxAge(
+                  "/redfish/v1/Chassis/1/Sensors?$expand=.($levels=1)",
+                  nlohmann::json::object()),
+              Optional(Eq(absl::Seconds(1))));
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/1/Sensors?",
+                                       nlohmann::json::object()),
+              Optional(Eq(absl::Seconds(1))));
+}
+
+TEST(CacheTtlPolicyTest, MatchesOdataTypeWithoutVersion) {
+  CachePolicy policy = ParseTextProtoOrDie(R"pb(
+    rules {
+      odata_type: "Assembly"
+      max_age { seconds: 3600 }
+    }
+  )pb");
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(policy);
+  ASSERT_THAT(ttl_policy, IsOk());
+
+  EXPECT_THAT((*ttl_policy)
+                  ->GetMaxAge("/redfish/v1/Chassis/1/Assembly",
+                              {{"@odata.type", "#Assembly.v1_3_0.Assembly"}}),
+              Optional(Eq(absl::Hours(1))));
+  EXPECT_THAT(
+      (*ttl_policy)
+          ->GetMaxAge("/redfish/v1/Chassis/1", {{"@odata.type", "#Chassis"}}),
+      Eq(std::nullopt));
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/1/Assembly",
+                                       {{"@odata.type", 5}}),
+              Eq(std::nullopt));
+}
+
+TEST(CacheTtlPolicyTest, MatchesGivenOdataType) {
+  CachePolicy policy = ParseTextProtoOrDie(R"pb(
+    rules {
+      odata_type: "Assembly"
+      max_age { seconds: 3600 }
+    }
+  )pb");
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(policy);
+  ASSERT_THAT(ttl_policy, IsOk());
+
+  EXPECT_TRUE((*ttl_policy)->HasTypeRules());
+  EXPECT_THAT((*ttl_policy)
+                  ->GetMaxAgeForType("/redfish/v1/Chassis/1/Assembly",
+                                     "#Assembly.v1_3_0.Assembly"),
+              Optional(Eq(absl::Hours(1))));
+  EXPECT_THAT((*ttl_policy)
+                  ->GetMaxAgeForType("/redfish/v1/Chassis/1/Assembly",
+                                     std::nullopt),
+              Eq(std::nullopt));
+}
+
+TEST(CacheTtlPolicyTest, UriRulesAreNotTypeRules) {
+  CachePolicy policy = ParseTextProtoOrDie(R"pb(
+    rules {
+      uri_regex: "/redfish/v1/Chassis/.*"
+      max_age { seconds: 1 }
+    }
+  )pb");
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(policy);
+  ASSERT_THAT(ttl_policy, IsOk());
+
+  EXPECT_FALSE((*ttl_policy)->HasTypeRules());
+  EXPECT_THAT(
+      (*ttl_policy)->GetMaxAgeForType("/redfish/v1/Chassis/1", std::nullopt),
+      Optional(Eq(absl::Seconds(1))));
+}
+
+TEST(CacheTtlPolicyTest, FirstMatchingRuleApplies) {
+  CachePolicy policy = ParseTextProtoOrDie(R"pb(
+    rules {
+      uri_regex: "/redfish/v1/Chassis/1/.*"
+      max_age { seconds: 5 }
+    }
+    rules {
+      odata_type: "Sensor"
+      max_age { seconds: 1 }
+    }
+    rules { uri_regex: "/redfish/v1/.*" }
+  )pb");
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(policy);
+  ASSERT_THAT(ttl_policy, IsOk());
+
+  nlohmann::json sensor = {{"@odata.type", "#Sensor.v1_2_0.Sensor"}};
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/1/Sensors/0",
+                                       sensor),
+              Optional(Eq(absl::Seconds(5))));
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/2/Sensors/0",
+                                       sensor),
+              Optional(Eq(absl::Seconds(1))));
+  // A rule without a max_age never expires.
+  EXPECT_THAT((*ttl_policy)->GetMaxAge("/redfish/v1/Chassis/2",
+                                       nlohmann::json::object()),
+              Optional(Eq(absl::InfiniteDuration())));
+}
+
+TEST(CacheTtlPolicyTest, InvalidRulesAreRejected) {
+  EXPECT_THAT(CacheTtlPolicy::Create(ParseTextAsProtoOrDie<CachePolicy>(
+                  R"pb(rules { uri_regex: "/redfish/v1/(" })pb")),
+              IsStatusInvalidArgument());
+  EXPECT_THAT(CacheTtlPolicy::Create(ParseTextAsProtoOrDie<CachePolicy>(
+                  R"pb(rules { max_age { seconds: 1 } })pb")),
+              IsStatusInvalidArgument());
+  EXPECT_THAT(
+      CacheTtlPolicy::Create(ParseTextAsProtoOrDie<CachePolicy>(
+          R"pb(rules {
+                 odata_type: "Sensor"
+                 max_age { seconds: -1 }
+               })pb")),
+      IsStatusInvalidArgument());
+}
+
+}  // namespace
+}  // namespace ecclesia
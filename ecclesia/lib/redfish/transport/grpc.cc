@@ -24,6 +24,7 @@
 #include <string>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "google/protobuf/struct.pb.h"
 #include "absl/base/thread_annotations.h"
@@ -32,8 +33,10 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/interface.h"
 #include "ecclesia/lib/redfish/proto/redfish_v1.grpc.pb.h"
 #include "ecclesia/lib/redfish/proto/redfish_v1.pb.h"
@@ -61,11 +64,13 @@ constexpr absl::string_view kResourceKey = "redfish-resource";
 // https://www.rfc-editor.org/rfc/rfc7230#section-3.2
 // https://www.rfc-editor.org/rfc/rfc6749#section-5.1
 constexpr absl::string_view kHostHeader = "Host";
+constexpr absl::string_view kContentTypeHeader = "Content-Type";
+constexpr absl::string_view kJsonContentType = "application/json";
 
-template <typename RpcFunc>
-absl::StatusOr<RedfishTransport::Result> DoRpc(
+// Builds the request of a REST operation on path with an optional JSON body.
+absl::StatusOr<redfish::v1::Request> MakeRequest(
     absl::string_view path, std::optional<std::string_view> json_str,
-    absl::string_view target_fqdn, GrpcTransportParams params, RpcFunc rpc) {
+    absl::string_view target_fqdn) {
   redfish::v1::Request request;
   request.mutable_headers()->insert(
       {std::string(kHostHeader), std::string(target_fqdn)});
@@ -79,19 +84,22 @@ absl::StatusOr<RedfishTransport::Result> DoRpc(
                                           google::protobuf::util::JsonParseOptions())));
     *request.mutable_json() = request_body;
   }
-  grpc::ClientContext context;
-  context.set_deadline(ToChronoTime(params.clock->Now() + params.timeout));
-
-  ::redfish::v1::Response response;
-  if (grpc::Status status = rpc(context, request, &response); !status.ok()) {
-    return AsAbslStatus(status);
-  }
+  return request;
+}
 
+// Converts the response of a successful RPC into a RedfishTransport result.
+RedfishTransport::Result ResponseToResult(
+    const ::redfish::v1::Response &response, JsonParserBackend json_parser) {
   RedfishTransport::Result ret_result;
   if (response.has_json()) {
     ret_result.body = StructToJson(response.json());
   } else if (response.has_octet_stream()) {
     ret_result.body = GetBytesFromString(response.octet_stream());
+  } else if (response.has_json_str() &&
+             json_parser == JsonParserBackend::kJsonDocument) {
+    ret_result.body = GetBytesFromString(response.json_str());
+    ret_result.headers.insert(
+        {std::string(kContentTypeHeader), std::string(kJsonContentType)});
   } else if (response.has_json_str()) {
     ret_result.body =
         nlohmann::json::parse(response.json_str(), nullptr, false);
@@ -100,6 +108,22 @@ absl::StatusOr<RedfishTransport::Result> DoRpc(
   return ret_result;
 }
 
+template <typename RpcFunc>
+absl::StatusOr<RedfishTransport::Result> DoRpc(
+    absl::string_view path, std::optional<std::string_view> json_str,
+    absl::string_view target_fqdn, GrpcTransportParams params, RpcFunc rpc) {
+  ECCLESIA_ASSIGN_OR_RETURN(redfish::v1::Request request,
+                            MakeRequest(path, json_str, target_fqdn));
+  grpc::ClientContext context;
+  context.set_deadline(ToChronoTime(params.clock->Now() + params.timeout));
+
+  ::redfish::v1::Response response;
+  if (grpc::Status status = rpc(context, request, &response); !status.ok()) {
+    return AsAbslStatus(status);
+  }
+  return ResponseToResult(response, params.json_parser);
+}
+
 // Input could be a tcp_endpoint or a uds_endpoint.
 // endpoint: e.g. "dns:///localhost:80", "unix:///var/run/my.socket"
 absl::string_view EndpointToFqdn(absl::string_view endpoint) {
@@ -232,6 +256,63 @@ class GrpcRedfishTransport : public RedfishTransport {
         });
   }
 
+  // Issues all GETs through the asynchronous stub so that they are in flight
+  // on the channel at the same time.
+  std::vector<absl::StatusOr<Result>> GetMany(
+      absl::Span<const absl::string_view> paths)
+      ABSL_LOCKS_EXCLUDED(mutex_) override {
+    // State of one RPC, which must stay at a fixed address until it completes.
+    struct Call {
+      grpc::ClientContext context;
+      redfish::v1::Request request;
+      ::redfish::v1::Response response;
+      grpc::Status status;
+    };
+    std::vector<absl::StatusOr<Result>> results(
+        paths.size(), absl::UnknownError("RPC did not complete"));
+    std::vector<std::unique_ptr<Call>> calls(paths.size());
+    absl::BlockingCounter pending(static_cast<int>(paths.size()));
+    {
+      absl::ReaderMutexLock mu(&mutex_);
+      for (size_t i = 0; i < paths.size(); ++i) {
+        absl::StatusOr<redfish::v1::Request> request =
+            MakeRequest(paths[i], std::nullopt, fqdn_);
+        if (!request.ok()) {
+          results[i] = request.status();
+          pending.DecrementCount();
+          continue;
+        }
+        calls[i] = std::make_unique<Call>();
+        Call &call = *calls[i];
+        call.request = *std::move(request);
+        call.context.set_deadline(
+            ToChronoTime(params_.clock->Now() + params_.timeout));
+        call.context.set_credentials(
+            grpc::experimental::MetadataCredentialsFromPlugin(
+                std::unique_ptr<grpc::MetadataCredentialsPlugin>(
+                    std::make_unique<GrpcRedfishCredentials>(fqdn_,
+                                                             paths[i])),
+                GRPC_SECURITY_NONE));
+        client_->async()->Get(&call.context, &call.request, &call.response,
+                              [&call, &pending](grpc::Status status) {
+                                call.status = std::move(status);
+                                pending.DecrementCount();
+                              });
+      }
+    }
+    pending.Wait();
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (calls[i] == nullptr) continue;
+      if (!calls[i]->status.ok()) {
+        results[i] = AsAbslStatus(calls[i]->status);
+      } else {
+        results[i] =
+            ResponseToResult(calls[i]->response, params_.json_parser);
+      }
+    }
+    return results;
+  }
+
  private:
   absl::Mutex mutex_;
   std::unique_ptr<::redfish::v1::RedfishV1::Stub> client_
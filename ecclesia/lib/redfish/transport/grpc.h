@@ -33,6 +33,10 @@ struct GrpcTransportParams {
   Clock *clock = Clock::RealClock();
   // Timeout used for all operations.
   absl::Duration timeout = absl::Seconds(40);
+  // Parser for JSON bodies received as strings. With kJsonDocument they are
+  // returned as bytes with an "application/json" Content-Type header, to be
+  // parsed by an interface using the same backend.
+  JsonParserBackend json_parser = JsonParserBackend::kNlohmann;
 };
 
 absl::StatusOr<std::unique_ptr<RedfishTransport>> CreateGrpcRedfishTransport(
@@ -20,6 +20,7 @@
 #include <optional>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "google/protobuf/struct.pb.h"
 #include "gmock/gmock.h"
@@ -48,7 +49,9 @@ namespace ecclesia {
 namespace {
 
 using ::redfish::v1::Response;
+using ::testing::Contains;
 using ::testing::Eq;
+using ::testing::Pair;
 
 TEST(GrpcRedfishTransport, Get) {
   absl::flat_hash_map<std::string, std::string> headers;
@@ -86,6 +89,30 @@ TEST(GrpcRedfishTransport, Get) {
   EXPECT_THAT(res_get->code, Eq(200));
 }
 
+TEST(GrpcRedfishTransport, GetMany) {
+  GrpcDynamicMockupServer mockup_server("barebones_session_auth/mockup.shar",
+                                        "localhost", 0);
+  StaticBufferBasedTlsOptions options;
+  options.SetToInsecure();
+  auto port = mockup_server.Port();
+  ASSERT_TRUE(port.has_value());
+  auto transport = CreateGrpcRedfishTransport(
+      absl::StrCat("localhost:", *port), {}, options.GetChannelCredentials());
+  ASSERT_THAT(transport, IsOk());
+  std::vector<absl::string_view> paths = {"/redfish/v1", "/redfish/v1/Chassis",
+                                          "/redfish/v1/Chassis/chassis"};
+  std::vector<absl::StatusOr<RedfishTransport::Result>> results =
+      (*transport)->GetMany(paths);
+  ASSERT_THAT(results.size(), Eq(paths.size()));
+  for (size_t i = 0; i < paths.size(); ++i) {
+    ASSERT_THAT(results[i], IsOk());
+    EXPECT_THAT(results[i]->code, Eq(200));
+    ASSERT_TRUE(std::holds_alternative<nlohmann::json>(results[i]->body));
+    EXPECT_THAT(std::get<nlohmann::json>(results[i]->body)["@odata.id"],
+                Eq(paths[i]));
+  }
+}
+
 TEST(GrpcRedfishTransport, PostPatchGetDelete) {
   absl::flat_hash_map<std::string, std::string> headers;
   GrpcDynamicMockupServer mockup_server("barebones_session_auth/mockup.shar",
@@ -347,5 +374,39 @@ TEST(GrpcRedfishTransport, GetCorrectResultBodyAndRequestHeaders) {
   EXPECT_THAT(result->code, Eq(200));
 }
 
+TEST(GrpcRedfishTransport, KeepsJsonStrAsBytesForJsonDocuments) {
+  GrpcDynamicMockupServer mockup_server("barebones_session_auth/mockup.shar",
+                                        "localhost", 0);
+  StaticBufferBasedTlsOptions options;
+  options.SetToInsecure();
+  auto port = mockup_server.Port();
+  ASSERT_TRUE(port.has_value());
+  GrpcTransportParams params;
+  params.json_parser = JsonParserBackend::kJsonDocument;
+  auto transport = CreateGrpcRedfishTransport(
+      absl::StrCat("localhost:", *port), params,
+      options.GetChannelCredentials());
+  ASSERT_THAT(transport, IsOk());
+
+  std::string json_str = R"json({"@odata.id": "/redfish/v1/json_str"})json";
+  mockup_server.AddHttpGetHandler(
+      "/redfish/v1/json_str",
+      [&](grpc::ServerContext *context, const ::redfish::v1::Request *request,
+          Response *response) {
+        *response->mutable_json_str() = json_str;
+        response->set_code(200);
+        return grpc::Status::OK;
+      });
+  auto result = (*transport)->Get("/redfish/v1/json_str");
+  ASSERT_THAT(result, IsOk());
+  ASSERT_TRUE(std::holds_alternative<RedfishTransport::bytes>(result->body));
+  EXPECT_THAT(RedfishTransportBytesToString(
+                  std::get<RedfishTransport::bytes>(result->body)),
+              Eq(json_str));
+  EXPECT_THAT(result->headers,
+              Contains(Pair("Content-Type", "application/json")));
+  EXPECT_THAT(result->code, Eq(200));
+}
+
 }  // namespace
 }  // namespace ecclesia
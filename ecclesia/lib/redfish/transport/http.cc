@@ -20,10 +20,11 @@
 #include <string>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
-#include "absl/functional/bind_front.h"
+#include "absl/log/log.h"
 #include "absl/memory/memory.h"
 #include "absl/meta/type_traits.h"
 #include "absl/status/status.h"
@@ -32,6 +33,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/http/client.h"
 #include "ecclesia/lib/redfish/interface.h"
 #include "ecclesia/lib/redfish/property_definitions.h"
@@ -50,23 +52,27 @@ constexpr absl::string_view kUdsDummyEndpoint = "dummy";
 // Headers used for session authentication, as defined in the Redfish spec.
 constexpr absl::string_view kXAuthToken = "X-Auth-Token";
 constexpr absl::string_view kLocation = "Location";
-
-// Generic helper function for all REST operations.
-// RestOp is a functor which invokes the relevant REST operation.
-template <typename RestOp>
-absl::StatusOr<RedfishTransport::Result> RestHelper(
-    std::unique_ptr<HttpClient::HttpRequest> request, RestOp rest_func,
-    const HttpHeaderCondition &header_for_json) {
+constexpr absl::string_view kIfNoneMatch = "If-None-Match";
+// HTTP status returned when the session token is missing or no longer valid.
+constexpr int kUnauthorized = 401;
+
+// Converts the response of an HTTP request into a RedfishTransport result.
+absl::StatusOr<RedfishTransport::Result> ResponseToResult(
+    absl::StatusOr<HttpClient::HttpResponse> response,
+    const HttpHeaderCondition &header_for_json,
+    JsonParserBackend json_parser) {
   ECCLESIA_ASSIGN_OR_RETURN(HttpClient::HttpResponse resp,
-                            rest_func(std::move(request)));
+                            std::move(response));
   RedfishTransport::Result result;
   result.code = resp.code;
   result.headers = std::move(resp.headers);
   // Determine whether to represent the body as JSON or bytes based on the
   // conditions of headers. If there are any headers meeting the specific
   // condition, set the body as JSON. Otherwise, set the body as the bytes.
+  // JSON is also left as bytes if the interface parses it into JsonDocuments.
   auto header_iter = result.headers.find(header_for_json.header_key);
-  if (header_iter != result.headers.end() &&
+  if (json_parser == JsonParserBackend::kNlohmann &&
+      header_iter != result.headers.end() &&
       header_for_json.matched_values.contains(header_iter->second)) {
     result.body = resp.GetBodyJson();
   } else {
@@ -76,6 +82,24 @@ absl::StatusOr<RedfishTransport::Result> RestHelper(
   return result;
 }
 
+// Generic helper function for all REST operations. Invokes the HttpClient
+// method matching the given protocol.
+absl::StatusOr<HttpClient::HttpResponse> RestHelper(
+    HttpClient &client, Protocol cmd,
+    std::unique_ptr<HttpClient::HttpRequest> request) {
+  switch (cmd) {
+    case Protocol::kGet:
+      return client.Get(std::move(request));
+    case Protocol::kPost:
+      return client.Post(std::move(request));
+    case Protocol::kDelete:
+      return client.Delete(std::move(request));
+    case Protocol::kPatch:
+      return client.Patch(std::move(request));
+  }
+  return absl::InvalidArgumentError("Unexpected value for Protocol");
+}
+
 // Helper function for retrieving the POST target to the SessionService.
 // The Redfish Spec suggests 2 options:
 // 1. via the @odata.id reference in Links.Sessions
@@ -109,44 +133,75 @@ absl::StatusOr<std::string> GetSessionServicePostTarget(nlohmann::json root) {
 }  // namespace
 
 HttpRedfishTransport::~HttpRedfishTransport() {
-  absl::MutexLock mu(&mutex_);
+  absl::MutexLock mu(&auth_mutex_);
   EndCurrentSession();
 }
 
+std::shared_ptr<const HttpRedfishTransport::Session>
+HttpRedfishTransport::GetSession() const {
+  absl::ReaderMutexLock mu(&session_mutex_);
+  return session_;
+}
+
+void HttpRedfishTransport::PublishSession(
+    std::shared_ptr<const Session> session) {
+  // Swap under the lock but let the previous session be released outside it.
+  absl::MutexLock mu(&session_mutex_);
+  session_.swap(session);
+}
+
 void HttpRedfishTransport::EndCurrentSession() {
-  if (!session_auth_uri_.empty()) {
-    LockedDelete(session_auth_uri_, "").IgnoreError();
+  std::shared_ptr<const Session> session = GetSession();
+  if (!session->session_uri.empty()) {
+    DoRequest(Protocol::kDelete, session->session_uri, "", *session)
+        .IgnoreError();
   }
-  session_auth_uri_.clear();
-  x_auth_token_.clear();
+  PublishSession(std::make_shared<const Session>());
 }
 
 absl::Status HttpRedfishTransport::DoSessionAuth(std::string username,
                                                  std::string password) {
-  absl::MutexLock mu(&mutex_);
+  absl::MutexLock mu(&auth_mutex_);
   EndCurrentSession();
   session_username_ = std::move(username);
   session_password_ = std::move(password);
-  return LockedDoSessionAuth();
+  ECCLESIA_ASSIGN_OR_RETURN(std::shared_ptr<const Session> session,
+                            EstablishSession());
+  PublishSession(std::move(session));
+  return absl::OkStatus();
 }
 
-absl::Status HttpRedfishTransport::LockedDoSessionAuth() {
+absl::StatusOr<std::shared_ptr<const HttpRedfishTransport::Session>>
+HttpRedfishTransport::EstablishSession() {
   if (session_username_.empty() && session_password_.empty()) {
-    return absl::OkStatus();
+    return std::make_shared<const Session>();
   }
-  ECCLESIA_ASSIGN_OR_RETURN(Result root, LockedGet(GetRootUri()));
-  if (!std::holds_alternative<nlohmann::json>(root.body)) {
+  // The session is being replaced, so the requests to establish it are sent
+  // without any token.
+  const Session no_session;
+  ECCLESIA_ASSIGN_OR_RETURN(
+      Result root, DoRequest(Protocol::kGet, GetRootUri(), "", no_session));
+  // The body is left as bytes if the header condition for JSON does not match
+  // the response, e.g. for callers parsing payloads themselves.
+  nlohmann::json root_json;
+  if (auto *json = std::get_if<nlohmann::json>(&root.body)) {
+    root_json = std::move(*json);
+  } else {
+    const auto &bytes = std::get<RedfishTransport::bytes>(root.body);
+    root_json = nlohmann::json::parse(bytes.begin(), bytes.end(), nullptr,
+                                      /*allow_exceptions=*/false);
+  }
+  if (!root_json.is_object()) {
     return absl::InternalError("Result from the root URI is not JSON");
   }
-  ECCLESIA_ASSIGN_OR_RETURN(
-      std::string post_uri,
-      GetSessionServicePostTarget(std::get<nlohmann::json>(root.body)));
+  ECCLESIA_ASSIGN_OR_RETURN(std::string post_uri,
+                            GetSessionServicePostTarget(std::move(root_json)));
 
   nlohmann::json session_post_payload;
   session_post_payload[PropertyUserName::Name] = session_username_;
   session_post_payload[PropertyPassword::Name] = session_password_;
-  absl::StatusOr<Result> session_post =
-      LockedPost(post_uri, session_post_payload.dump());
+  absl::StatusOr<Result> session_post = DoRequest(
+      Protocol::kPost, post_uri, session_post_payload.dump(), no_session);
   if (!session_post.ok()) {
     return absl::InternalError(absl::StrCat("Could not establish session: ",
                                             session_post.status().message()));
@@ -159,31 +214,48 @@ absl::Status HttpRedfishTransport::LockedDoSessionAuth() {
   if (session_uri == session_post->headers.end()) {
     return absl::InternalError("No session URI returned for POST.");
   }
-  session_auth_uri_ = std::move(session_uri->second);
-  x_auth_token_ = std::move(token->second);
+  auto session = std::make_shared<Session>();
+  session->session_uri = std::move(session_uri->second);
+  session->x_auth_token = std::move(token->second);
+  return session;
+}
 
-  return absl::OkStatus();
+absl::StatusOr<std::shared_ptr<const HttpRedfishTransport::Session>>
+HttpRedfishTransport::RefreshSession(
+    const std::shared_ptr<const Session> &stale) {
+  absl::MutexLock mu(&auth_mutex_);
+  std::shared_ptr<const Session> current = GetSession();
+  if (current != stale) return current;
+  if (session_username_.empty() && session_password_.empty()) return current;
+  // The rejected session is already gone on the service side, so it is
+  // replaced without sending a DELETE for it.
+  ECCLESIA_ASSIGN_OR_RETURN(std::shared_ptr<const Session> session,
+                            EstablishSession());
+  PublishSession(session);
+  return session;
 }
 
 std::unique_ptr<HttpClient::HttpRequest> HttpRedfishTransport::MakeRequest(
-    TcpTarget target, absl::string_view path, absl::string_view data) {
+    const TcpTarget &target, absl::string_view path, absl::string_view data,
+    const Session &session) {
   auto request = std::make_unique<HttpClient::HttpRequest>();
   request->uri = absl::StrCat(target.endpoint, path);
   request->body = std::string(data);
-  if (!x_auth_token_.empty()) {
-    request->headers[kXAuthToken] = x_auth_token_;
+  if (!session.x_auth_token.empty()) {
+    request->headers[kXAuthToken] = session.x_auth_token;
   }
   return request;
 }
 
 std::unique_ptr<HttpClient::HttpRequest> HttpRedfishTransport::MakeRequest(
-    UdsTarget target, absl::string_view path, absl::string_view data) {
+    const UdsTarget &target, absl::string_view path, absl::string_view data,
+    const Session &session) {
   auto request = std::make_unique<HttpClient::HttpRequest>();
   request->uri = absl::StrCat(kUdsDummyEndpoint, path);
   request->body = std::string(data);
   request->unix_socket_path = target.path;
-  if (!x_auth_token_.empty()) {
-    request->headers[kXAuthToken] = x_auth_token_;
+  if (!session.x_auth_token.empty()) {
+    request->headers[kXAuthToken] = session.x_auth_token;
   }
   return request;
 }
@@ -191,92 +263,139 @@ std::unique_ptr<HttpClient::HttpRequest> HttpRedfishTransport::MakeRequest(
 HttpRedfishTransport::HttpRedfishTransport(
     std::unique_ptr<HttpClient> client,
     std::variant<TcpTarget, UdsTarget> target,
-    HttpHeaderCondition header_for_json)
+    HttpHeaderCondition header_for_json, JsonParserBackend json_parser)
     : client_(std::move(client)),
       target_(std::move(target)),
-      header_for_json_payload_(std::move(header_for_json)) {}
+      session_(std::make_shared<const Session>()),
+      header_for_json_payload_(std::move(header_for_json)),
+      json_parser_(json_parser) {}
 
 std::unique_ptr<HttpRedfishTransport> HttpRedfishTransport::MakeNetwork(
     std::unique_ptr<HttpClient> client, std::string endpoint,
-    HttpHeaderCondition header_for_json) {
+    HttpHeaderCondition header_for_json, JsonParserBackend json_parser) {
   return absl::WrapUnique(new HttpRedfishTransport(
       std::move(client), TcpTarget{std::move(endpoint)},
-      std::move(header_for_json)));
+      std::move(header_for_json), json_parser));
 }
 
 std::unique_ptr<HttpRedfishTransport> HttpRedfishTransport::MakeUds(
     std::unique_ptr<HttpClient> client, std::string unix_domain_socket,
-    HttpHeaderCondition header_for_json) {
+    HttpHeaderCondition header_for_json, JsonParserBackend json_parser) {
   return absl::WrapUnique(new HttpRedfishTransport(
       std::move(client), UdsTarget{std::string(std::move(unix_domain_socket))},
-      std::move(header_for_json)));
+      std::move(header_for_json), json_parser));
 }
 
 absl::string_view HttpRedfishTransport::GetRootUri() {
   return RedfishInterface::ServiceRootToUri(ServiceRootUri::kRedfish);
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Get(
-    absl::string_view path) {
-  absl::MutexLock mu(&mutex_);
-  return LockedGet(path);
+absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::DoRequest(
+    Protocol cmd, absl::string_view path, absl::string_view data,
+    const Session &session, const HttpClient::HttpHeaders &extra_headers) {
+  std::unique_ptr<HttpClient::HttpRequest> request = std::visit(
+      [&](const auto &t) { return MakeRequest(t, path, data, session); },
+      target_);
+  request->headers.insert(extra_headers.begin(), extra_headers.end());
+  return ResponseToResult(RestHelper(*client_, cmd, std::move(request)),
+                          header_for_json_payload_, json_parser_);
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::LockedGet(
-    absl::string_view path) {
-  return RestHelper(std::visit([&](const auto &t) ABSL_SHARED_LOCKS_REQUIRED(
-                                   mutex_) { return MakeRequest(t, path, ""); },
-                               target_),
-                    absl::bind_front(&HttpClient::Get, client_.get()),
-                    header_for_json_payload_);
+absl::StatusOr<RedfishTransport::Result>
+HttpRedfishTransport::DoRequestWithRetry(
+    Protocol cmd, absl::string_view path, absl::string_view data,
+    const HttpClient::HttpHeaders &extra_headers) {
+  std::shared_ptr<const Session> session = GetSession();
+  absl::StatusOr<Result> result =
+      DoRequest(cmd, path, data, *session, extra_headers);
+  if (!result.ok() || result->code != kUnauthorized) return result;
+  // Callers still get the 401 response if the session cannot be refreshed.
+  absl::StatusOr<std::shared_ptr<const Session>> refreshed =
+      RefreshSession(session);
+  if (!refreshed.ok()) {
+    LOG(WARNING) << "Failed to refresh session: " << refreshed.status();
+    return result;
+  }
+  if (*refreshed == session) return result;
+  return DoRequest(cmd, path, data, **refreshed, extra_headers);
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Post(
-    absl::string_view path, absl::string_view data) {
-  absl::MutexLock mu(&mutex_);
-  return LockedPost(path, data);
+absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Get(
+    absl::string_view path) {
+  return DoRequestWithRetry(Protocol::kGet, path, "");
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::LockedPost(
-    absl::string_view path, absl::string_view data) {
-  return RestHelper(
-      std::visit([&](const auto &t) ABSL_SHARED_LOCKS_REQUIRED(
-                     mutex_) { return MakeRequest(t, path, data); },
-                 target_),
-      absl::bind_front(&HttpClient::Post, client_.get()),
-      header_for_json_payload_);
+absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::GetIfNoneMatch(
+    absl::string_view path, absl::string_view etag) {
+  return DoRequestWithRetry(Protocol::kGet, path, "",
+                            {{std::string(kIfNoneMatch), std::string(etag)}});
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Patch(
-    absl::string_view path, absl::string_view data) {
-  absl::MutexLock mu(&mutex_);
-  return LockedPatch(path, data);
+std::vector<absl::StatusOr<RedfishTransport::Result>>
+HttpRedfishTransport::GetMany(absl::Span<const absl::string_view> paths) {
+  std::shared_ptr<const Session> session = GetSession();
+  auto send_batch = [&](absl::Span<const absl::string_view> batch_paths,
+                        const Session &batch_session) {
+    std::vector<std::unique_ptr<HttpClient::HttpRequest>> requests;
+    requests.reserve(batch_paths.size());
+    for (absl::string_view path : batch_paths) {
+      requests.push_back(std::visit(
+          [&](const auto &t) {
+            return MakeRequest(t, path, "", batch_session);
+          },
+          target_));
+    }
+    std::vector<absl::StatusOr<HttpClient::HttpResponse>> responses =
+        client_->ExecuteBatch(Protocol::kGet, std::move(requests));
+    std::vector<absl::StatusOr<Result>> results;
+    results.reserve(responses.size());
+    for (absl::StatusOr<HttpClient::HttpResponse> &response : responses) {
+      results.push_back(ResponseToResult(std::move(response),
+                                         header_for_json_payload_,
+                                         json_parser_));
+    }
+    return results;
+  };
+  std::vector<absl::StatusOr<Result>> results = send_batch(paths, *session);
+
+  // Retry the requests rejected with 401 once, as a single batch.
+  std::vector<size_t> rejected;
+  std::vector<absl::string_view> rejected_paths;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (results[i].ok() && results[i]->code == kUnauthorized) {
+      rejected.push_back(i);
+      rejected_paths.push_back(paths[i]);
+    }
+  }
+  if (rejected.empty()) return results;
+  absl::StatusOr<std::shared_ptr<const Session>> refreshed =
+      RefreshSession(session);
+  if (!refreshed.ok()) {
+    LOG(WARNING) << "Failed to refresh session: " << refreshed.status();
+    return results;
+  }
+  if (*refreshed == session) return results;
+  std::vector<absl::StatusOr<Result>> retried =
+      send_batch(rejected_paths, **refreshed);
+  for (size_t i = 0; i < rejected.size(); ++i) {
+    results[rejected[i]] = std::move(retried[i]);
+  }
+  return results;
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::LockedPatch(
+absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Post(
     absl::string_view path, absl::string_view data) {
-  return RestHelper(
-      std::visit([&](const auto &t) ABSL_SHARED_LOCKS_REQUIRED(
-                     mutex_) { return MakeRequest(t, path, data); },
-                 target_),
-      absl::bind_front(&HttpClient::Patch, client_.get()),
-      header_for_json_payload_);
+  return DoRequestWithRetry(Protocol::kPost, path, data);
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Delete(
+absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Patch(
     absl::string_view path, absl::string_view data) {
-  absl::MutexLock mu(&mutex_);
-  return LockedDelete(path, data);
+  return DoRequestWithRetry(Protocol::kPatch, path, data);
 }
 
-absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::LockedDelete(
+absl::StatusOr<RedfishTransport::Result> HttpRedfishTransport::Delete(
     absl::string_view path, absl::string_view data) {
-  return RestHelper(
-      std::visit([&](const auto &t) ABSL_SHARED_LOCKS_REQUIRED(
-                     mutex_) { return MakeRequest(t, path, data); },
-                 target_),
-      absl::bind_front(&HttpClient::Delete, client_.get()),
-      header_for_json_payload_);
+  return DoRequestWithRetry(Protocol::kDelete, path, data);
 }
 
 }  // namespace ecclesia
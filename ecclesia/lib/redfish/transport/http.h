@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_set.h"
@@ -27,6 +28,7 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/http/client.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 
@@ -55,42 +57,60 @@ class HttpRedfishTransport : public RedfishTransport {
   // Params:
   //   client: HttpClient instance
   //   tcp_endpoint: e.g. "localhost:80", "https://10.0.0.1", "[::1]:8000"
+  //   header_for_json: condition for a body to be JSON
+  //   json_parser: with kJsonDocument, JSON bodies are left as bytes
   static std::unique_ptr<HttpRedfishTransport> MakeNetwork(
       std::unique_ptr<HttpClient> client, std::string tcp_endpoint,
-      HttpHeaderCondition header_for_json =
-          DefaultHttpHeaderConditionForJson());
+      HttpHeaderCondition header_for_json = DefaultHttpHeaderConditionForJson(),
+      JsonParserBackend json_parser = JsonParserBackend::kNlohmann);
   // Creates an HttpRedfishTransport using a unix domain socket endpoint.
   // Params:
   //   client: HttpClient instance
   //   unix_domain_socket: e.g. "/var/run/my.socket"
+  //   header_for_json: condition for a body to be JSON
+  //   json_parser: with kJsonDocument, JSON bodies are left as bytes
   static std::unique_ptr<HttpRedfishTransport> MakeUds(
       std::unique_ptr<HttpClient> client, std::string unix_domain_socket,
-      HttpHeaderCondition header_for_json =
-          DefaultHttpHeaderConditionForJson());
+      HttpHeaderCondition header_for_json = DefaultHttpHeaderConditionForJson(),
+      JsonParserBackend json_parser = JsonParserBackend::kNlohmann);
   // Performs the Redfish Session Login Authorization procedure, as documented
   // in the Redfish Spec (DSP0266 Redfish Specification v1.14.0 Section 13.3.4:
   // Redfish session login authentication).
   // This method is declared only in HttpRedfishTransport and not the general
   // RedfishTransport as the mechanism requires sending X-Auth-Tokens in HTTP
   // headers and therefore is not generalizable to all transport types.
+  //
+  // Once a session is established, a request answered with 401 Unauthorized
+  // re-establishes the session with the same credentials and is retried once.
   absl::Status DoSessionAuth(std::string username, std::string password)
-      ABSL_LOCKS_EXCLUDED(mutex_);
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_);
 
   // Destructor needs to close any open sessions if applicable.
-  ~HttpRedfishTransport() ABSL_LOCKS_EXCLUDED(mutex_) override;
+  ~HttpRedfishTransport() ABSL_LOCKS_EXCLUDED(auth_mutex_) override;
 
   // Returns the path of the root URI for the Redfish service this transport is
   // connected to.
   absl::string_view GetRootUri() override;
 
   absl::StatusOr<Result> Get(absl::string_view path)
-      ABSL_LOCKS_EXCLUDED(mutex_) override;
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_) override;
   absl::StatusOr<Result> Post(absl::string_view path, absl::string_view data)
-      ABSL_LOCKS_EXCLUDED(mutex_) override;
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_) override;
   absl::StatusOr<Result> Patch(absl::string_view path, absl::string_view data)
-      ABSL_LOCKS_EXCLUDED(mutex_) override;
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_) override;
   absl::StatusOr<Result> Delete(absl::string_view path, absl::string_view data)
-      ABSL_LOCKS_EXCLUDED(mutex_) override;
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_) override;
+
+  // Sends the GET with an If-None-Match header carrying `etag`.
+  absl::StatusOr<Result> GetIfNoneMatch(absl::string_view path,
+                                        absl::string_view etag)
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_) override;
+
+  // Issues all GETs as one batch through HttpClient::ExecuteBatch, so they
+  // run concurrently if the client supports asynchronous requests.
+  std::vector<absl::StatusOr<Result>> GetMany(
+      absl::Span<const absl::string_view> paths)
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_) override;
 
  private:
   // Simple struct wrappers to define a TCP endpoint or a UDS endpoint.
@@ -101,58 +121,90 @@ class HttpRedfishTransport : public RedfishTransport {
     std::string path;
   };
 
-  // Internal REST methods to be called while holding the mutex.
-  absl::StatusOr<Result> LockedGet(absl::string_view path)
-      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
-  absl::StatusOr<Result> LockedPost(absl::string_view path,
-                                    absl::string_view data)
-      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
-  absl::StatusOr<Result> LockedPatch(absl::string_view path,
-                                     absl::string_view data)
-      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
-  absl::StatusOr<Result> LockedDelete(absl::string_view path,
-                                      absl::string_view data)
-      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+  // The state of an established session. A Session is never modified after
+  // it is published; re-authentication publishes a new one instead, so a
+  // request can keep using its snapshot without holding any lock.
+  struct Session {
+    // The X-Auth-Token to be used in HTTP request headers.
+    std::string x_auth_token;
+    // The session URI that stores our session state.
+    std::string session_uri;
+  };
 
+  // Returns a snapshot of the current session. Never returns null.
+  std::shared_ptr<const Session> GetSession() const
+      ABSL_LOCKS_EXCLUDED(session_mutex_);
+  // Replaces the current session. Requests already in flight keep the session
+  // they started with.
+  void PublishSession(std::shared_ptr<const Session> session)
+      ABSL_LOCKS_EXCLUDED(session_mutex_);
+
+  // Sends a single request authenticated with the given session. Any
+  // extra_headers are added to the request.
+  absl::StatusOr<Result> DoRequest(
+      Protocol cmd, absl::string_view path, absl::string_view data,
+      const Session &session,
+      const HttpClient::HttpHeaders &extra_headers = {});
+  // Sends a request with the current session. If the service answers 401, the
+  // session is refreshed and the request is retried once.
+  absl::StatusOr<Result> DoRequestWithRetry(
+      Protocol cmd, absl::string_view path, absl::string_view data,
+      const HttpClient::HttpHeaders &extra_headers = {})
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_);
+
+  // Re-establishes the session after `stale` was rejected by the service, and
+  // returns the session to retry with. If another thread has already replaced
+  // `stale`, its session is returned without authenticating again. Returns
+  // `stale` itself if there are no credentials to re-authenticate with.
+  absl::StatusOr<std::shared_ptr<const Session>> RefreshSession(
+      const std::shared_ptr<const Session> &stale)
+      ABSL_LOCKS_EXCLUDED(auth_mutex_, session_mutex_);
   // Actually perform the session auth procedure using member variables.
-  absl::Status LockedDoSessionAuth() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  absl::StatusOr<std::shared_ptr<const Session>> EstablishSession()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(auth_mutex_);
   // Log out of the current session by sending HTTP DELETE on the session URI.
-  void EndCurrentSession() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EndCurrentSession() ABSL_EXCLUSIVE_LOCKS_REQUIRED(auth_mutex_);
 
   // Private constructor for creating a transport with a client and target.
   // The public Make* functions should be used instead to avoid exposing the
   // internal target structs in the public interface.
   HttpRedfishTransport(std::unique_ptr<HttpClient> client,
                        std::variant<TcpTarget, UdsTarget> target,
-                       HttpHeaderCondition header_for_json);
+                       HttpHeaderCondition header_for_json,
+                       JsonParserBackend json_parser);
 
   // Helper function for creating a HTTP request, overloaded on the target type.
-  std::unique_ptr<HttpClient::HttpRequest> MakeRequest(TcpTarget target,
-                                                       absl::string_view path,
-                                                       absl::string_view data)
-      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
-  std::unique_ptr<HttpClient::HttpRequest> MakeRequest(UdsTarget target,
-                                                       absl::string_view path,
-                                                       absl::string_view data)
-      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
-
-  absl::Mutex mutex_;
-  std::unique_ptr<HttpClient> client_ ABSL_GUARDED_BY(mutex_);
-  std::variant<TcpTarget, UdsTarget> target_ ABSL_GUARDED_BY(mutex_);
-
+  static std::unique_ptr<HttpClient::HttpRequest> MakeRequest(
+      const TcpTarget &target, absl::string_view path, absl::string_view data,
+      const Session &session);
+  static std::unique_ptr<HttpClient::HttpRequest> MakeRequest(
+      const UdsTarget &target, absl::string_view path, absl::string_view data,
+      const Session &session);
+
+  // The client and target are fixed at construction. The client must support
+  // concurrent requests, as requests are sent without holding any lock.
+  const std::unique_ptr<HttpClient> client_;
+  const std::variant<TcpTarget, UdsTarget> target_;
+
+  // Serializes establishing and ending sessions. Plain requests never take
+  // this lock; only DoSessionAuth and the retry path after a 401 do.
+  absl::Mutex auth_mutex_ ABSL_ACQUIRED_BEFORE(session_mutex_);
   // Session auth parameters.
   // Save the username and password in case we need to re-establish a session.
-  std::string session_username_ ABSL_GUARDED_BY(mutex_);
-  std::string session_password_ ABSL_GUARDED_BY(mutex_);
-  // The X-Auth-Token to be used in HTTP request headers.
-  std::string x_auth_token_ ABSL_GUARDED_BY(mutex_);
-  // The session URI that stores our session state.
-  std::string session_auth_uri_ ABSL_GUARDED_BY(mutex_);
+  std::string session_username_ ABSL_GUARDED_BY(auth_mutex_);
+  std::string session_password_ ABSL_GUARDED_BY(auth_mutex_);
+
+  // Guards only the swap of the current session pointer; it is never held
+  // across a request.
+  mutable absl::Mutex session_mutex_;
+  std::shared_ptr<const Session> session_ ABSL_GUARDED_BY(session_mutex_);
 
   // This stores the header condition based which the payload is set to JSON,
   // i.e., If there's such header and the header value matches any of the values
   // in the condition, the payload is set to JSON.
   const HttpHeaderCondition header_for_json_payload_;
+  // Whether JSON payloads are parsed here or left as bytes for the interface.
+  const JsonParserBackend json_parser_;
 };
 
 }  // namespace ecclesia
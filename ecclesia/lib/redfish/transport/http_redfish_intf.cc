@@ -16,6 +16,7 @@
 
 #include "ecclesia/lib/redfish/transport/http_redfish_intf.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -36,23 +37,27 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
-#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "ecclesia/lib/http/codes.h"
 #include "ecclesia/lib/redfish/interface.h"
+#include "ecclesia/lib/redfish/json_document.h"
 #include "ecclesia/lib/redfish/json_ptr.h"
 #include "ecclesia/lib/redfish/property_definitions.h"
 #include "ecclesia/lib/redfish/transport/cache.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 #include "ecclesia/lib/redfish/utils.h"
+#include "ecclesia/lib/thread/thread_pool.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
 namespace {
 
+// Number of threads shared by the fetches of all prefetched iterables.
+constexpr int kPrefetchThreads = 16;
+
 // Represents whether the data in a RedfishVariant originated from a backend
 // or from a cached copy.
 enum CacheState {
@@ -127,89 +132,229 @@ nlohmann::json KvSpanToJson(
   return json;
 }
 
+// The HttpIntf implementations below are templates over the representation of
+// the payload they navigate. A node type provides:
+//   code(): the HTTP code of the response the node belongs to.
+//   is_json(): whether the response body holds a JSON payload.
+//   is_object(), is_array(): the type of the node.
+//   AsString(), AsBool(), AsInt64(), AsDouble(): typed accessors. AsInt64()
+//     only succeeds for integers and AsDouble() for any number.
+//   AsRaw(): the body of the response if it is not JSON.
+//   size(): the number of elements or members of an array or object.
+//   Find(key), At(index): the child nodes of an object or array.
+//   ForEachMember(func): calls func(key, child) for the members of an object
+//     until it returns false.
+//   Missing(): a node standing for a missing property.
+//   ResolvePointer(pointer): the node a JSON pointer refers to, or Missing().
+//   ToJson(), DebugString(): copies of the node, for debugging or callers
+//     needing an nlohmann::json.
+
+// A JSON node within a RedfishTransport::Result shared with the cache. Child
+// nodes share ownership of the whole payload and only point at a different
+// part of it, so navigating into a payload never copies it.
+struct SharedJsonNode {
+  static SharedJsonNode Root(
+      std::shared_ptr<const ecclesia::RedfishTransport::Result> result) {
+    const nlohmann::json *json = std::get_if<nlohmann::json>(&result->body);
+    return {std::move(result), json};
+  }
+
+  // Returns a node for a JSON value that must be owned by this->result.
+  SharedJsonNode Child(const nlohmann::json &child) const {
+    return {result, &child};
+  }
+
+  SharedJsonNode Missing() const {
+    static const nlohmann::json *const kDiscarded =
+        new nlohmann::json(nlohmann::json::value_t::discarded);
+    return {result, kDiscarded};
+  }
+
+  int code() const { return result->code; }
+  bool is_json() const { return json != nullptr; }
+  bool is_object() const { return json != nullptr && json->is_object(); }
+  bool is_array() const { return json != nullptr && json->is_array(); }
+  size_t size() const { return json == nullptr ? 0 : json->size(); }
+
+  std::optional<std::string> AsString() const {
+    if (json == nullptr || !json->is_string()) return std::nullopt;
+    return json->get<std::string>();
+  }
+  std::optional<bool> AsBool() const {
+    if (json == nullptr || !json->is_boolean()) return std::nullopt;
+    return json->get<bool>();
+  }
+  std::optional<int64_t> AsInt64() const {
+    if (json == nullptr || !json->is_number_integer()) return std::nullopt;
+    return json->get<int64_t>();
+  }
+  std::optional<double> AsDouble() const {
+    if (json == nullptr || !json->is_number()) return std::nullopt;
+    return json->get<double>();
+  }
+  std::optional<RedfishTransport::bytes> AsRaw() const {
+    if (!std::holds_alternative<RedfishTransport::bytes>(result->body)) {
+      return std::nullopt;
+    }
+    return std::get<RedfishTransport::bytes>(result->body);
+  }
+
+  std::optional<SharedJsonNode> Find(const std::string &key) const {
+    if (!is_object()) return std::nullopt;
+    auto itr = json->find(key);
+    if (itr == json->end()) return std::nullopt;
+    return Child(itr.value());
+  }
+  std::optional<SharedJsonNode> At(size_t index) const {
+    if (!is_array() || index >= json->size()) return std::nullopt;
+    return Child((*json)[index]);
+  }
+  template <typename F>
+  void ForEachMember(F func) const {
+    if (!is_object()) return;
+    for (const auto &items : json->items()) {
+      if (!func(items.key(), Child(items.value()))) break;
+    }
+  }
+
+  // The pointer resolves to a node within the shared result, so only the path
+  // to the node is walked and nothing is copied.
+  SharedJsonNode ResolvePointer(absl::string_view pointer) const {
+    const nlohmann::json *resolved = ecclesia::ResolveJsonPtr(*json, pointer);
+    return resolved == nullptr ? Missing() : Child(*resolved);
+  }
+
+  nlohmann::json ToJson() const {
+    if (json == nullptr) return nlohmann::json::value_t::discarded;
+    return *json;
+  }
+  std::string DebugString() const {
+    if (json != nullptr) return json->dump(1);
+    return RedfishTransportBytesToString(
+        std::get<RedfishTransport::bytes>(result->body));
+  }
+
+  std::shared_ptr<const ecclesia::RedfishTransport::Result> result;
+  // Points into result->body, or nullptr if the body does not hold JSON.
+  const nlohmann::json *json;
+};
+
+// A node within a JsonDocument. Child nodes share ownership of the document.
+struct SharedDocumentNode {
+  SharedDocumentNode Child(JsonDocument::Value child) const {
+    return {doc, child, http_code};
+  }
+
+  SharedDocumentNode Missing() const { return {doc, std::nullopt, http_code}; }
+
+  int code() const { return http_code; }
+  bool is_json() const { return true; }
+  bool is_object() const { return value.has_value() && value->is_object(); }
+  bool is_array() const { return value.has_value() && value->is_array(); }
+  size_t size() const { return value.has_value() ? value->size() : 0; }
+
+  std::optional<std::string> AsString() const {
+    if (!value.has_value()) return std::nullopt;
+    std::optional<absl::string_view> string = value->AsString();
+    if (!string.has_value()) return std::nullopt;
+    return std::string(*string);
+  }
+  std::optional<bool> AsBool() const {
+    return value.has_value() ? value->AsBool() : std::nullopt;
+  }
+  std::optional<int64_t> AsInt64() const {
+    return value.has_value() ? value->AsInt64() : std::nullopt;
+  }
+  std::optional<double> AsDouble() const {
+    return value.has_value() ? value->AsDouble() : std::nullopt;
+  }
+  std::optional<RedfishTransport::bytes> AsRaw() const { return std::nullopt; }
+
+  std::optional<SharedDocumentNode> Find(const std::string &key) const {
+    if (!value.has_value()) return std::nullopt;
+    std::optional<JsonDocument::Value> child = value->Find(key);
+    if (!child.has_value()) return std::nullopt;
+    return Child(*child);
+  }
+  std::optional<SharedDocumentNode> At(size_t index) const {
+    if (!value.has_value()) return std::nullopt;
+    std::optional<JsonDocument::Value> child = value->At(index);
+    if (!child.has_value()) return std::nullopt;
+    return Child(*child);
+  }
+  template <typename F>
+  void ForEachMember(F func) const {
+    if (!is_object()) return;
+    for (size_t i = 0; i < value->size(); ++i) {
+      if (!func(value->MemberKey(i), Child(value->MemberValue(i)))) break;
+    }
+  }
+
+  SharedDocumentNode ResolvePointer(absl::string_view pointer) const {
+    if (!value.has_value()) return Missing();
+    std::optional<JsonDocument::Value> resolved =
+        ecclesia::ResolveJsonPtr(*value, pointer);
+    return resolved.has_value() ? Child(*resolved) : Missing();
+  }
+
+  nlohmann::json ToJson() const {
+    if (!value.has_value()) return nlohmann::json::value_t::discarded;
+    return value->ToJson();
+  }
+  std::string DebugString() const { return ToJson().dump(1); }
+
+  std::shared_ptr<const JsonDocument> doc;
+  // Empty for missing properties.
+  std::optional<JsonDocument::Value> value;
+  int http_code;
+};
+
+// Returns the @odata.id of a node, if it is an object having one.
+template <typename Node>
+std::optional<std::string> GetObjectUri(const Node &node) {
+  std::optional<Node> odata = node.Find(PropertyOdataId::Name);
+  if (!odata.has_value()) return std::nullopt;
+  return odata->AsString();
+}
+
+template <typename Node>
 class HttpIntfVariantImpl : public RedfishVariant::ImplIntf {
  public:
   HttpIntfVariantImpl(RedfishInterface *intf, RedfishExtendedPath path,
-                      ecclesia::RedfishTransport::Result result,
-                      CacheState cache_state)
+                      Node node, CacheState cache_state)
       : intf_(intf),
         path_(std::move(path)),
-        result_(std::move(result)),
+        node_(std::move(node)),
         cache_state_(cache_state) {}
   std::unique_ptr<RedfishObject> AsObject() const override;
   std::unique_ptr<RedfishIterable> AsIterable(
       RedfishVariant::IterableMode mode) const override;
-  std::optional<RedfishTransport::bytes> AsRaw() const override;
+  std::optional<RedfishTransport::bytes> AsRaw() const override {
+    return node_.AsRaw();
+  }
 
   bool GetValue(std::string *val) const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return false;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    if (!json.is_string()) return false;
-    *val = json.get<std::string>();
+    std::optional<std::string> value = node_.AsString();
+    if (!value.has_value()) return false;
+    *val = *std::move(value);
     return true;
   }
   bool GetValue(int32_t *val) const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return false;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    if (json.is_number_integer()) {
-      *val = json.get<int32_t>();
-      return true;
-    }
-    if (json.is_number()) {
-      double trans_tmp = std::round(json.get<double>());
-      if (trans_tmp >
-              static_cast<double>(std::numeric_limits<int32_t>::max()) ||
-          trans_tmp <
-              static_cast<double>(std::numeric_limits<int32_t>::min())) {
-        return false;
-      }
-      *val = trans_tmp;
-      return true;
-    }
-    return false;
+    return GetIntegerValue(val);
   }
   bool GetValue(int64_t *val) const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return false;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    if (json.is_number_integer()) {
-      *val = json.get<int64_t>();
-      return true;
-    }
-    if (json.is_number()) {
-      double trans_tmp = std::round(json.get<double>());
-      if (trans_tmp >
-              static_cast<double>(std::numeric_limits<int64_t>::max()) ||
-          trans_tmp <
-              static_cast<double>(std::numeric_limits<int64_t>::min())) {
-        return false;
-      }
-      *val = trans_tmp;
-      return true;
-    }
-    return false;
+    return GetIntegerValue(val);
   }
   bool GetValue(double *val) const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return false;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    if (!json.is_number()) return false;
-    *val = json.get<double>();
+    std::optional<double> value = node_.AsDouble();
+    if (!value.has_value()) return false;
+    *val = *value;
     return true;
   }
   bool GetValue(bool *val) const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return false;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    if (!json.is_boolean()) return false;
-    *val = json.get<bool>();
+    std::optional<bool> value = node_.AsBool();
+    if (!value.has_value()) return false;
+    *val = *value;
     return true;
   }
   bool GetValue(absl::Time *val) const override {
@@ -219,48 +364,49 @@ class HttpIntfVariantImpl : public RedfishVariant::ImplIntf {
     }
     return absl::ParseTime("%Y-%m-%dT%H:%M:%S%Z", dt_string, val, nullptr);
   }
-  std::string DebugString() const override {
-    if (std::holds_alternative<nlohmann::json>(result_.body)) {
-      return std::get<nlohmann::json>(result_.body).dump(1);
-    }
-    return RedfishTransportBytesToString(
-        std::get<RedfishTransport::bytes>(result_.body));
-  }
+  std::string DebugString() const override { return node_.DebugString(); }
 
   void PrintDebugString() const override{
     LOG(INFO) << "Variant:\n" << DebugString();
   }
 
  private:
+  // Integers are converted as-is, other numbers are rounded if they fit.
+  template <typename IntT>
+  bool GetIntegerValue(IntT *val) const {
+    if (std::optional<int64_t> value = node_.AsInt64(); value.has_value()) {
+      *val = static_cast<IntT>(*value);
+      return true;
+    }
+    if (std::optional<double> value = node_.AsDouble(); value.has_value()) {
+      double trans_tmp = std::round(*value);
+      if (trans_tmp > static_cast<double>(std::numeric_limits<IntT>::max()) ||
+          trans_tmp < static_cast<double>(std::numeric_limits<IntT>::min())) {
+        return false;
+      }
+      *val = trans_tmp;
+      return true;
+    }
+    return false;
+  }
+
   RedfishInterface *intf_;
   RedfishExtendedPath path_;
-  ecclesia::RedfishTransport::Result result_;
+  Node node_;
   CacheState cache_state_;
 };
 
-// Returns the URI from Json object or NotFound error
-absl::StatusOr<std::string> GetObjectUri(const nlohmann::json &json) {
-  std::string reference;
-  if (json.is_object()) {
-    if (auto odata = json.find(PropertyOdataId::Name);
-        // Object can be re-read by URI. Store it.
-        odata != json.end() && odata.value().is_string()) {
-      return odata.value().get<std::string>();
-    }
-  }
-  return absl::NotFoundError("Unable to find @odata.id");
-}
 // Helper function for automatically fetching an @odata.id reference using
 // GET. The goal of this function is to help "flatten" a Redfish service's
 // entire Redfish tree to make it appear like a single JSON document.
 // For example:
 //   input json: { "@odata.id": "/redfish/v1/Chassis/1" }
 //   result: returns GET on "/redfish/v1/Chassis/1"
-// If the object is not a reference, returns the current json object as-is.
-// reuse_code will be propagated to the returned RedfishVariant if no GET is
-// performed.
-RedfishVariant ResolveReference(int reuse_code, nlohmann::json json,
-                                RedfishInterface *intf,
+// If the object is not a reference, returns the current json node as-is. The
+// code of the result owning the node will be propagated to the returned
+// RedfishVariant if no GET is performed.
+template <typename Node>
+RedfishVariant ResolveReference(Node node, RedfishInterface *intf,
                                 RedfishExtendedPath path,
                                 CacheState cache_state, GetParams params = {}) {
   auto get_uri = [intf](const RedfishExtendedPath &path, GetParams params) {
@@ -268,10 +414,10 @@ RedfishVariant ResolveReference(int reuse_code, nlohmann::json json,
                ? intf->UncachedGetUri(path.GetFullPath(), std::move(params))
                : intf->CachedGetUri(path.GetFullPath(), std::move(params));
   };
-  if (absl::StatusOr<std::string> reference = GetObjectUri(json);
-      reference.ok()) {
-    path = RedfishExtendedPath{*reference, {}};
-    if (json.size() == 1) {
+  if (std::optional<std::string> reference = GetObjectUri(node);
+      reference.has_value()) {
+    path = RedfishExtendedPath{*std::move(reference), {}};
+    if (node.size() == 1) {
       return get_uri(path, std::move(params));
     }
   }
@@ -284,24 +430,21 @@ RedfishVariant ResolveReference(int reuse_code, nlohmann::json json,
   }
 
   // Return the object as-is.
+  int code = node.code();
   return RedfishVariant(
-      std::make_unique<HttpIntfVariantImpl>(intf, std::move(path),
-                                            ecclesia::RedfishTransport::Result{
-                                                .code = reuse_code,
-                                                .body = std::move(json),
-                                            },
-                                            cache_state),
-      ecclesia::HttpResponseCodeFromInt(reuse_code));
+      std::make_unique<HttpIntfVariantImpl<Node>>(intf, std::move(path),
+                                                  std::move(node), cache_state),
+      ecclesia::HttpResponseCodeFromInt(code));
 }
 
+template <typename Node>
 class HttpIntfObjectImpl : public RedfishObject {
  public:
   explicit HttpIntfObjectImpl(RedfishInterface *intf, RedfishExtendedPath path,
-                              ecclesia::RedfishTransport::Result result,
-                              CacheState cache_state)
+                              Node node, CacheState cache_state)
       : intf_(intf),
         path_(std::move(path)),
-        result_(std::move(result)),
+        node_(std::move(node)),
         cache_state_(cache_state) {}
   HttpIntfObjectImpl(const HttpIntfObjectImpl &) = delete;
   HttpIntfObjectImpl &operator=(const HttpIntfObjectImpl &) = delete;
@@ -312,25 +455,20 @@ class HttpIntfObjectImpl : public RedfishObject {
 
   RedfishVariant Get(const std::string &node_name,
                      GetParams params) const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
+    if (!node_.is_json()) {
       return RedfishVariant(
           absl::InternalError("Result body is not holding JSON"));
     }
-    const auto &json = std::get<nlohmann::json>(result_.body);
     // Update path with a new node name
     RedfishExtendedPath new_path = path_;
     new_path.properties.push_back(node_name);
 
-    auto itr = json.find(node_name);
-    if (itr == json.end()) {
-      return RedfishVariant(std::make_unique<HttpIntfVariantImpl>(
-                                intf_, std::move(new_path),
-                                ecclesia::RedfishTransport::Result{
-                                    .code = result_.code,
-                                    .body = nlohmann::json::value_t::discarded,
-                                },
-                                cache_state_),
-                            ecclesia::HttpResponseCodeFromInt(result_.code));
+    std::optional<Node> child = node_.Find(node_name);
+    if (!child.has_value()) {
+      return RedfishVariant(
+          std::make_unique<HttpIntfVariantImpl<Node>>(
+              intf_, std::move(new_path), node_.Missing(), cache_state_),
+          ecclesia::HttpResponseCodeFromInt(node_.code()));
     }
     // Reset expands if requested but not available
     if (params.expand.has_value() &&
@@ -339,35 +477,17 @@ class HttpIntfObjectImpl : public RedfishObject {
              .ok()) {
       params.expand.reset();
     }
-    return ResolveReference(result_.code, itr.value(), intf_,
-                            std::move(new_path), cache_state_,
-                            std::move(params));
+    return ResolveReference(*std::move(child), intf_, std::move(new_path),
+                            cache_state_, std::move(params));
   }
 
   std::optional<std::string> GetUriString() const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return std::nullopt;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    auto itr = json.find(PropertyOdataId::Name);
-    if (itr == json.end()) return std::nullopt;
-    return std::string(itr.value());
+    return GetObjectUri(node_);
   }
 
-  nlohmann::json GetContentAsJson() const override {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return nlohmann::json::value_t::discarded;
-    }
-    return std::get<nlohmann::json>(result_.body);
-  }
+  nlohmann::json GetContentAsJson() const override { return node_.ToJson(); }
 
-  std::string DebugString() const override {
-    if (std::holds_alternative<nlohmann::json>(result_.body)) {
-      return std::get<nlohmann::json>(result_.body).dump(1);
-    }
-    return RedfishTransportBytesToString(
-        std::get<RedfishTransport::bytes>(result_.body));
-  }
+  std::string DebugString() const override { return node_.DebugString(); }
 
   void PrintDebugString() const override{
     LOG(INFO) << "Object:\n" << DebugString();
@@ -376,7 +496,7 @@ class HttpIntfObjectImpl : public RedfishObject {
   absl::StatusOr<std::unique_ptr<RedfishObject>> EnsureFreshPayload(
       GetParams params) {
     if (cache_state_ == kIsFresh) {
-      return std::make_unique<HttpIntfObjectImpl>(intf_, path_, result_,
+      return std::make_unique<HttpIntfObjectImpl>(intf_, path_, node_,
                                                   cache_state_);
     }
     if (auto uri = GetUriString(); uri.has_value()) {
@@ -392,176 +512,304 @@ class HttpIntfObjectImpl : public RedfishObject {
   void ForEachProperty(absl::FunctionRef<RedfishIterReturnValue(
                            absl::string_view, RedfishVariant value)>
                            itr_func) {
-    if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-      return;
-    }
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    for (const auto &items : json.items()) {
+    node_.ForEachMember([&](absl::string_view key, Node child) {
       RedfishExtendedPath path = path_;
-      path.properties.push_back(items.key());
-      if (itr_func(items.key(),
-                   RedfishVariant(
-                       std::make_unique<HttpIntfVariantImpl>(
-                           intf_, std::move(path),
-                           ecclesia::RedfishTransport::Result{
-                               .code = result_.code,
-                               .body = nlohmann::json(items.value()),
-                           },
-                           cache_state_),
-                       ecclesia::HttpResponseCodeFromInt(result_.code))) ==
-          RedfishIterReturnValue::kStop) {
-        break;
-      }
-    }
+      path.properties.push_back(std::string(key));
+      return itr_func(key,
+                      RedfishVariant(
+                          std::make_unique<HttpIntfVariantImpl<Node>>(
+                              intf_, std::move(path), std::move(child),
+                              cache_state_),
+                          ecclesia::HttpResponseCodeFromInt(node_.code()))) !=
+             RedfishIterReturnValue::kStop;
+    });
   }
 
  private:
   RedfishInterface *intf_;
   RedfishExtendedPath path_;
-  ecclesia::RedfishTransport::Result result_;
+  Node node_;
   CacheState cache_state_;
 };
 
+// Returns the pool running the fetches of all prefetched iterables, so that
+// the threads used for prefetching are bounded process-wide.
+ThreadPool &GetPrefetchPool() {
+  static ThreadPool *const pool = new ThreadPool(kPrefetchThreads);
+  return *pool;
+}
+
+// Fetches the elements of an iterable on the shared prefetch pool, in index
+// order and with a bounded number of fetches in flight, and hands out each
+// fetched element once. Destroying the prefetcher cancels the fetches which
+// have not started and waits for the ones in flight.
+class ElementPrefetcher {
+ public:
+  ElementPrefetcher(size_t size, size_t max_in_flight,
+                    std::function<RedfishVariant(size_t)> fetch)
+      : state_(std::make_shared<State>(std::move(fetch), size)) {
+    // Workers which only run once the prefetcher is gone find it cancelled,
+    // so they keep the state alive but never call fetch.
+    size_t num_workers = std::min(size, max_in_flight);
+    for (size_t i = 0; i < num_workers; ++i) {
+      GetPrefetchPool().Schedule([state = state_]() { Work(*state); });
+    }
+  }
+
+  ElementPrefetcher(const ElementPrefetcher &) = delete;
+  ElementPrefetcher &operator=(const ElementPrefetcher &) = delete;
+
+  ~ElementPrefetcher() {
+    absl::MutexLock lock(&state_->mutex);
+    state_->cancelled = true;
+    state_->mutex.Await(absl::Condition(state_.get(), &State::Idle));
+  }
+
+  // Returns the element at the given index, waiting for its fetch if it is in
+  // flight. Returns std::nullopt if the element was already taken, or if its
+  // fetch has not started yet, in which case it is left to the caller.
+  std::optional<RedfishVariant> Take(size_t index) {
+    absl::MutexLock lock(&state_->mutex);
+    if (index >= state_->slots.size()) return std::nullopt;
+    Slot &slot = state_->slots[index];
+    state_->mutex.Await(absl::Condition(
+        +[](Slot *slot) { return slot->state != Slot::kInFlight; }, &slot));
+    std::optional<RedfishVariant> element;
+    if (slot.state == Slot::kFetched) element = std::move(slot.element);
+    slot.element.reset();
+    slot.state = Slot::kTaken;
+    return element;
+  }
+
+ private:
+  struct Slot {
+    enum State { kPending, kInFlight, kFetched, kTaken };
+    State state = kPending;
+    std::optional<RedfishVariant> element;
+  };
+
+  // State shared with the workers scheduled on the pool.
+  struct State {
+    State(std::function<RedfishVariant(size_t)> fetch, size_t size)
+        : fetch(std::move(fetch)), slots(size) {}
+
+    bool Idle() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+      return in_flight == 0;
+    }
+
+    const std::function<RedfishVariant(size_t)> fetch;
+    absl::Mutex mutex;
+    std::vector<Slot> slots ABSL_GUARDED_BY(mutex);
+    // Lowest index which may still be pending.
+    size_t next ABSL_GUARDED_BY(mutex) = 0;
+    // Number of calls to fetch in progress.
+    size_t in_flight ABSL_GUARDED_BY(mutex) = 0;
+    bool cancelled ABSL_GUARDED_BY(mutex) = false;
+  };
+
+  static void Work(State &state) {
+    while (true) {
+      size_t index;
+      {
+        absl::MutexLock lock(&state.mutex);
+        while (state.next < state.slots.size() &&
+               state.slots[state.next].state != Slot::kPending) {
+          ++state.next;
+        }
+        if (state.cancelled || state.next == state.slots.size()) return;
+        index = state.next++;
+        state.slots[index].state = Slot::kInFlight;
+        ++state.in_flight;
+      }
+      RedfishVariant element = state.fetch(index);
+      absl::MutexLock lock(&state.mutex);
+      state.slots[index].element.emplace(std::move(element));
+      state.slots[index].state = Slot::kFetched;
+      --state.in_flight;
+    }
+  }
+
+  const std::shared_ptr<State> state_;
+};
+
 // HttpIntfArrayIterableImpl implements the RedfishIterable interface with a
-// RedfishTransport::Result containing a JSON array. The JSON array must be
-// verified before constructing this class.
+// node holding a JSON array. The JSON array must be verified before
+// constructing this class.
+template <typename Node>
 class HttpIntfArrayIterableImpl : public RedfishIterable {
  public:
   explicit HttpIntfArrayIterableImpl(RedfishInterface *intf,
-                                     RedfishExtendedPath path,
-                                     ecclesia::RedfishTransport::Result result,
+                                     RedfishExtendedPath path, Node node,
                                      CacheState cache_state)
       : intf_(intf),
         path_(std::move(path)),
-        result_(std::move(result)),
+        node_(std::move(node)),
         cache_state_(cache_state) {}
 
   HttpIntfArrayIterableImpl(const HttpIntfArrayIterableImpl &) = delete;
-  HttpIntfObjectImpl &operator=(const HttpIntfArrayIterableImpl &) = delete;
+  HttpIntfArrayIterableImpl &operator=(const HttpIntfArrayIterableImpl &) =
+      delete;
 
-  size_t Size() override {
-    return std::get<nlohmann::json>(result_.body).size();
+  size_t Size() override { return node_.size(); }
+
+  bool Empty() override { return node_.size() == 0; }
+
+  RedfishVariant operator[](int index) const override {
+    if (prefetcher_ != nullptr && index >= 0) {
+      if (std::optional<RedfishVariant> element = prefetcher_->Take(index)) {
+        return *std::move(element);
+      }
+    }
+    return Resolve(index);
   }
 
-  bool Empty() override {
-    return std::get<nlohmann::json>(result_.body).empty();
+  void Prefetch(size_t max_in_flight) override {
+    prefetcher_ = nullptr;
+    if (max_in_flight == 0) return;
+    prefetcher_ = std::make_unique<ElementPrefetcher>(
+        node_.size(), max_in_flight,
+        [this](size_t index) { return Resolve(static_cast<int>(index)); });
   }
 
-  RedfishVariant operator[](int index) const override {
-    const auto &json = std::get<nlohmann::json>(result_.body);
-    if (index < 0 || index >= json.size()) {
+  std::optional<std::string> GetUriString(int index) const override {
+    std::optional<Node> element;
+    if (index >= 0) element = node_.At(index);
+    if (!element.has_value()) return std::nullopt;
+    return GetObjectUri(*element);
+  }
+
+ private:
+  RedfishVariant Resolve(int index) const {
+    std::optional<Node> element;
+    if (index >= 0) element = node_.At(index);
+    if (!element.has_value()) {
       return RedfishVariant(absl::OutOfRangeError(
           absl::StrFormat("Index %d out of range for json array", index)));
     }
-    auto retval = json[index];
     RedfishExtendedPath new_path = path_;
     new_path.properties.push_back(index);
-    return ResolveReference(result_.code, json[index], intf_,
-                            std::move(new_path), cache_state_);
+    return ResolveReference(*std::move(element), intf_, std::move(new_path),
+                            cache_state_);
   }
 
- private:
   RedfishInterface *intf_;
   RedfishExtendedPath path_;
-  ecclesia::RedfishTransport::Result result_;
+  Node node_;
   CacheState cache_state_;
+  // Declared last so that its fetches, which call Resolve(), are waited for
+  // before the other members are destroyed.
+  std::unique_ptr<ElementPrefetcher> prefetcher_;
 };
 
 // HttpIntfCollectionIterableImpl implements the RedfishIterable interface
 // with a JSON object representing a Redfish Collection. The Collection object
 // must be verified before constructing this class. Redfish Collection objects
 // must have "Members@odata.count" and "Members" fields.
+template <typename Node>
 class HttpIntfCollectionIterableImpl : public RedfishIterable {
  public:
-  explicit HttpIntfCollectionIterableImpl(
-      RedfishInterface *intf, RedfishExtendedPath path,
-      ecclesia::RedfishTransport::Result result, CacheState cache_state)
+  explicit HttpIntfCollectionIterableImpl(RedfishInterface *intf,
+                                          RedfishExtendedPath path, Node node,
+                                          CacheState cache_state)
       : intf_(intf),
         path_(std::move(path)),
-        result_(std::move(result)),
+        node_(std::move(node)),
         cache_state_(cache_state) {}
   HttpIntfCollectionIterableImpl(const HttpIntfCollectionIterableImpl &) =
       delete;
-  HttpIntfObjectImpl &operator=(const HttpIntfCollectionIterableImpl &) =
-      delete;
+  HttpIntfCollectionIterableImpl &operator=(
+      const HttpIntfCollectionIterableImpl &) = delete;
 
   size_t Size() override {
-    const auto &json = std::get<nlohmann::json>(result_.body);
     // Return size based on Members@odata.count.
-    auto itr = json.find(PropertyMembersCount::Name);
-    if (itr == json.end() || !itr.value().is_number()) return 0;
-    return itr.value().get<size_t>();
+    std::optional<Node> count = node_.Find(PropertyMembersCount::Name);
+    if (!count.has_value()) return 0;
+    std::optional<double> value = count->AsDouble();
+    return value.has_value() ? static_cast<size_t>(*value) : 0;
   }
 
   bool Empty() override {
-    const auto &json = std::get<nlohmann::json>(result_.body);
     // Determine emptiness by checking Members@odata.count.
-    auto itr = json.find(PropertyMembersCount::Name);
-    if (itr == json.end() || !itr.value().is_number()) return true;
-    return itr.value().get<size_t>() == 0;
+    return Size() == 0;
   }
 
   RedfishVariant operator[](int index) const override {
-    const auto &json = std::get<nlohmann::json>(result_.body);
+    if (prefetcher_ != nullptr && index >= 0) {
+      if (std::optional<RedfishVariant> member = prefetcher_->Take(index)) {
+        return *std::move(member);
+      }
+    }
+    return Resolve(index);
+  }
+
+  // Members of collections usually only hold their @odata.id, so prefetching
+  // them issues their GETs concurrently.
+  void Prefetch(size_t max_in_flight) override {
+    prefetcher_ = nullptr;
+    std::optional<Node> members = node_.Find(PropertyMembers::Name);
+    if (max_in_flight == 0 || !members.has_value()) return;
+    prefetcher_ = std::make_unique<ElementPrefetcher>(
+        members->size(), max_in_flight,
+        [this](size_t index) { return Resolve(static_cast<int>(index)); });
+  }
+
+  std::optional<std::string> GetUriString(int index) const override {
+    std::optional<Node> members = node_.Find(PropertyMembers::Name);
+    std::optional<Node> member;
+    if (members.has_value() && index >= 0) member = members->At(index);
+    if (!member.has_value()) return std::nullopt;
+    return GetObjectUri(*member);
+  }
+
+ private:
+  RedfishVariant Resolve(int index) const {
     // Check the bounds based on the array in the Members property and access
     // the Members array directly.
-    auto itr = json.find(PropertyMembers::Name);
-    if (itr == json.end() || !itr.value().is_array() ||
-        itr.value().size() <= index) {
+    std::optional<Node> members = node_.Find(PropertyMembers::Name);
+    std::optional<Node> member;
+    if (members.has_value() && index >= 0) member = members->At(index);
+    if (!member.has_value()) {
       return RedfishVariant(absl::NotFoundError(
           absl::StrFormat("Index %d not found for json collection", index)));
     }
     RedfishExtendedPath new_path = path_;
     new_path.properties.push_back(index);
-    return ResolveReference(result_.code, itr.value()[index], intf_,
-                            std::move(new_path), cache_state_);
+    return ResolveReference(*std::move(member), intf_, std::move(new_path),
+                            cache_state_);
   }
 
- private:
   RedfishInterface *intf_;
   RedfishExtendedPath path_;
-  ecclesia::RedfishTransport::Result result_;
+  Node node_;
   CacheState cache_state_;
+  // Declared last so that its fetches, which call Resolve(), are waited for
+  // before the other members are destroyed.
+  std::unique_ptr<ElementPrefetcher> prefetcher_;
 };
 
-std::unique_ptr<RedfishObject> HttpIntfVariantImpl::AsObject() const {
-  if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-    return nullptr;
-  }
-  const auto &json = std::get<nlohmann::json>(result_.body);
-  if (!json.is_object()) return nullptr;
-  return std::make_unique<HttpIntfObjectImpl>(intf_, path_, result_,
-                                              cache_state_);
+template <typename Node>
+std::unique_ptr<RedfishObject> HttpIntfVariantImpl<Node>::AsObject() const {
+  if (!node_.is_object()) return nullptr;
+  return std::make_unique<HttpIntfObjectImpl<Node>>(intf_, path_, node_,
+                                                    cache_state_);
 }
 
-std::unique_ptr<RedfishIterable> HttpIntfVariantImpl::AsIterable(
+template <typename Node>
+std::unique_ptr<RedfishIterable> HttpIntfVariantImpl<Node>::AsIterable(
     RedfishVariant::IterableMode mode) const {
-  if (!std::holds_alternative<nlohmann::json>(result_.body)) {
-    return nullptr;
-  }
-  const auto &json = std::get<nlohmann::json>(result_.body);
-  bool is_collection_iterable = json.is_object() &&
-                                json.contains(PropertyMembers::Name) &&
-                                json.contains(PropertyMembersCount::Name);
-  if (json.is_array()) {
-    return std::make_unique<HttpIntfArrayIterableImpl>(intf_, path_, result_,
-                                                       cache_state_);
+  if (node_.is_array()) {
+    return std::make_unique<HttpIntfArrayIterableImpl<Node>>(
+        intf_, path_, node_, cache_state_);
   }
   // Check if the object is a Redfish collection.
-  if (is_collection_iterable) {
-    return std::make_unique<HttpIntfCollectionIterableImpl>(
-        intf_, path_, result_, cache_state_);
+  if (node_.Find(PropertyMembers::Name).has_value() &&
+      node_.Find(PropertyMembersCount::Name).has_value()) {
+    return std::make_unique<HttpIntfCollectionIterableImpl<Node>>(
+        intf_, path_, node_, cache_state_);
   }
   return nullptr;
 }
 
-std::optional<RedfishTransport::bytes> HttpIntfVariantImpl::AsRaw() const {
-  if (!std::holds_alternative<RedfishTransport::bytes>(result_.body)) {
-    return std::nullopt;
-  }
-  return std::get<RedfishTransport::bytes>(result_.body);
-}
-
 class HttpRedfishInterface : public RedfishInterface {
  public:
   HttpRedfishInterface(
@@ -642,10 +890,13 @@ class HttpRedfishInterface : public RedfishInterface {
         transport_->Post(uri, data);
     if (!result.ok()) return RedfishVariant(result.status());
     int code = result->code;
-    return RedfishVariant(std::make_unique<HttpIntfVariantImpl>(
-                              this, RedfishExtendedPath{std::string(uri)},
-                              std::move(*result), kIsFresh),
-                          ecclesia::HttpResponseCodeFromInt(code));
+    SharedJsonNode node = SharedJsonNode::Root(
+        std::make_shared<const RedfishTransport::Result>(std::move(*result)));
+    return RedfishVariant(
+        std::make_unique<HttpIntfVariantImpl<SharedJsonNode>>(
+            this, RedfishExtendedPath{std::string(uri)}, std::move(node),
+            kIsFresh),
+        ecclesia::HttpResponseCodeFromInt(code));
   }
 
   RedfishVariant PatchUri(
@@ -661,10 +912,13 @@ class HttpRedfishInterface : public RedfishInterface {
         transport_->Patch(uri, data);
     if (!result.ok()) return RedfishVariant(result.status());
     int code = result->code;
-    return RedfishVariant(std::make_unique<HttpIntfVariantImpl>(
-                              this, RedfishExtendedPath{std::string(uri)},
-                              std::move(*result), kIsFresh),
-                          ecclesia::HttpResponseCodeFromInt(code));
+    SharedJsonNode node = SharedJsonNode::Root(
+        std::make_shared<const RedfishTransport::Result>(std::move(*result)));
+    return RedfishVariant(
+        std::make_unique<HttpIntfVariantImpl<SharedJsonNode>>(
+            this, RedfishExtendedPath{std::string(uri)}, std::move(node),
+            kIsFresh),
+        ecclesia::HttpResponseCodeFromInt(code));
   }
 
   std::optional<RedfishSupportedFeatures> SupportedFeatures() const override {
@@ -677,6 +931,10 @@ class HttpRedfishInterface : public RedfishInterface {
     remove_expand_support_ = true;
   }
 
+  void SetJsonParser(JsonParserBackend json_parser) {
+    use_json_documents_ = json_parser == JsonParserBackend::kJsonDocument;
+  }
+
  private:
   // extends uri with query parameters if needed
   std::string GetUriWithQueryParameters(absl::string_view uri,
@@ -698,37 +956,51 @@ class HttpRedfishInterface : public RedfishInterface {
       absl::string_view uri, const GetParams &params,
       ecclesia::RedfishCachedGetterInterface::GetResult get_res) {
     if (!get_res.result.ok()) return RedfishVariant(get_res.result.status());
+    std::shared_ptr<const ecclesia::RedfishTransport::Result> result =
+        *std::move(get_res.result);
+    CacheState cache_state = get_res.is_fresh ? kIsFresh : kIsCached;
+    if (std::shared_ptr<const JsonDocument> doc =
+            GetJsonDocument(std::move(get_res.document), result);
+        doc != nullptr) {
+      return MakeVariant(
+          uri, SharedDocumentNode{doc, doc->root(), result->code}, cache_state);
+    }
+    return MakeVariant(uri, SharedJsonNode::Root(std::move(result)),
+                       cache_state);
+  }
 
+  template <typename Node>
+  RedfishVariant MakeVariant(absl::string_view uri, Node node,
+                             CacheState cache_state) {
+    int code = node.code();
     // Handle JSON pointers if needed. Pointers follow a '#' character at the
     // end of a path.
-    std::vector<absl::string_view> json_ptrs =
-        absl::StrSplit(uri, absl::MaxSplits('#', 1));
-    if (json_ptrs.size() < 2) {
-      // No pointers, return the payload as-is.
-      int code = get_res.result->code;
-      return RedfishVariant(
-          std::make_unique<HttpIntfVariantImpl>(
-              this, RedfishExtendedPath{.uri = std::string(uri)},
-              *std::move(get_res.result),
-              get_res.is_fresh ? kIsFresh : kIsCached),
-          ecclesia::HttpResponseCodeFromInt(code));
-    }
-    if (!std::holds_alternative<nlohmann::json>(get_res.result->body)) {
-      return RedfishVariant(
-          absl::InternalError("Result body is not holding JSON"));
+    if (size_t pos = uri.find('#'); pos != absl::string_view::npos) {
+      if (!node.is_json()) {
+        return RedfishVariant(
+            absl::InternalError("Result body is not holding JSON"));
+      }
+      node = node.ResolvePointer(uri.substr(pos + 1));
     }
-    nlohmann::json resolved_ptr = ecclesia::HandleJsonPtr(
-        std::get<nlohmann::json>(get_res.result->body), json_ptrs[1]);
-    get_res.result->body = std::move(resolved_ptr);
-    int code = get_res.result->code;
     return RedfishVariant(
-        std::make_unique<HttpIntfVariantImpl>(
+        std::make_unique<HttpIntfVariantImpl<Node>>(
             this, RedfishExtendedPath{.uri = std::string(uri)},
-            *std::move(get_res.result),
-            get_res.is_fresh ? kIsFresh : kIsCached),
+            std::move(node), cache_state),
         ecclesia::HttpResponseCodeFromInt(code));
   }
 
+  // Returns the JsonDocument for a result whose JSON body was left as bytes by
+  // the transport, or nullptr if JSON documents are not used or the body is
+  // not JSON. The document the cache keeps along with the result is reused,
+  // so that cache hits are not parsed again.
+  std::shared_ptr<const JsonDocument> GetJsonDocument(
+      std::shared_ptr<const JsonDocument> cached_document,
+      const std::shared_ptr<const ecclesia::RedfishTransport::Result> &result) {
+    if (!use_json_documents_) return nullptr;
+    if (cached_document != nullptr) return cached_document;
+    return ParseJsonDocument(result);
+  }
+
   void PopuplateSupportedFeatures(const RedfishVariant &root) {
     absl::MutexLock lock(&supported_features_mutex_);
     if (supported_features_.has_value() || !root.status().ok()) {
@@ -784,6 +1056,9 @@ class HttpRedfishInterface : public RedfishInterface {
       ABSL_GUARDED_BY(supported_features_mutex_);
   bool remove_expand_support_ ABSL_GUARDED_BY(supported_features_mutex_) =
       false;
+
+  // Only set at construction.
+  bool use_json_documents_ = false;
 };
 
 }  // namespace
@@ -804,6 +1079,16 @@ std::unique_ptr<RedfishInterface> NewHttpInterface(
       std::move(transport), std::move(cache_factory), trusted);
 }
 
+std::unique_ptr<RedfishInterface> NewHttpInterface(
+    std::unique_ptr<ecclesia::RedfishTransport> transport,
+    RedfishTransportCacheFactory cache_factory,
+    RedfishInterface::TrustedEndpoint trusted, JsonParserBackend json_parser) {
+  auto http_intf = std::make_unique<HttpRedfishInterface>(
+      std::move(transport), std::move(cache_factory), trusted);
+  http_intf->SetJsonParser(json_parser);
+  return http_intf;
+}
+
 std::unique_ptr<RedfishInterface> NewHttpInterfaceWithoutExpand(
     std::unique_ptr<ecclesia::RedfishTransport> transport,
     RedfishTransportCacheFactory cache_factory,
@@ -814,4 +1099,12 @@ std::unique_ptr<RedfishInterface> NewHttpInterfaceWithoutExpand(
   return http_intf;
 }
 
+std::unique_ptr<RedfishInterface> NewHttpInterfaceWithJsonDocuments(
+    std::unique_ptr<ecclesia::RedfishTransport> transport,
+    RedfishTransportCacheFactory cache_factory,
+    RedfishInterface::TrustedEndpoint trusted) {
+  return NewHttpInterface(std::move(transport), std::move(cache_factory),
+                          trusted, JsonParserBackend::kJsonDocument);
+}
+
 }  // namespace ecclesia
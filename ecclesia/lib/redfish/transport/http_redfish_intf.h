@@ -43,6 +43,15 @@ std::unique_ptr<RedfishInterface> NewHttpInterface(
     RedfishTransportCacheFactory cache_factory,
     RedfishInterface::TrustedEndpoint trusted);
 
+// Constructs a RedfishInterface backed by a Redfish Transport with a cache
+// factory, parsing JSON payloads with the given backend. With kJsonDocument,
+// the transport must be created with the same backend, so that it leaves JSON
+// bodies as bytes.
+std::unique_ptr<RedfishInterface> NewHttpInterface(
+    std::unique_ptr<ecclesia::RedfishTransport> transport,
+    RedfishTransportCacheFactory cache_factory,
+    RedfishInterface::TrustedEndpoint trusted, JsonParserBackend json_parser);
+
 // Constructs a RedfishInterface backed by a Redfish Transport with a cache
 // factory but removes expand support for it.
 std::unique_ptr<RedfishInterface> NewHttpInterfaceWithoutExpand(
@@ -50,6 +59,18 @@ std::unique_ptr<RedfishInterface> NewHttpInterfaceWithoutExpand(
     RedfishTransportCacheFactory cache_factory,
     RedfishInterface::TrustedEndpoint trusted);
 
+// Same as NewHttpInterface with JsonParserBackend::kJsonDocument: JSON payloads
+// are represented as arena-backed JsonDocuments rather than nlohmann::json.
+// Documents are only used for results whose JSON body was left as bytes by the
+// transport, i.e. one created with the same backend. Such results are cached
+// like parsed ones as long as they have a JSON Content-Type, with their
+// document parsed once and kept along with the entry; the resources embedded
+// in their expanded responses are not cached separately.
+std::unique_ptr<RedfishInterface> NewHttpInterfaceWithJsonDocuments(
+    std::unique_ptr<ecclesia::RedfishTransport> transport,
+    RedfishTransportCacheFactory cache_factory,
+    RedfishInterface::TrustedEndpoint trusted);
+
 }  // namespace ecclesia
 
 #endif  // ECCLESIA_LIB_REDFISH_TRANSPORT_HTTP_REDFISH_INTF_H_
@@ -18,29 +18,41 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/log/check.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "ecclesia/lib/file/test_filesystem.h"
 #include "ecclesia/lib/http/client.h"
 #include "ecclesia/lib/http/codes.h"
 #include "ecclesia/lib/http/cred.pb.h"
 #include "ecclesia/lib/http/curl_client.h"
+#include "ecclesia/lib/protobuf/parse.h"
 #include "ecclesia/lib/redfish/interface.h"
+#include "ecclesia/lib/redfish/json_document.h"
 #include "ecclesia/lib/redfish/property_definitions.h"
 #include "ecclesia/lib/redfish/testing/fake_redfish_server.h"
 #include "ecclesia/lib/redfish/transport/cache.h"
+#include "ecclesia/lib/redfish/transport/cache_policy.pb.h"
+#include "ecclesia/lib/redfish/transport/cache_ttl_policy.h"
 #include "ecclesia/lib/redfish/transport/http.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
+#include "ecclesia/lib/redfish/transport/persistent_cache_store.h"
 #include "ecclesia/lib/thread/thread.h"
 #include "ecclesia/lib/time/clock_fake.h"
 #include "single_include/nlohmann/json.hpp"
@@ -52,6 +64,10 @@ namespace {
 using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::Gt;
+using ::testing::IsNull;
+using ::testing::Le;
+using ::testing::Not;
+using ::testing::Optional;
 using ::testing::UnorderedElementsAre;
 
 using ::tensorflow::serving::net_http::ServerRequestInterface;
@@ -144,6 +160,18 @@ class HttpRedfishInterfaceTest : public ::testing::Test {
                              RedfishInterface::kTrusted);
   }
 
+  // Returns a new transport to the fake server, for the tests which build
+  // their own cache or interface.
+  std::unique_ptr<HttpRedfishTransport> MakeTransport(
+      JsonParserBackend json_parser = JsonParserBackend::kNlohmann) {
+    auto config = server_->GetConfig();
+    return HttpRedfishTransport::MakeNetwork(
+        std::make_unique<CurlHttpClient>(LibCurlProxy::CreateInstance(),
+                                         HttpCredential()),
+        absl::StrFormat("%s:%d", config.hostname, config.port),
+        DefaultHttpHeaderConditionForJson(), json_parser);
+  }
+
   ecclesia::FakeClock clock_;
   std::unique_ptr<ecclesia::FakeRedfishServer> server_;
   std::unique_ptr<RedfishInterface> intf_;
@@ -317,6 +345,21 @@ TEST_F(HttpRedfishInterfaceTest, GetUriFragmentObject) {
 })json")));
 }
 
+TEST_F(HttpRedfishInterfaceTest, NestedNodesOutliveTheirParents) {
+  // Both the parent variant and object are temporaries; the nested node must
+  // keep the shared payload alive on its own.
+  RedfishVariant state =
+      intf_->UncachedGetUri("/redfish/v1/Chassis/chassis")["Status"]["State"];
+  std::string value;
+  ASSERT_TRUE(state.GetValue(&value));
+  EXPECT_THAT(value, Eq("StandbyOffline"));
+
+  RedfishVariant missing =
+      intf_->UncachedGetUri("/redfish/v1/Chassis/chassis")["Status"]["Health"];
+  EXPECT_FALSE(missing.GetValue(&value));
+  EXPECT_THAT(missing.AsObject(), IsNull());
+}
+
 TEST_F(HttpRedfishInterfaceTest, EachTest) {
   std::vector<std::string> names;
   intf_->GetRoot()[kRfPropertyChassis].Each().Do(
@@ -328,6 +371,57 @@ TEST_F(HttpRedfishInterfaceTest, EachTest) {
   EXPECT_THAT(names, ElementsAre("chassis"));
 }
 
+TEST_F(HttpRedfishInterfaceTest, EachPrefetchedFetchesMembersConcurrently) {
+  static constexpr int kMembers = 6;
+  static constexpr int kMaxInFlight = 3;
+  nlohmann::json collection = {{"@odata.id", "/my/collection"},
+                               {"Members@odata.count", kMembers},
+                               {"Members", nlohmann::json::array()}};
+  std::atomic<int> in_flight = 0;
+  std::atomic<int> max_in_flight = 0;
+  for (int i = 0; i < kMembers; ++i) {
+    std::string uri = absl::StrFormat("/my/collection/%d", i);
+    collection["Members"].push_back({{"@odata.id", uri}});
+    server_->AddHttpGetHandler(uri, [&, uri, i](ServerRequestInterface *req) {
+      int now = ++in_flight;
+      int max = max_in_flight.load();
+      while (now > max && !max_in_flight.compare_exchange_weak(max, now)) {
+      }
+      // Give the other prefetches time to be issued.
+      absl::SleepFor(absl::Milliseconds(50));
+      --in_flight;
+      SetContentType(req, "application/json");
+      req->OverwriteResponseHeader("OData-Version", "4.0");
+      req->WriteResponseString(
+          nlohmann::json({{"@odata.id", uri},
+                          {"Name", absl::StrFormat("member%d", i)}})
+              .dump());
+      req->Reply();
+    });
+  }
+  server_->AddHttpGetHandler("/my/collection",
+                             [&](ServerRequestInterface *req) {
+                               SetContentType(req, "application/json");
+                               req->OverwriteResponseHeader("OData-Version",
+                                                            "4.0");
+                               req->WriteResponseString(collection.dump());
+                               req->Reply();
+                             });
+
+  std::vector<std::string> names;
+  intf_->CachedGetUri("/my/collection")
+      .EachPrefetched(kMaxInFlight)
+      .Do([&names](std::unique_ptr<RedfishObject> &obj) {
+        auto name = obj->GetNodeValue<PropertyName>();
+        if (name.has_value()) names.push_back(*std::move(name));
+        return RedfishIterReturnValue::kContinue;
+      });
+  EXPECT_THAT(names, ElementsAre("member0", "member1", "member2", "member3",
+                                 "member4", "member5"));
+  EXPECT_THAT(max_in_flight.load(), Gt(1));
+  EXPECT_THAT(max_in_flight.load(), Le(kMaxInFlight));
+}
+
 TEST_F(HttpRedfishInterfaceTest, ForEachPropertyTest) {
   auto chassis = intf_->UncachedGetUri("/redfish/v1/Chassis/chassis");
   std::vector<std::pair<std::string, std::string>> all_properties;
@@ -403,6 +497,449 @@ TEST_F(HttpRedfishInterfaceTest, CachedGet) {
   }
 }
 
+TEST_F(HttpRedfishInterfaceTest, CachedGetRevalidatesWithEtag) {
+  int full_count = 0;
+  int not_modified_count = 0;
+  auto result_json = nlohmann::json::parse(R"json({
+    "Id": "1",
+    "Name": "MyResource",
+    "Description": "My Test Resource"
+  })json");
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    if (req->GetRequestHeader("If-None-Match") == "\"v1\"") {
+      not_modified_count++;
+      req->ReplyWithStatus(
+          tensorflow::serving::net_http::HTTPStatusCode::NOT_MODIFIED);
+      return;
+    }
+    full_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->OverwriteResponseHeader("ETag", "\"v1\"");
+    req->WriteResponseString(result_json.dump());
+    req->Reply();
+  });
+
+  // The first GET fetches the full resource along with its ETag.
+  {
+    auto result = intf_->CachedGetUri("/my/uri", GetParams{});
+    EXPECT_THAT(full_count, Eq(1));
+    EXPECT_THAT(not_modified_count, Eq(0));
+  }
+
+  // After the age expires, the entry is revalidated and the service answers
+  // 304, so the cached body is returned without fetching it again.
+  clock_.AdvanceTime(absl::Minutes(2));
+  {
+    auto result = intf_->CachedGetUri("/my/uri", GetParams{});
+    EXPECT_THAT(full_count, Eq(1));
+    EXPECT_THAT(not_modified_count, Eq(1));
+    EXPECT_THAT(nlohmann::json::parse(result.DebugString(), nullptr, false),
+                Eq(result_json));
+  }
+
+  // The revalidation restarted the age window.
+  clock_.AdvanceTime(absl::Seconds(1));
+  {
+    auto result = intf_->CachedGetUri("/my/uri", GetParams{});
+    EXPECT_THAT(full_count, Eq(1));
+    EXPECT_THAT(not_modified_count, Eq(1));
+    EXPECT_THAT(nlohmann::json::parse(result.DebugString(), nullptr, false),
+                Eq(result_json));
+  }
+}
+
+TEST_F(HttpRedfishInterfaceTest, ConcurrentCachedGetsAreCoalesced) {
+  static constexpr int kThreads = 4;
+  std::atomic<int> called_count = 0;
+  absl::Notification release;
+  auto result_json = nlohmann::json::parse(R"json({
+    "Id": "1",
+    "Name": "MyResource",
+    "Description": "My Test Resource"
+  })json");
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    called_count++;
+    release.WaitForNotification();
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(result_json.dump());
+    req->Reply();
+  });
+
+  auto transport = MakeTransport();
+  TimeBasedCache cache(transport.get(), &clock_, absl::Minutes(1));
+
+  std::vector<std::unique_ptr<ThreadInterface>> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.push_back(GetDefaultThreadFactory()->New([&]() {
+      auto result = cache.CachedGet("/my/uri");
+      ASSERT_TRUE(result.result.ok()) << result.result.status().message();
+      const RedfishTransport::Result &data = **result.result;
+      ASSERT_TRUE(std::holds_alternative<nlohmann::json>(data.body));
+      EXPECT_THAT(std::get<nlohmann::json>(data.body), Eq(result_json));
+    }));
+  }
+  // Hold the single fetch until every other thread is waiting on it.
+  while (cache.GetStats().coalesced_gets < kThreads - 1) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  release.Notify();
+  for (auto &t : threads) {
+    t->Join();
+  }
+  EXPECT_THAT(called_count.load(), Eq(1));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheHitsShareTheCachedResult) {
+  auto transport = MakeTransport();
+  TimeBasedCache cache(transport.get(), &clock_, absl::Minutes(1));
+
+  auto fresh = cache.CachedGet("/redfish/v1");
+  auto cached = cache.CachedGet("/redfish/v1");
+  ASSERT_TRUE(fresh.result.ok()) << fresh.result.status().message();
+  ASSERT_TRUE(cached.result.ok()) << cached.result.status().message();
+  EXPECT_TRUE(fresh.is_fresh);
+  EXPECT_FALSE(cached.is_fresh);
+  // A hit hands out the cached result itself rather than a copy.
+  EXPECT_THAT(cached.result->get(), Eq(fresh.result->get()));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheEvictsLeastRecentlyUsedEntries) {
+  auto transport = MakeTransport();
+  // Use a single shard so that eviction follows the LRU order of all entries.
+  TimeBasedCache cache(
+      transport.get(), &clock_, absl::Minutes(1),
+      TimeBasedCache::Config{.max_entries = 2, .num_shards = 1});
+
+  EXPECT_TRUE(cache.CachedGet("/redfish/v1").is_fresh);
+  EXPECT_TRUE(cache.CachedGet("/redfish/v1/Chassis").is_fresh);
+  // Use the root so that the Chassis collection is the least recently used.
+  EXPECT_FALSE(cache.CachedGet("/redfish/v1").is_fresh);
+  EXPECT_TRUE(cache.CachedGet("/redfish/v1/Chassis/chassis").is_fresh);
+
+  TimeBasedCache::Stats stats = cache.GetStats();
+  EXPECT_THAT(stats.entries, Eq(2));
+  EXPECT_THAT(stats.evictions, Eq(1));
+  EXPECT_THAT(stats.hits, Eq(1));
+  EXPECT_THAT(stats.misses, Eq(3));
+  EXPECT_THAT(stats.bytes, Gt(0));
+
+  EXPECT_FALSE(cache.CachedGet("/redfish/v1").is_fresh);
+  EXPECT_TRUE(cache.CachedGet("/redfish/v1/Chassis").is_fresh);
+  EXPECT_THAT(cache.GetStats().evictions, Eq(2));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CachePurgesExpiredEntries) {
+  auto transport = MakeTransport();
+  TimeBasedCache cache(transport.get(), &clock_, absl::Minutes(1));
+
+  cache.CachedGet("/redfish/v1");
+  cache.CachedGet("/redfish/v1/Chassis");
+  EXPECT_THAT(cache.GetStats().entries, Eq(2));
+
+  // Storing a new result after the entries expired purges them.
+  clock_.AdvanceTime(absl::Minutes(2));
+  cache.CachedGet("/redfish/v1/Chassis/chassis");
+  TimeBasedCache::Stats stats = cache.GetStats();
+  EXPECT_THAT(stats.entries, Eq(1));
+  EXPECT_THAT(stats.purged, Eq(2));
+  EXPECT_THAT(stats.evictions, Eq(0));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheServesStaleWhileRevalidating) {
+  int called_count = 0;
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    called_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({"Id": "1"})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport();
+  TimeBasedCache cache(transport.get(), &clock_, absl::Minutes(1),
+                       TimeBasedCache::Config{.max_stale = absl::Minutes(1)});
+
+  EXPECT_TRUE(cache.CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(called_count, Eq(1));
+
+  // Within max_stale of expiring, the stale entry is returned right away and
+  // refreshed in the background.
+  clock_.AdvanceTime(absl::Seconds(90));
+  auto stale = cache.CachedGet("/my/uri");
+  ASSERT_TRUE(stale.result.ok()) << stale.result.status().message();
+  EXPECT_FALSE(stale.is_fresh);
+  cache.WaitForRefreshes();
+  EXPECT_THAT(called_count, Eq(2));
+  TimeBasedCache::Stats stats = cache.GetStats();
+  EXPECT_THAT(stats.stale_hits, Eq(1));
+  EXPECT_THAT(stats.background_refreshes, Eq(1));
+
+  // The refreshed entry is served without going to the service.
+  EXPECT_FALSE(cache.CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(called_count, Eq(2));
+
+  // Past max_stale, the caller waits for a fresh result.
+  clock_.AdvanceTime(absl::Minutes(3));
+  EXPECT_TRUE(cache.CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(called_count, Eq(3));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheRefreshesAheadOfExpiry) {
+  int called_count = 0;
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    called_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({"Id": "1"})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport();
+  TimeBasedCache cache(
+      transport.get(), &clock_, absl::Minutes(1),
+      TimeBasedCache::Config{.refresh_ahead = absl::Seconds(10)});
+
+  EXPECT_TRUE(cache.CachedGet("/my/uri").is_fresh);
+  // A hit well before expiry does not refresh.
+  clock_.AdvanceTime(absl::Seconds(30));
+  EXPECT_FALSE(cache.CachedGet("/my/uri").is_fresh);
+  cache.WaitForRefreshes();
+  EXPECT_THAT(called_count, Eq(1));
+
+  // A hit close to expiry refreshes the entry in the background, so it is
+  // still cached once the original max age has passed.
+  clock_.AdvanceTime(absl::Seconds(25));
+  EXPECT_FALSE(cache.CachedGet("/my/uri").is_fresh);
+  cache.WaitForRefreshes();
+  EXPECT_THAT(called_count, Eq(2));
+  clock_.AdvanceTime(absl::Seconds(10));
+  EXPECT_FALSE(cache.CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(called_count, Eq(2));
+  EXPECT_THAT(cache.GetStats().background_refreshes, Eq(1));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheUsesTtlPolicy) {
+  int sensor_count = 0;
+  server_->AddHttpGetHandler("/sensor", [&](ServerRequestInterface *req) {
+    sensor_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(
+        R"json({"@odata.type": "#Sensor.v1_2_0.Sensor"})json");
+    req->Reply();
+  });
+  int assembly_count = 0;
+  server_->AddHttpGetHandler("/assembly", [&](ServerRequestInterface *req) {
+    assembly_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({})json");
+    req->Reply();
+  });
+  int other_count = 0;
+  server_->AddHttpGetHandler("/other", [&](ServerRequestInterface *req) {
+    other_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport();
+  absl::StatusOr<std::unique_ptr<CacheTtlPolicy>> ttl_policy =
+      CacheTtlPolicy::Create(ParseTextAsProtoOrDie<CachePolicy>(R"pb(
+        rules { uri_regex: "/assembly" }
+        rules {
+          odata_type: "Sensor"
+          max_age { seconds: 1 }
+        }
+      )pb"));
+  ASSERT_TRUE(ttl_policy.ok()) << ttl_policy.status().message();
+  TimeBasedCache cache(
+      transport.get(), &clock_, absl::Minutes(1),
+      TimeBasedCache::Config{.ttl_policy = *std::move(ttl_policy)});
+
+  cache.CachedGet("/sensor");
+  cache.CachedGet("/assembly");
+  cache.CachedGet("/other");
+
+  // The sensor expires after a second, the others use the default max age.
+  clock_.AdvanceTime(absl::Seconds(2));
+  cache.CachedGet("/sensor");
+  cache.CachedGet("/assembly");
+  cache.CachedGet("/other");
+  EXPECT_THAT(sensor_count, Eq(2));
+  EXPECT_THAT(assembly_count, Eq(1));
+  EXPECT_THAT(other_count, Eq(1));
+
+  // Resources matching a rule without a max age never expire.
+  clock_.AdvanceTime(absl::Hours(24));
+  cache.CachedGet("/sensor");
+  cache.CachedGet("/assembly");
+  cache.CachedGet("/other");
+  EXPECT_THAT(sensor_count, Eq(3));
+  EXPECT_THAT(assembly_count, Eq(1));
+  EXPECT_THAT(other_count, Eq(2));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheRestoresEntriesFromPersistentStore) {
+  int called_count = 0;
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    called_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({"Id": "1"})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport();
+  TestFilesystem fs(GetTestTempdirPath());
+  // Creates a cache backed by the store, as done after each restart.
+  auto make_cache = [&]() {
+    absl::StatusOr<std::unique_ptr<PersistentCacheStore>> store =
+        PersistentCacheStore::Create(fs.GetTruePath("/cache.log"), {});
+    CHECK(store.ok()) << store.status();
+    return std::make_unique<TimeBasedCache>(
+        transport.get(), &clock_, absl::Minutes(1),
+        TimeBasedCache::Config{.store = *std::move(store)});
+  };
+
+  auto cache = make_cache();
+  EXPECT_TRUE(cache->CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(called_count, Eq(1));
+
+  // After a restart the entry is served without going to the service. The old
+  // cache is destroyed first, so its store has finished writing.
+  cache.reset();
+  cache = make_cache();
+  EXPECT_THAT(cache->GetStats().restored, Eq(1));
+  auto restored = cache->CachedGet("/my/uri");
+  ASSERT_TRUE(restored.result.ok()) << restored.result.status().message();
+  EXPECT_FALSE(restored.is_fresh);
+  EXPECT_THAT(std::get<nlohmann::json>((*restored.result)->body),
+              Eq(nlohmann::json{{"Id", "1"}}));
+  EXPECT_THAT(called_count, Eq(1));
+
+  // Expired entries without an ETag are not restored.
+  clock_.AdvanceTime(absl::Minutes(2));
+  cache.reset();
+  cache = make_cache();
+  EXPECT_THAT(cache->GetStats().restored, Eq(0));
+  EXPECT_TRUE(cache->CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(called_count, Eq(2));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheRevalidatesOldRestoredEntriesWithEtag) {
+  int full_count = 0;
+  int not_modified_count = 0;
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    if (req->GetRequestHeader("If-None-Match") == "\"v1\"") {
+      not_modified_count++;
+      req->ReplyWithStatus(
+          tensorflow::serving::net_http::HTTPStatusCode::NOT_MODIFIED);
+      return;
+    }
+    full_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->OverwriteResponseHeader("ETag", "\"v1\"");
+    req->WriteResponseString(R"json({"Id": "1"})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport();
+  TestFilesystem fs(GetTestTempdirPath());
+  auto make_cache = [&]() {
+    absl::StatusOr<std::unique_ptr<PersistentCacheStore>> store =
+        PersistentCacheStore::Create(fs.GetTruePath("/cache.log"), {});
+    CHECK(store.ok()) << store.status();
+    return std::make_unique<TimeBasedCache>(
+        transport.get(), &clock_, absl::Minutes(1),
+        TimeBasedCache::Config{.store = *std::move(store)});
+  };
+
+  auto cache = make_cache();
+  EXPECT_TRUE(cache->CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(full_count, Eq(1));
+
+  // Long after its retention, the entry is still restored for its ETag, and
+  // revalidated rather than fetched again.
+  cache.reset();
+  clock_.AdvanceTime(absl::Hours(1));
+  cache = make_cache();
+  EXPECT_THAT(cache->GetStats().restored, Eq(1));
+  auto revalidated = cache->CachedGet("/my/uri");
+  ASSERT_TRUE(revalidated.result.ok());
+  EXPECT_TRUE(revalidated.is_fresh);
+  EXPECT_THAT(std::get<nlohmann::json>((*revalidated.result)->body),
+              Eq(nlohmann::json{{"Id", "1"}}));
+  EXPECT_THAT(full_count, Eq(1));
+  EXPECT_THAT(not_modified_count, Eq(1));
+
+  // The revalidated entry is fresh again.
+  EXPECT_FALSE(cache->CachedGet("/my/uri").is_fresh);
+  EXPECT_THAT(not_modified_count, Eq(1));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheStoresResourcesOfExpandedResponses) {
+  int expanded_count = 0;
+  server_->AddHttpGetHandler(
+      "/chassis?$expand=.($levels=2)", [&](ServerRequestInterface *req) {
+        expanded_count++;
+        SetContentType(req, "application/json");
+        req->OverwriteResponseHeader("OData-Version", "4.0");
+        req->WriteResponseString(R"json({
+          "@odata.id": "/chassis",
+          "Members": [{
+            "@odata.id": "/chassis/1",
+            "Id": "1",
+            "Sensors": {
+              "@odata.id": "/chassis/1/sensors",
+              "Members": [{"@odata.id": "/chassis/1/sensors/0"}]
+            }
+          }]
+        })json");
+        req->Reply();
+      });
+  auto transport = MakeTransport();
+  TimeBasedCache cache(transport.get(), &clock_, absl::Minutes(1));
+
+  EXPECT_TRUE(cache.CachedGet("/chassis?$expand=.($levels=2)").is_fresh);
+  EXPECT_THAT(cache.GetStats().embedded_entries, Eq(2));
+
+  // The chassis was embedded with one level of expansion left, and its sensor
+  // collection without any.
+  auto chassis = cache.CachedGet("/chassis/1?$expand=.($levels=1)");
+  ASSERT_TRUE(chassis.result.ok()) << chassis.result.status().message();
+  EXPECT_FALSE(chassis.is_fresh);
+  EXPECT_THAT(std::get<nlohmann::json>((*chassis.result)->body)["Id"],
+              Eq("1"));
+  auto sensors = cache.CachedGet("/chassis/1/sensors");
+  ASSERT_TRUE(sensors.result.ok()) << sensors.result.status().message();
+  EXPECT_FALSE(sensors.is_fresh);
+  EXPECT_THAT(
+      std::get<nlohmann::json>((*sensors.result)->body)["Members"].size(),
+      Eq(1));
+
+  // A request for fewer levels is answered by the response with more.
+  auto fewer_levels = cache.CachedGet("/chassis?$expand=.($levels=1)");
+  EXPECT_FALSE(fewer_levels.is_fresh);
+  EXPECT_THAT(cache.GetStats().covering_hits, Eq(1));
+  EXPECT_THAT(expanded_count, Eq(1));
+
+  // Plain requests are answered by the expanded resources, whether fetched or
+  // embedded with levels of expansion left.
+  auto plain_chassis = cache.CachedGet("/chassis/1");
+  ASSERT_TRUE(plain_chassis.result.ok())
+      << plain_chassis.result.status().message();
+  EXPECT_FALSE(plain_chassis.is_fresh);
+  EXPECT_THAT(std::get<nlohmann::json>((*plain_chassis.result)->body)["Id"],
+              Eq("1"));
+  EXPECT_FALSE(cache.CachedGet("/chassis").is_fresh);
+  EXPECT_THAT(cache.GetStats().covering_hits, Eq(3));
+  EXPECT_THAT(expanded_count, Eq(1));
+
+  // References that were not expanded are not cached.
+  EXPECT_TRUE(cache.CachedGet("/chassis/1/sensors/0").is_fresh);
+}
+
 TEST_F(HttpRedfishInterfaceTest, GetWithExpand) {
   server_->AddHttpGetHandler("/redfish/v1", [&](ServerRequestInterface *req) {
     req->OverwriteResponseHeader("OData-Version", "4.0");
@@ -460,6 +997,116 @@ TEST_F(HttpRedfishInterfaceTest, GetWithExpand) {
   EXPECT_EQ(called_fake_item_expanded_count, 1);
 }
 
+TEST_F(HttpRedfishInterfaceTest, NavigatesJsonDocuments) {
+  auto transport = MakeTransport(JsonParserBackend::kJsonDocument);
+  auto intf = NewHttpInterface(
+      std::move(transport),
+      [this](RedfishTransport *transport) {
+        return std::make_unique<TimeBasedCache>(transport, &clock_,
+                                                absl::Minutes(1));
+      },
+      RedfishInterface::kTrusted, JsonParserBackend::kJsonDocument);
+
+  RedfishVariant root = intf->GetRoot();
+  EXPECT_THAT(root.AsRaw(), Eq(std::nullopt));
+  std::string version;
+  ASSERT_TRUE(root["RedfishVersion"].GetValue(&version));
+  EXPECT_THAT(version, Eq("1.6.1"));
+
+  // References are followed and collections iterated as with nlohmann::json.
+  std::vector<std::string> names;
+  root[kRfPropertyChassis].Each().Do(
+      [&names](std::unique_ptr<RedfishObject> &obj) {
+        auto name = obj->GetNodeValue<PropertyName>();
+        if (name.has_value()) names.push_back(*std::move(name));
+        return RedfishIterReturnValue::kContinue;
+      });
+  EXPECT_THAT(names, ElementsAre("chassis"));
+
+  RedfishVariant chassis = intf->CachedGetUri("/redfish/v1/Chassis/chassis");
+  std::unique_ptr<RedfishObject> chassis_obj = chassis.AsObject();
+  ASSERT_THAT(chassis_obj, Not(IsNull()));
+  EXPECT_THAT(chassis_obj->GetUriString(),
+              Eq("/redfish/v1/Chassis/chassis"));
+  EXPECT_THAT(chassis_obj->GetContentAsJson(),
+              Eq(nlohmann::json::parse(R"json({
+    "@odata.context": "/redfish/v1/$metadata#Chassis.Chassis",
+    "@odata.id": "/redfish/v1/Chassis/chassis",
+    "@odata.type": "#Chassis.v1_10_0.Chassis",
+    "Id": "chassis",
+    "Name": "chassis",
+    "Status": {
+        "State": "StandbyOffline"
+    }
+})json")));
+  std::string state;
+  ASSERT_TRUE((*chassis_obj)["Status"]["State"].GetValue(&state));
+  EXPECT_THAT(state, Eq("StandbyOffline"));
+  EXPECT_THAT((*chassis_obj)["Missing"].AsObject(), IsNull());
+
+  RedfishVariant fragment =
+      intf->CachedGetUri("/redfish/v1/Chassis/chassis#/Status/State");
+  ASSERT_TRUE(fragment.GetValue(&state));
+  EXPECT_THAT(state, Eq("StandbyOffline"));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CachedGetWithJsonDocuments) {
+  int called_count = 0;
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    called_count++;
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({"Id": "1"})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport(JsonParserBackend::kJsonDocument);
+  auto intf = NewHttpInterface(
+      std::move(transport),
+      [this](RedfishTransport *transport) {
+        return std::make_unique<TimeBasedCache>(transport, &clock_,
+                                                absl::Minutes(1));
+      },
+      RedfishInterface::kTrusted, JsonParserBackend::kJsonDocument);
+
+  // Bodies left as bytes are cached, so the second GET makes no request.
+  std::string id;
+  ASSERT_TRUE(intf->CachedGetUri("/my/uri")["Id"].GetValue(&id));
+  EXPECT_THAT(id, Eq("1"));
+  EXPECT_THAT(called_count, Eq(1));
+  clock_.AdvanceTime(absl::Seconds(1));
+  RedfishVariant cached = intf->CachedGetUri("/my/uri");
+  ASSERT_TRUE(cached["Id"].GetValue(&id));
+  EXPECT_THAT(id, Eq("1"));
+  EXPECT_THAT(called_count, Eq(1));
+}
+
+TEST_F(HttpRedfishInterfaceTest, CacheKeepsJsonDocumentsWithEntries) {
+  server_->AddHttpGetHandler("/my/uri", [&](ServerRequestInterface *req) {
+    SetContentType(req, "application/json");
+    req->OverwriteResponseHeader("OData-Version", "4.0");
+    req->WriteResponseString(R"json({"Id": "1"})json");
+    req->Reply();
+  });
+  auto transport = MakeTransport(JsonParserBackend::kJsonDocument);
+  TimeBasedCache cache(transport.get(), &clock_, absl::Minutes(1));
+
+  RedfishCachedGetterInterface::GetResult fetched = cache.CachedGet("/my/uri");
+  ASSERT_TRUE(fetched.result.ok());
+  ASSERT_NE(fetched.document, nullptr);
+  // The document refers to the cached body instead of copying it.
+  const auto &bytes =
+      std::get<RedfishTransport::bytes>((*fetched.result)->body);
+  EXPECT_THAT(static_cast<const void *>(fetched.document->text().data()),
+              Eq(static_cast<const void *>(bytes.data())));
+  EXPECT_THAT(fetched.document->root().Find("Id")->AsString(),
+              Optional(Eq("1")));
+
+  // A hit shares the document parsed when the entry was stored.
+  RedfishCachedGetterInterface::GetResult hit = cache.CachedGet("/my/uri");
+  EXPECT_FALSE(hit.is_fresh);
+  EXPECT_THAT(hit.document, Eq(fetched.document));
+}
+
 TEST_F(HttpRedfishInterfaceTest, GetWithoutExpand) {
   int called_expanded_count = 0;
   server_->AddHttpGetHandler("/redfish/v1", [&](ServerRequestInterface *req) {
@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -92,6 +93,23 @@ TEST_F(HttpRedfishTransportTest, CanGet) {
       << "Diff: " << nlohmann::json::diff(json, expected);
 }
 
+TEST_F(HttpRedfishTransportTest, LeavesJsonAsBytesForJsonDocuments) {
+  transport_ = HttpRedfishTransport::MakeNetwork(
+      std::make_unique<CurlHttpClient>(LibCurlProxy::CreateInstance(),
+                                       HttpCredential()),
+      network_endpoint_, DefaultHttpHeaderConditionForJson(),
+      JsonParserBackend::kJsonDocument);
+  auto result = transport_->Get("/redfish/v1");
+  ASSERT_TRUE(result.ok()) << result.status().message();
+  EXPECT_THAT(result->code, Eq(200));
+  ASSERT_TRUE(std::holds_alternative<RedfishTransport::bytes>(result->body));
+  const auto &bytes = std::get<RedfishTransport::bytes>(result->body);
+  nlohmann::json json = nlohmann::json::parse(bytes.begin(), bytes.end(),
+                                              nullptr, false);
+  EXPECT_THAT(json["Id"], Eq("RootService"));
+  EXPECT_THAT(result->headers["Content-Type"], Eq("application/json"));
+}
+
 TEST_F(HttpRedfishTransportTest, GetInvalidJson) {
   bool called = false;
   server_->AddHttpGetHandler(
@@ -144,6 +162,21 @@ TEST_F(HttpRedfishTransportTest, GetError) {
   EXPECT_THAT(std::get<nlohmann::json>(result->body), Eq(result_json));
 }
 
+TEST_F(HttpRedfishTransportTest, GetManyReturnsResultsInOrder) {
+  std::vector<absl::string_view> paths = {"/redfish/v1", "/redfish/v1/Chassis",
+                                          "/redfish/v1/Chassis/chassis"};
+  std::vector<absl::StatusOr<RedfishTransport::Result>> results =
+      transport_->GetMany(paths);
+  ASSERT_THAT(results.size(), Eq(paths.size()));
+  for (size_t i = 0; i < paths.size(); ++i) {
+    ASSERT_TRUE(results[i].ok()) << results[i].status().message();
+    EXPECT_THAT(results[i]->code, Eq(200));
+    ASSERT_TRUE(std::holds_alternative<nlohmann::json>(results[i]->body));
+    EXPECT_THAT(std::get<nlohmann::json>(results[i]->body)["@odata.id"],
+                Eq(paths[i]));
+  }
+}
+
 TEST_F(HttpRedfishTransportTest, CanPost) {
   auto request_json = nlohmann::json::parse(R"json({
   "ResetType": "PowerCycle"
@@ -943,5 +976,106 @@ TEST_F(HttpRedfishTransportTest, CanDoSessionAuthTwice) {
   EXPECT_THAT(delete_count, Eq(2));
 }
 
+TEST_F(HttpRedfishTransportTest, RefreshesSessionAndRetriesOnUnauthorized) {
+  int post_count = 0;
+  std::string valid_token;
+  server_->AddHttpPostHandler(
+      "/redfish/v1/SessionService/Sessions",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        ++post_count;
+        valid_token = absl::StrCat("token", post_count);
+        ::tensorflow::serving::net_http::SetContentType(req,
+                                                        "application/json");
+        req->WriteResponseString("{}");
+        req->AppendResponseHeader("X-Auth-Token", valid_token);
+        req->AppendResponseHeader("Location", "/redfish/v1/Session/Sessions/1");
+        req->Reply();
+      });
+  int delete_count = 0;
+  server_->AddHttpDeleteHandler(
+      "/redfish/v1/Session/Sessions/1",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        ++delete_count;
+        req->ReplyWithStatus(
+            tensorflow::serving::net_http::HTTPStatusCode::NO_CONTENT);
+      });
+  server_->AddHttpGetHandler(
+      "/redfish/v1/test/uri",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        ::tensorflow::serving::net_http::SetContentType(req,
+                                                        "application/json");
+        req->WriteResponseString("{}");
+        if (req->GetRequestHeader("X-Auth-Token") != valid_token) {
+          req->ReplyWithStatus(
+              tensorflow::serving::net_http::HTTPStatusCode::UNAUTHORIZED);
+          return;
+        }
+        req->Reply();
+      });
+
+  auto result = transport_->DoSessionAuth("test_username", "test_password");
+  ASSERT_TRUE(result.ok()) << result.message();
+  EXPECT_THAT(post_count, Eq(1));
+
+  // Expire the session on the service side; the next GET should establish a
+  // new session and succeed on its single retry.
+  valid_token = "expired";
+  auto get_result = transport_->Get("/redfish/v1/test/uri");
+  ASSERT_TRUE(get_result.ok()) << get_result.status().message();
+  EXPECT_THAT(get_result->code, Eq(200));
+  EXPECT_THAT(post_count, Eq(2));
+
+  // The refreshed session is reused without authenticating again.
+  get_result = transport_->Get("/redfish/v1/test/uri");
+  ASSERT_TRUE(get_result.ok()) << get_result.status().message();
+  EXPECT_THAT(get_result->code, Eq(200));
+  EXPECT_THAT(post_count, Eq(2));
+
+  transport_.reset();
+  EXPECT_THAT(delete_count, Eq(1));
+}
+
+TEST_F(HttpRedfishTransportTest, ReturnsUnauthorizedWhenSessionRefreshFails) {
+  int post_count = 0;
+  server_->AddHttpPostHandler(
+      "/redfish/v1/SessionService/Sessions",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        ++post_count;
+        ::tensorflow::serving::net_http::SetContentType(req,
+                                                        "application/json");
+        req->WriteResponseString("{}");
+        // Only the first session is established with a token.
+        if (post_count == 1) {
+          req->AppendResponseHeader("X-Auth-Token", "token1");
+        }
+        req->AppendResponseHeader("Location", "/redfish/v1/Session/Sessions/1");
+        req->Reply();
+      });
+  server_->AddHttpDeleteHandler(
+      "/redfish/v1/Session/Sessions/1",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        req->ReplyWithStatus(
+            tensorflow::serving::net_http::HTTPStatusCode::NO_CONTENT);
+      });
+  server_->AddHttpGetHandler(
+      "/redfish/v1/test/uri",
+      [&](::tensorflow::serving::net_http::ServerRequestInterface *req) {
+        ::tensorflow::serving::net_http::SetContentType(req,
+                                                        "application/json");
+        req->WriteResponseString("{}");
+        req->ReplyWithStatus(
+            tensorflow::serving::net_http::HTTPStatusCode::UNAUTHORIZED);
+      });
+
+  auto result = transport_->DoSessionAuth("test_username", "test_password");
+  ASSERT_TRUE(result.ok()) << result.message();
+
+  // The session cannot be refreshed, so the 401 response is returned as is.
+  auto get_result = transport_->Get("/redfish/v1/test/uri");
+  ASSERT_TRUE(get_result.ok()) << get_result.status().message();
+  EXPECT_THAT(get_result->code, Eq(401));
+  EXPECT_THAT(post_count, Eq(2));
+}
+
 }  // namespace
 }  // namespace ecclesia
@@ -26,10 +26,20 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "single_include/nlohmann/json.hpp"
 
 namespace ecclesia {
 
+// Parser used for the JSON bodies of Redfish resources.
+enum class JsonParserBackend {
+  // Transports parse JSON bodies into nlohmann::json.
+  kNlohmann,
+  // Transports leave JSON bodies as bytes with a JSON Content-Type, which the
+  // interface parses into arena-backed JsonDocuments.
+  kJsonDocument,
+};
+
 // RedfishTransport defines a data-layer-protocol agnostic interface for the
 // raw RESTful operations to a Redfish Service.
 class RedfishTransport {
@@ -62,6 +72,28 @@ class RedfishTransport {
                                        absl::string_view data) = 0;
   virtual absl::StatusOr<Result> Delete(absl::string_view path,
                                         absl::string_view data) = 0;
+
+  // Fetches a path unless it still matches the entity tag `etag` from an
+  // earlier response, in which case the service may answer with code 304 and
+  // no body. The default implementation ignores the tag and performs a plain
+  // Get, which is always a valid answer to a conditional request.
+  virtual absl::StatusOr<Result> GetIfNoneMatch(absl::string_view path,
+                                                absl::string_view etag) {
+    return Get(path);
+  }
+
+  // Fetches several paths, returning one result per path in the same order.
+  // The default implementation performs one Get at a time; transports which
+  // can have several requests in flight override it to fetch concurrently.
+  virtual std::vector<absl::StatusOr<Result>> GetMany(
+      absl::Span<const absl::string_view> paths) {
+    std::vector<absl::StatusOr<Result>> results;
+    results.reserve(paths.size());
+    for (absl::string_view path : paths) {
+      results.push_back(Get(path));
+    }
+    return results;
+  }
 };
 
 // NullTransport provides a placeholder implementation which gracefully fails
@@ -20,6 +20,7 @@
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/functional/any_invocable.h"
 #include "absl/log/check.h"
@@ -30,6 +31,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 #include "ecclesia/lib/redfish/utils.h"
 
@@ -50,6 +52,18 @@ RedfishLoggedTransport::LogMethodDataAndResult(
     absl::string_view method, absl::string_view path,
     std::optional<absl::string_view> data,
     absl::AnyInvocable<absl::StatusOr<Result>()> call_method) const {
+  absl::Time start = absl::Now();
+  auto result = call_method();
+  absl::Duration latency = absl::Now() - start;
+  LogResult(method, path, data, latency, result);
+  return result;
+}
+
+void RedfishLoggedTransport::LogResult(
+    absl::string_view method, absl::string_view path,
+    std::optional<absl::string_view> data,
+    std::optional<absl::Duration> latency,
+    const absl::StatusOr<Result> &result) const {
   std::string context_string, data_string, latency_string;
   if (context_.has_value()) {
     context_string = absl::StrCat("Context: ", *context_, " ");
@@ -63,13 +77,9 @@ RedfishLoggedTransport::LogMethodDataAndResult(
     data_string = "";
   }
 
-  absl::Time start = absl::Now();
-  auto result = call_method();
-  absl::Duration latency = absl::Now() - start;
-
-  if (log_latency_) {
+  if (log_latency_ && latency.has_value()) {
     latency_string =
-        absl::StrFormat("[Lag: %s]", absl::FormatDuration(latency));
+        absl::StrFormat("[Lag: %s]", absl::FormatDuration(*latency));
   } else {
     latency_string = "";
   }
@@ -88,8 +98,6 @@ RedfishLoggedTransport::LogMethodDataAndResult(
   } else {
     LOG(ERROR) << absl::StrCat(method_info, result.status().message());
   }
-
-  return result;
 }
 
 absl::string_view RedfishLoggedTransport::GetRootUri() {
@@ -123,5 +131,36 @@ absl::StatusOr<RedfishTransport::Result> RedfishLoggedTransport::Delete(
     return base_transport_->Delete(path, data);
   });
 }
+absl::StatusOr<RedfishTransport::Result> RedfishLoggedTransport::GetIfNoneMatch(
+    absl::string_view path, absl::string_view etag) {
+  CHECK(base_transport_ != nullptr);
+  return LogMethodDataAndResult("GetIfNoneMatch", path, std::nullopt, [&]() {
+    return base_transport_->GetIfNoneMatch(path, etag);
+  });
+}
+std::vector<absl::StatusOr<RedfishTransport::Result>>
+RedfishLoggedTransport::GetMany(absl::Span<const absl::string_view> paths) {
+  CHECK(base_transport_ != nullptr);
+  absl::Time start = absl::Now();
+  auto results = base_transport_->GetMany(paths);
+  absl::Duration latency = absl::Now() - start;
+  // Requests of the batch are in flight together, so only the batch has a
+  // latency of its own.
+  for (size_t i = 0; i < results.size() && i < paths.size(); ++i) {
+    LogResult("GetMany", paths[i], std::nullopt, std::nullopt, results[i]);
+  }
+  std::string context_string;
+  if (context_.has_value()) {
+    context_string = absl::StrCat("Context: ", *context_, " ");
+  }
+  std::string latency_string;
+  if (log_latency_) {
+    latency_string =
+        absl::StrFormat("[Lag: %s]", absl::FormatDuration(latency));
+  }
+  LOG(INFO) << absl::StrFormat("%sGetMany(paths=%d)%s", context_string,
+                               paths.size(), latency_string);
+  return results;
+}
 
 }  // namespace ecclesia
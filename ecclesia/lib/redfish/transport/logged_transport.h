@@ -21,10 +21,13 @@
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/functional/any_invocable.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 
 namespace ecclesia {
@@ -50,6 +53,10 @@ class RedfishLoggedTransport : public RedfishTransport {
                                absl::string_view data) override;
   absl::StatusOr<Result> Delete(absl::string_view path,
                                 absl::string_view data) override;
+  absl::StatusOr<Result> GetIfNoneMatch(absl::string_view path,
+                                        absl::string_view etag) override;
+  std::vector<absl::StatusOr<Result>> GetMany(
+      absl::Span<const absl::string_view> paths) override;
 
  private:
   std::unique_ptr<RedfishTransport> base_transport_;
@@ -61,6 +68,12 @@ class RedfishLoggedTransport : public RedfishTransport {
       absl::string_view method, absl::string_view path,
       std::optional<absl::string_view> data,
       absl::AnyInvocable<absl::StatusOr<Result>()> call_method) const;
+  // The latency is not logged if it is not set, e.g. for the requests of a
+  // batch.
+  void LogResult(absl::string_view method, absl::string_view path,
+                 std::optional<absl::string_view> data,
+                 std::optional<absl::Duration> latency,
+                 const absl::StatusOr<Result> &result) const;
 };
 
 }  // namespace ecclesia
@@ -17,13 +17,17 @@
 #include "ecclesia/lib/redfish/transport/metrical_transport.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 #include "ecclesia/lib/redfish/transport/transport_metrics.pb.h"
 #include "ecclesia/lib/time/clock.h"
@@ -40,38 +44,53 @@ struct RedfishRequest {
   absl::string_view type;
 };
 
-// Creates metrics around a single redfish request.
+// Records a response time in the metadata of a request type.
+void RecordResponseTime(double response_time_ms,
+                        RedfishMetrics::RequestMetadata &metadata) {
+  if (metadata.request_count() == 0) {
+    metadata.set_max_response_time_ms(response_time_ms);
+    metadata.set_min_response_time_ms(response_time_ms);
+  } else if (response_time_ms > metadata.max_response_time_ms()) {
+    metadata.set_max_response_time_ms(response_time_ms);
+  } else if (response_time_ms < metadata.min_response_time_ms()) {
+    metadata.set_min_response_time_ms(response_time_ms);
+  }
+  metadata.set_request_count(metadata.request_count() + 1);
+}
+
+// Returns the metadata of a request to a URI.
+RedfishMetrics::RequestMetadata &GetRequestMetadata(
+    const RedfishRequest &request, bool has_request_failed,
+    RedfishMetrics &redfish_metrics) {
+  RedfishMetrics::Metrics &uri_metrics =
+      (*redfish_metrics.mutable_uri_to_metrics_map())[request.uri];
+  if (!has_request_failed) {
+    return (*uri_metrics.mutable_request_type_to_metadata())[request.type];
+  }
+  return (
+      *uri_metrics.mutable_request_type_to_metadata_failures())[request.type];
+}
+
+// Creates metrics around a single redfish request. The metrics are only updated
+// once the request is complete, while holding the given mutex.
 class RedfishTrace final {
  public:
-  RedfishTrace(RedfishRequest request, Clock *clock,
+  RedfishTrace(RedfishRequest request, Clock *clock, absl::Mutex &mutex,
                RedfishMetrics &redfish_metrics)
-      : request_(request), clock_(clock), redfish_metrics_(redfish_metrics) {
+      : request_(request),
+        clock_(clock),
+        mutex_(mutex),
+        redfish_metrics_(redfish_metrics) {
     start_timestamp_ = clock->Now();
   }
   ~RedfishTrace() {
     end_timestamp_ = clock_->Now();
     double response_time_ms =
         absl::ToDoubleMilliseconds(end_timestamp_ - start_timestamp_);
-    RedfishMetrics::Metrics *uri_metrics =
-        &(*redfish_metrics_.mutable_uri_to_metrics_map())[request_.uri];
-    RedfishMetrics::RequestMetadata *metadata;
-    if (!has_request_failed_) {
-      metadata =
-          &(*uri_metrics->mutable_request_type_to_metadata())[request_.type];
-    } else {
-      metadata =
-          &(*uri_metrics
-                 ->mutable_request_type_to_metadata_failures())[request_.type];
-    }
-    if (metadata->request_count() == 0) {
-      metadata->set_max_response_time_ms(response_time_ms);
-      metadata->set_min_response_time_ms(response_time_ms);
-    } else if (response_time_ms > metadata->max_response_time_ms()) {
-      metadata->set_max_response_time_ms(response_time_ms);
-    } else if (response_time_ms < metadata->min_response_time_ms()) {
-      metadata->set_min_response_time_ms(response_time_ms);
-    }
-    metadata->set_request_count(metadata->request_count() + 1);
+    absl::MutexLock lock(&mutex_);
+    RecordResponseTime(response_time_ms,
+                       GetRequestMetadata(request_, has_request_failed_,
+                                          redfish_metrics_));
   }
 
   // Prepares the RedfishTrace object for recording Request Metadata for
@@ -81,6 +100,7 @@ class RedfishTrace final {
  private:
   RedfishRequest request_;
   Clock *clock_;
+  absl::Mutex &mutex_;
   RedfishMetrics &redfish_metrics_;
   absl::Time start_timestamp_;
   absl::Time end_timestamp_;
@@ -98,7 +118,8 @@ absl::string_view MetricalRedfishTransport::GetRootUri() {
 absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Get(
     absl::string_view path) {
   CHECK(base_transport_ != nullptr);
-  auto trace = RedfishTrace({path, "GET"}, clock_, transport_metrics_);
+  auto trace = RedfishTrace({path, "GET"}, clock_, metrics_mutex_,
+                            transport_metrics_);
   auto result = base_transport_->Get(path);
   if (!result.ok()) {
     trace.RecordError();
@@ -108,7 +129,8 @@ absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Get(
 absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Post(
     absl::string_view path, absl::string_view data) {
   CHECK(base_transport_ != nullptr);
-  auto trace = RedfishTrace({path, "POST"}, clock_, transport_metrics_);
+  auto trace = RedfishTrace({path, "POST"}, clock_, metrics_mutex_,
+                            transport_metrics_);
   auto result = base_transport_->Post(path, data);
   if (!result.ok()) {
     trace.RecordError();
@@ -118,7 +140,8 @@ absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Post(
 absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Patch(
     absl::string_view path, absl::string_view data) {
   CHECK(base_transport_ != nullptr);
-  auto trace = RedfishTrace({path, "PATCH"}, clock_, transport_metrics_);
+  auto trace = RedfishTrace({path, "PATCH"}, clock_, metrics_mutex_,
+                            transport_metrics_);
   auto result = base_transport_->Patch(path, data);
   if (!result.ok()) {
     trace.RecordError();
@@ -128,11 +151,41 @@ absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Patch(
 absl::StatusOr<RedfishTransport::Result> MetricalRedfishTransport::Delete(
     absl::string_view path, absl::string_view data) {
   CHECK(base_transport_ != nullptr);
-  auto trace = RedfishTrace({path, "DELETE"}, clock_, transport_metrics_);
+  auto trace = RedfishTrace({path, "DELETE"}, clock_, metrics_mutex_,
+                            transport_metrics_);
   auto result = base_transport_->Delete(path, data);
   if (!result.ok()) {
     trace.RecordError();
   }
   return result;
 }
+absl::StatusOr<RedfishTransport::Result>
+MetricalRedfishTransport::GetIfNoneMatch(absl::string_view path,
+                                         absl::string_view etag) {
+  CHECK(base_transport_ != nullptr);
+  auto trace = RedfishTrace({path, "GET"}, clock_, metrics_mutex_,
+                            transport_metrics_);
+  auto result = base_transport_->GetIfNoneMatch(path, etag);
+  if (!result.ok()) {
+    trace.RecordError();
+  }
+  return result;
+}
+std::vector<absl::StatusOr<RedfishTransport::Result>>
+MetricalRedfishTransport::GetMany(absl::Span<const absl::string_view> paths) {
+  CHECK(base_transport_ != nullptr);
+  absl::Time start = clock_->Now();
+  auto results = base_transport_->GetMany(paths);
+  absl::MutexLock lock(&metrics_mutex_);
+  // The latency is that of the whole batch, so it is recorded once for the
+  // batch rather than for each of its paths.
+  RecordResponseTime(absl::ToDoubleMilliseconds(clock_->Now() - start),
+                     *transport_metrics_.mutable_get_many_batch_metadata());
+  for (size_t i = 0; i < results.size() && i < paths.size(); ++i) {
+    RedfishMetrics::RequestMetadata &metadata = GetRequestMetadata(
+        {paths[i], "GET_MANY"}, !results[i].ok(), transport_metrics_);
+    metadata.set_request_count(metadata.request_count() + 1);
+  }
+  return results;
+}
 }  // namespace ecclesia
@@ -19,9 +19,12 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/redfish/transport/interface.h"
 #include "ecclesia/lib/redfish/transport/transport_metrics.pb.h"
 #include "ecclesia/lib/time/clock.h"
@@ -29,6 +32,10 @@
 namespace ecclesia {
 
 // Decorates RedfishTransport to gather transport metrics.
+//
+// This class is threadsafe as long as the base transport is: requests are
+// forwarded concurrently and only the updates of the metrics are serialized.
+// The metrics must not be read while requests are in flight.
 class MetricalRedfishTransport : public RedfishTransport {
  public:
   explicit MetricalRedfishTransport(std::unique_ptr<RedfishTransport> base,
@@ -46,10 +53,17 @@ class MetricalRedfishTransport : public RedfishTransport {
                                absl::string_view data) override;
   absl::StatusOr<Result> Delete(absl::string_view path,
                                 absl::string_view data) override;
+  absl::StatusOr<Result> GetIfNoneMatch(absl::string_view path,
+                                        absl::string_view etag) override;
+  std::vector<absl::StatusOr<Result>> GetMany(
+      absl::Span<const absl::string_view> paths) override;
 
  private:
   std::unique_ptr<RedfishTransport> base_transport_;
   Clock *clock_;
+  // Held while updating transport_metrics_, which requests in flight on
+  // different threads share.
+  absl::Mutex metrics_mutex_;
   RedfishMetrics &transport_metrics_;
 };
 
@@ -0,0 +1,397 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/transport/persistent_cache_store.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/codec/endian.h"
+#include "ecclesia/lib/file/dir.h"
+#include "ecclesia/lib/file/mmap.h"
+#include "ecclesia/lib/redfish/transport/interface.h"
+#include "ecclesia/lib/redfish/transport/persistent_cache.pb.h"
+#include "ecclesia/lib/status/macros.h"
+#include "ecclesia/lib/status/posix.h"
+#include "ecclesia/lib/time/proto.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+namespace {
+
+// Identifies the log format at the start of the file. A log starting with
+// anything else is discarded.
+constexpr absl::string_view kLogHeader = "ECRFCL01";
+
+// Number of bytes of the size prefixed to each record.
+constexpr size_t kRecordSizeBytes = sizeof(uint32_t);
+
+// Records queued beyond this many while the writer is busy are dropped.
+constexpr size_t kMaxPendingRecords = 4096;
+
+// Appends a record along with its size prefix to a log.
+void AppendToLog(const PersistentCacheRecord &record, std::string &log) {
+  std::string serialized = record.SerializeAsString();
+  char size[kRecordSizeBytes];
+  LittleEndian::Store32(serialized.size(), size);
+  log.append(size, kRecordSizeBytes);
+  log.append(serialized);
+}
+
+// Creates a record for a path, failing if the time cannot be stored.
+absl::StatusOr<PersistentCacheRecord> NewRecord(absl::string_view path,
+                                                absl::string_view etag,
+                                                absl::Time insert_time) {
+  PersistentCacheRecord record;
+  record.set_path(std::string(path));
+  record.set_etag(std::string(etag));
+  ECCLESIA_ASSIGN_OR_RETURN(*record.mutable_insert_time(),
+                            AbslTimeToProtoTime(insert_time));
+  return record;
+}
+
+// Writes all of `data` to a file descriptor.
+absl::Status WriteAll(int fd, absl::string_view data) {
+  while (!data.empty()) {
+    ssize_t write_size = write(fd, data.data(), data.size());
+    if (write_size < 0) {
+      if (errno == EINTR) continue;
+      return PosixErrorToStatus("write() failed");
+    }
+    data.remove_prefix(write_size);
+  }
+  return absl::OkStatus();
+}
+
+// Replaces the contents of a file by writing a temporary file and renaming it
+// over the original, so that a crash never leaves a partially written file.
+absl::Status ReplaceFile(const std::string &path, absl::string_view data) {
+  std::string temporary_path = absl::StrCat(path, ".tmp");
+  int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return PosixErrorToStatus(
+        absl::StrFormat("unable to open %s", temporary_path));
+  }
+  absl::Status status = WriteAll(fd, data);
+  if (status.ok() && fsync(fd) != 0) {
+    status = PosixErrorToStatus(
+        absl::StrFormat("unable to sync %s", temporary_path));
+  }
+  close(fd);
+  if (status.ok() && rename(temporary_path.c_str(), path.c_str()) != 0) {
+    status = PosixErrorToStatus(
+        absl::StrFormat("unable to rename %s onto %s", temporary_path, path));
+  }
+  if (!status.ok()) unlink(temporary_path.c_str());
+  return status;
+}
+
+// Reads back the records of a log, keeping the most recent response of each
+// path. Returns false if the log held anything other than these responses.
+bool ReadLog(absl::string_view log,
+             absl::flat_hash_map<std::string, PersistentCacheRecord> &records) {
+  if (!absl::ConsumePrefix(&log, kLogHeader)) return false;
+  size_t num_records = 0;
+  while (log.size() >= kRecordSizeBytes) {
+    uint32_t size = LittleEndian::Load32(log.data());
+    if (log.size() - kRecordSizeBytes < size) break;
+    PersistentCacheRecord record;
+    if (!record.ParseFromArray(log.data() + kRecordSizeBytes, size)) break;
+    log.remove_prefix(kRecordSizeBytes + size);
+    ++num_records;
+
+    if (!record.revalidated()) {
+      std::string path = record.path();
+      records.insert_or_assign(std::move(path), std::move(record));
+      continue;
+    }
+    auto it = records.find(record.path());
+    if (it != records.end() && it->second.etag() == record.etag()) {
+      *it->second.mutable_insert_time() = record.insert_time();
+    }
+  }
+  // Anything left is a record truncated by a crash, or a corrupted one.
+  return log.empty() && num_records == records.size();
+}
+
+// Reads back the records of the log file at `path`, if it exists, as ReadLog.
+// Also returns the size of the file.
+absl::StatusOr<bool> ReadLogFile(
+    const std::string &path,
+    absl::flat_hash_map<std::string, PersistentCacheRecord> &records,
+    size_t &file_size) {
+  file_size = 0;
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || st.st_size == 0) return false;
+  ECCLESIA_ASSIGN_OR_RETURN(
+      MappedMemory mapped_log,
+      MappedMemory::Create(path, 0, st.st_size,
+                           MappedMemory::Type::kReadOnly));
+  file_size = st.st_size;
+  return ReadLog(mapped_log.MemoryAsStringView(), records);
+}
+
+// Replaces the log file at `path` by one holding only the given records.
+// Returns the size of the new file.
+absl::StatusOr<size_t> WriteCompactLog(
+    const std::string &path,
+    const absl::flat_hash_map<std::string, PersistentCacheRecord> &records) {
+  std::string log(kLogHeader);
+  for (const auto &[record_path, record] : records) AppendToLog(record, log);
+  ECCLESIA_RETURN_IF_ERROR(ReplaceFile(path, log));
+  return log.size();
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<PersistentCacheStore>>
+PersistentCacheStore::Create(std::string path, Options options) {
+  // The constructor is private, so std::make_unique cannot be used.
+  auto store =
+      absl::WrapUnique(new PersistentCacheStore(std::move(path), options));
+  ECCLESIA_RETURN_IF_ERROR(store->Open());
+  return store;
+}
+
+absl::StatusOr<std::unique_ptr<PersistentCacheStore>>
+PersistentCacheStore::Create(DataStoreDirectory &directory,
+                             absl::string_view filename, Options options) {
+  ECCLESIA_ASSIGN_OR_RETURN(std::string path, directory.UseFile(filename, {}));
+  return Create(std::move(path), options);
+}
+
+PersistentCacheStore::~PersistentCacheStore() {
+  // Stopping the writer runs it on whatever is still queued.
+  writer_.reset();
+  absl::MutexLock mu(&mutex_);
+  if (fd_ >= 0) close(fd_);
+}
+
+absl::Status PersistentCacheStore::Open() {
+  absl::flat_hash_map<std::string, PersistentCacheRecord> records;
+  size_t file_size;
+  ECCLESIA_ASSIGN_OR_RETURN(bool is_compact,
+                            ReadLogFile(path_, records, file_size));
+
+  absl::flat_hash_map<std::string, Entry> entries;
+  for (auto it = records.begin(); it != records.end();) {
+    PersistentCacheRecord &record = it->second;
+    std::variant<nlohmann::json, RedfishTransport::bytes> body;
+    if (record.json_body_as_bytes()) {
+      // Left for the reader to parse, along with its Content-Type header.
+      body = RedfishTransport::bytes(record.json_body().begin(),
+                                     record.json_body().end());
+    } else {
+      body = nlohmann::json::parse(record.json_body(), nullptr, false);
+      if (std::get<nlohmann::json>(body).is_discarded()) {
+        records.erase(it++);
+        is_compact = false;
+        continue;
+      }
+    }
+    Entry &entry = entries[it->first];
+    entry.insert_time = AbslTimeFromProtoTime(record.insert_time());
+    entry.etag = record.etag();
+    entry.result.code = record.code();
+    entry.result.body = std::move(body);
+    entry.result.headers.insert(record.headers().begin(),
+                                record.headers().end());
+    ++it;
+  }
+
+  if (!is_compact) {
+    ECCLESIA_ASSIGN_OR_RETURN(file_size, WriteCompactLog(path_, records));
+  }
+
+  absl::MutexLock mu(&mutex_);
+  ECCLESIA_RETURN_IF_ERROR(OpenForAppending(file_size));
+  loaded_entries_ = std::move(entries);
+  return absl::OkStatus();
+}
+
+absl::Status PersistentCacheStore::OpenForAppending(size_t file_size) {
+  fd_ = open(path_.c_str(), O_WRONLY | O_APPEND);
+  if (fd_ < 0) {
+    return PosixErrorToStatus(
+        absl::StrFormat("unable to open %s for appending", path_));
+  }
+  file_size_ = file_size;
+  compacted_size_ = file_size;
+  return absl::OkStatus();
+}
+
+absl::Status PersistentCacheStore::Compact() {
+  close(fd_);
+  fd_ = -1;
+  absl::flat_hash_map<std::string, PersistentCacheRecord> records;
+  size_t file_size;
+  ECCLESIA_RETURN_IF_ERROR(ReadLogFile(path_, records, file_size).status());
+  ECCLESIA_ASSIGN_OR_RETURN(file_size, WriteCompactLog(path_, records));
+  return OpenForAppending(file_size);
+}
+
+absl::flat_hash_map<std::string, PersistentCacheStore::Entry>
+PersistentCacheStore::TakeLoadedEntries() {
+  absl::MutexLock mu(&mutex_);
+  return std::exchange(loaded_entries_, {});
+}
+
+void PersistentCacheStore::AppendResult(
+    absl::string_view path, absl::string_view etag, absl::Time insert_time,
+    std::shared_ptr<const RedfishTransport::Result> result) {
+  if (result == nullptr) return;
+  Enqueue({.path = std::string(path),
+           .etag = std::string(etag),
+           .insert_time = insert_time,
+           .result = std::move(result)});
+}
+
+void PersistentCacheStore::AppendRevalidation(absl::string_view path,
+                                              absl::string_view etag,
+                                              absl::Time insert_time) {
+  Enqueue({.path = std::string(path),
+           .etag = std::string(etag),
+           .insert_time = insert_time});
+}
+
+void PersistentCacheStore::Flush() {
+  absl::MutexLock lock(&queue_mutex_);
+  queue_mutex_.Await(absl::Condition(
+      +[](bool *writing) { return !*writing; }, &writing_));
+}
+
+void PersistentCacheStore::Enqueue(PendingRecord record) {
+  absl::MutexLock lock(&queue_mutex_);
+  if (pending_.size() >= kMaxPendingRecords) return;
+  pending_.push_back(std::move(record));
+  if (writing_) return;
+  writing_ = true;
+  writer_->Schedule([this] { WritePending(); });
+}
+
+void PersistentCacheStore::WritePending() {
+  while (true) {
+    std::vector<PendingRecord> pending;
+    {
+      absl::MutexLock lock(&queue_mutex_);
+      if (pending_.empty()) {
+        writing_ = false;
+        return;
+      }
+      pending.swap(pending_);
+    }
+
+    std::vector<std::string> records;
+    records.reserve(pending.size());
+    for (const PendingRecord &pending_record : pending) {
+      absl::StatusOr<PersistentCacheRecord> record = NewRecord(
+          pending_record.path, pending_record.etag, pending_record.insert_time);
+      if (!record.ok()) continue;
+      if (const RedfishTransport::Result *result = pending_record.result.get();
+          result == nullptr) {
+        record->set_revalidated(true);
+      } else {
+        record->set_code(result->code);
+        record->mutable_headers()->insert(result->headers.begin(),
+                                          result->headers.end());
+        // JSON left as bytes by the transport is stored as is.
+        if (const auto *json = std::get_if<nlohmann::json>(&result->body)) {
+          record->set_json_body(json->dump());
+        } else {
+          const auto &bytes = std::get<RedfishTransport::bytes>(result->body);
+          record->set_json_body(std::string(bytes.begin(), bytes.end()));
+          record->set_json_body_as_bytes(true);
+        }
+      }
+      AppendToLog(*record, records.emplace_back());
+    }
+
+    absl::MutexLock mu(&mutex_);
+    AppendRecords(records);
+  }
+}
+
+void PersistentCacheStore::AppendRecords(
+    const std::vector<std::string> &records) {
+  std::string data;
+  for (const std::string &record : records) {
+    if (file_size_ + data.size() + record.size() > options_.max_file_size) {
+      // Compaction reads the log back, so it must hold everything before.
+      WriteToLog(data);
+      data.clear();
+      if (fd_ < 0) return;
+      if (file_size_ + record.size() > options_.max_file_size) {
+        // Compacting can free at most what was appended since the log was
+        // last compacted, so it is only worth it if that is a good part of
+        // the limit. Otherwise the most recent responses alone nearly fill
+        // the log.
+        if (file_size_ - compacted_size_ < options_.max_file_size / 4) {
+          return;
+        }
+        if (absl::Status status = Compact(); !status.ok()) {
+          LOG(ERROR) << "unable to compact the persistent cache " << path_
+                     << ": " << status;
+          if (fd_ >= 0) close(fd_);
+          fd_ = -1;
+          return;
+        }
+        if (file_size_ + record.size() > options_.max_file_size) return;
+      }
+    }
+    data.append(record);
+  }
+  WriteToLog(data);
+}
+
+void PersistentCacheStore::WriteToLog(absl::string_view data) {
+  if (fd_ < 0 || data.empty()) return;
+  // Records are written with a single append, so a crash can only truncate
+  // the last one, which is dropped when the log is read back.
+  absl::Status status = WriteAll(fd_, data);
+  if (!status.ok()) {
+    LOG(ERROR) << "unable to append to the persistent cache " << path_ << ": "
+               << status;
+    // Stop appending, as a partial write would hide any later records.
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  file_size_ += data.size();
+}
+
+}  // namespace ecclesia
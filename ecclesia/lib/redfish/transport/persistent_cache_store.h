@@ -0,0 +1,164 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ECCLESIA_LIB_REDFISH_TRANSPORT_PERSISTENT_CACHE_STORE_H_
+#define ECCLESIA_LIB_REDFISH_TRANSPORT_PERSISTENT_CACHE_STORE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/file/dir.h"
+#include "ecclesia/lib/redfish/transport/interface.h"
+#include "ecclesia/lib/redfish/transport/persistent_cache.pb.h"
+#include "ecclesia/lib/thread/thread_pool.h"
+
+namespace ecclesia {
+
+// Persists cached Redfish responses so that a cache can be warmed up from
+// them after a restart instead of refetching every resource from the service.
+//
+// The responses are kept in an append-only log of PersistentCacheRecord
+// protos, each prefixed with its size. When the store is opened, the log is
+// memory mapped and read back, keeping the most recent response of each path;
+// a truncated record left by a crash ends the log. The log is then compacted
+// to these responses if it held anything else. It is compacted the same way
+// when it reaches its maximum size while appending.
+//
+// Appends are queued and written in batches by a background thread, so that
+// callers serving requests never wait on the log.
+class PersistentCacheStore {
+ public:
+  struct Options {
+    // Maximum size of the log. Once it is reached, the log is compacted; if
+    // the most recent responses nearly fill it on their own, further responses
+    // are not persisted until the store is opened again.
+    size_t max_file_size = 64 * 1024 * 1024;
+  };
+
+  // A response read back from the log.
+  struct Entry {
+    // When the response was last fetched or revalidated.
+    absl::Time insert_time;
+    // ETag of the response; empty if the service did not send one.
+    std::string etag;
+    RedfishTransport::Result result;
+  };
+
+  // Opens the log at `path`, creating it if it does not exist.
+  static absl::StatusOr<std::unique_ptr<PersistentCacheStore>> Create(
+      std::string path, Options options);
+  // Opens the log stored as `filename` in a data store directory.
+  static absl::StatusOr<std::unique_ptr<PersistentCacheStore>> Create(
+      DataStoreDirectory &directory, absl::string_view filename,
+      Options options);
+
+  PersistentCacheStore(const PersistentCacheStore &) = delete;
+  PersistentCacheStore &operator=(const PersistentCacheStore &) = delete;
+
+  ~PersistentCacheStore();
+
+  // Returns the responses read back when the store was opened, keyed by path.
+  // They are handed over to the caller, so later calls return nothing.
+  absl::flat_hash_map<std::string, Entry> TakeLoadedEntries()
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Queues a response fetched for a path to be appended. The body must be
+  // JSON, either parsed or left as bytes by the transport, and is restored the
+  // same way along with the headers of the response. The result is shared
+  // with the writer rather than copied, so it must not be modified afterwards.
+  // Failures are logged, and records are dropped if the writer falls too far
+  // behind, as the store is only an optimization.
+  void AppendResult(absl::string_view path, absl::string_view etag,
+                    absl::Time insert_time,
+                    std::shared_ptr<const RedfishTransport::Result> result)
+      ABSL_LOCKS_EXCLUDED(queue_mutex_);
+  // Queues that the response of a path with the given ETag was revalidated.
+  void AppendRevalidation(absl::string_view path, absl::string_view etag,
+                          absl::Time insert_time)
+      ABSL_LOCKS_EXCLUDED(queue_mutex_);
+
+  // Waits until everything queued so far has been written to the log.
+  void Flush() ABSL_LOCKS_EXCLUDED(queue_mutex_);
+
+ private:
+  // A response or revalidation waiting to be appended.
+  struct PendingRecord {
+    std::string path;
+    std::string etag;
+    absl::Time insert_time;
+    // Null for a revalidation.
+    std::shared_ptr<const RedfishTransport::Result> result;
+  };
+
+  PersistentCacheStore(std::string path, Options options)
+      : path_(std::move(path)),
+        options_(options),
+        writer_(std::make_unique<ThreadPool>(1)) {}
+
+  // Reads back the log and compacts it, leaving it open for appending.
+  absl::Status Open() ABSL_LOCKS_EXCLUDED(mutex_);
+  // Opens the log for appending, given its current size.
+  absl::Status OpenForAppending(size_t file_size)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Rewrites the log with only the most recent response of each path and
+  // reopens it for appending.
+  absl::Status Compact() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Queues a record, scheduling the writer if it is idle.
+  void Enqueue(PendingRecord record) ABSL_LOCKS_EXCLUDED(queue_mutex_);
+  // Writes the queued records until there are none left. Runs on writer_.
+  void WritePending() ABSL_LOCKS_EXCLUDED(mutex_, queue_mutex_);
+  // Appends serialized records to the log with as few writes as possible,
+  // compacting it whenever it is full.
+  void AppendRecords(const std::vector<std::string> &records)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Appends data to the log with a single write.
+  void WriteToLog(absl::string_view data) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::string path_;
+  const Options options_;
+
+  absl::Mutex mutex_;
+  // Descriptor of the log opened for appending; -1 if it could not be opened.
+  int fd_ ABSL_GUARDED_BY(mutex_) = -1;
+  // Current size of the log in bytes.
+  size_t file_size_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Size of the log when it was last compacted or opened.
+  size_t compacted_size_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::flat_hash_map<std::string, Entry> loaded_entries_
+      ABSL_GUARDED_BY(mutex_);
+
+  // Guards the queue only, so that queuing never waits for a write.
+  absl::Mutex queue_mutex_;
+  std::vector<PendingRecord> pending_ ABSL_GUARDED_BY(queue_mutex_);
+  // Whether WritePending is scheduled or running.
+  bool writing_ ABSL_GUARDED_BY(queue_mutex_) = false;
+  // Single thread appending the queued records.
+  std::unique_ptr<ThreadPool> writer_;
+};
+
+}  // namespace ecclesia
+
+#endif  // ECCLESIA_LIB_REDFISH_TRANSPORT_PERSISTENT_CACHE_STORE_H_
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ecclesia/lib/redfish/transport/persistent_cache_store.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/file/dir.h"
+#include "ecclesia/lib/file/test_filesystem.h"
+#include "ecclesia/lib/redfish/transport/interface.h"
+#include "ecclesia/lib/testing/status.h"
+#include "single_include/nlohmann/json.hpp"
+
+namespace ecclesia {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+
+std::shared_ptr<const RedfishTransport::Result> MakeResult(
+    nlohmann::json body) {
+  auto result = std::make_shared<RedfishTransport::Result>();
+  result->code = 200;
+  result->body = std::move(body);
+  result->headers["ETag"] = "\"1\"";
+  return result;
+}
+
+class PersistentCacheStoreTest : public ::testing::Test {
+ protected:
+  PersistentCacheStoreTest() : fs_(GetTestTempdirPath()) {
+    fs_.CreateDir("/store");
+  }
+
+  // Opens the store, as done after each restart.
+  std::unique_ptr<PersistentCacheStore> OpenStore(
+      PersistentCacheStore::Options options = {}) {
+    DataStoreDirectory directory(fs_.GetTruePath("/store"));
+    absl::StatusOr<std::unique_ptr<PersistentCacheStore>> store =
+        PersistentCacheStore::Create(directory, "cache.log", options);
+    EXPECT_THAT(store, IsOk());
+    return store.ok() ? *std::move(store) : nullptr;
+  }
+
+  TestFilesystem fs_;
+  absl::Time now_ = absl::FromUnixSeconds(1000);
+};
+
+TEST_F(PersistentCacheStoreTest, NewStoreIsEmpty) {
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->TakeLoadedEntries(), IsEmpty());
+}
+
+TEST_F(PersistentCacheStoreTest, ResultsAreLoadedAfterRestart) {
+  {
+    std::unique_ptr<PersistentCacheStore> store = OpenStore();
+    ASSERT_NE(store, nullptr);
+    store->AppendResult("/a", "\"1\"", now_, MakeResult({{"Id", "a"}}));
+    store->AppendResult("/b", "", now_, MakeResult({{"Id", "b"}}));
+    // Only the most recent result of a path is kept.
+    store->AppendResult("/a", "\"2\"", now_ + absl::Seconds(1),
+                        MakeResult({{"Id", "a2"}}));
+  }
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  absl::flat_hash_map<std::string, PersistentCacheStore::Entry> entries =
+      store->TakeLoadedEntries();
+  ASSERT_THAT(entries.size(), Eq(2));
+
+  const PersistentCacheStore::Entry &a = entries["/a"];
+  EXPECT_THAT(a.insert_time, Eq(now_ + absl::Seconds(1)));
+  EXPECT_THAT(a.etag, Eq("\"2\""));
+  EXPECT_THAT(a.result.code, Eq(200));
+  EXPECT_THAT(std::get<nlohmann::json>(a.result.body),
+              Eq(nlohmann::json{{"Id", "a2"}}));
+  EXPECT_THAT(a.result.headers, UnorderedElementsAre(Pair("ETag", "\"1\"")));
+  EXPECT_THAT(std::get<nlohmann::json>(entries["/b"].result.body),
+              Eq(nlohmann::json{{"Id", "b"}}));
+
+  // The entries are only handed over once.
+  EXPECT_THAT(store->TakeLoadedEntries(), IsEmpty());
+}
+
+TEST_F(PersistentCacheStoreTest, BytesBodiesAreLoadedAsBytes) {
+  constexpr absl::string_view kBody = R"json({"Id": "a"})json";
+  {
+    std::unique_ptr<PersistentCacheStore> store = OpenStore();
+    ASSERT_NE(store, nullptr);
+    auto result = std::make_shared<RedfishTransport::Result>();
+    result->code = 200;
+    result->body = RedfishTransport::bytes(kBody.begin(), kBody.end());
+    result->headers["Content-Type"] = "application/json";
+    store->AppendResult("/a", "", now_, result);
+  }
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  absl::flat_hash_map<std::string, PersistentCacheStore::Entry> entries =
+      store->TakeLoadedEntries();
+  const RedfishTransport::Result &result = entries["/a"].result;
+  ASSERT_TRUE(std::holds_alternative<RedfishTransport::bytes>(result.body));
+  const auto &bytes = std::get<RedfishTransport::bytes>(result.body);
+  EXPECT_THAT(std::string(bytes.begin(), bytes.end()), Eq(kBody));
+  EXPECT_THAT(result.headers,
+              UnorderedElementsAre(Pair("Content-Type", "application/json")));
+}
+
+TEST_F(PersistentCacheStoreTest, RevalidationsUpdateMatchingEntries) {
+  {
+    std::unique_ptr<PersistentCacheStore> store = OpenStore();
+    ASSERT_NE(store, nullptr);
+    store->AppendResult("/a", "\"1\"", now_, MakeResult({{"Id", "a"}}));
+    store->AppendResult("/b", "\"1\"", now_, MakeResult({{"Id", "b"}}));
+    store->AppendRevalidation("/a", "\"1\"", now_ + absl::Minutes(1));
+    // A revalidation of another version of the resource is ignored.
+    store->AppendRevalidation("/b", "\"2\"", now_ + absl::Minutes(1));
+  }
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  absl::flat_hash_map<std::string, PersistentCacheStore::Entry> entries =
+      store->TakeLoadedEntries();
+  EXPECT_THAT(entries["/a"].insert_time, Eq(now_ + absl::Minutes(1)));
+  EXPECT_THAT(entries["/b"].insert_time, Eq(now_));
+}
+
+TEST_F(PersistentCacheStoreTest, TruncatedRecordIsDropped) {
+  {
+    std::unique_ptr<PersistentCacheStore> store = OpenStore();
+    ASSERT_NE(store, nullptr);
+    store->AppendResult("/a", "", now_, MakeResult({{"Id", "a"}}));
+    store->AppendResult("/b", "", now_, MakeResult({{"Id", "b"}}));
+  }
+  // Simulate a crash in the middle of writing the last record.
+  std::string log = fs_.ReadFile("/store/cache.log");
+  fs_.WriteFile("/store/cache.log", log.substr(0, log.size() - 3));
+
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->TakeLoadedEntries(),
+              UnorderedElementsAre(Pair("/a", testing::_)));
+  // The log was compacted, so new records are read back after it.
+  store->AppendResult("/c", "", now_, MakeResult({{"Id", "c"}}));
+  // Appends are written in the background; wait for them before reopening.
+  store->Flush();
+  store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->TakeLoadedEntries(),
+              UnorderedElementsAre(Pair("/a", testing::_),
+                                   Pair("/c", testing::_)));
+}
+
+TEST_F(PersistentCacheStoreTest, UnknownFileIsDiscarded) {
+  fs_.CreateFile("/store/cache.log", "not a cache log");
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->TakeLoadedEntries(), IsEmpty());
+}
+
+TEST_F(PersistentCacheStoreTest, AppendsStopAtMaxFileSize) {
+  {
+    std::unique_ptr<PersistentCacheStore> store =
+        OpenStore({.max_file_size = 64});
+    ASSERT_NE(store, nullptr);
+    store->AppendResult("/a", "", now_, MakeResult({{"Id", "a"}}));
+    store->AppendResult("/b", "", now_,
+                        MakeResult({{"Id", std::string(100, 'b')}}));
+  }
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->TakeLoadedEntries(),
+              UnorderedElementsAre(Pair("/a", testing::_)));
+}
+
+TEST_F(PersistentCacheStoreTest, LogIsCompactedWhenFull) {
+  constexpr size_t kMaxFileSize = 256;
+  {
+    std::unique_ptr<PersistentCacheStore> store =
+        OpenStore({.max_file_size = kMaxFileSize});
+    ASSERT_NE(store, nullptr);
+    store->AppendResult("/b", "", now_, MakeResult({{"Id", "b"}}));
+    // Rewriting the same path fills the log many times over, but only the
+    // most recent response of each path is kept by compactions.
+    for (int i = 0; i < 100; ++i) {
+      store->AppendResult("/a", "", now_ + absl::Seconds(i),
+                          MakeResult({{"Id", i}}));
+    }
+  }
+  EXPECT_LE(fs_.ReadFile("/store/cache.log").size(), kMaxFileSize);
+  std::unique_ptr<PersistentCacheStore> store = OpenStore();
+  ASSERT_NE(store, nullptr);
+  absl::flat_hash_map<std::string, PersistentCacheStore::Entry> entries =
+      store->TakeLoadedEntries();
+  ASSERT_THAT(entries.size(), Eq(2));
+  EXPECT_THAT(std::get<nlohmann::json>(entries["/a"].result.body),
+              Eq(nlohmann::json{{"Id", 99}}));
+  EXPECT_THAT(entries["/a"].insert_time, Eq(now_ + absl::Seconds(99)));
+  EXPECT_THAT(std::get<nlohmann::json>(entries["/b"].result.body),
+              Eq(nlohmann::json{{"Id", "b"}}));
+}
+
+}  // namespace
+}  // namespace ecclesia
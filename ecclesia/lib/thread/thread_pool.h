@@ -61,6 +61,9 @@ class ThreadPool {
     queue_.push(std::move(func));
   }
 
+  // Returns the number of threads running the scheduled functions.
+  size_t NumThreads() const { return threads_.size(); }
+
  private:
   bool WorkAvailable() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     return !queue_.empty();